@@ -154,15 +154,18 @@ struct ButtonPressHighlightDemo : ui::Buildable
 	void OnPaint(const ui::UIPaintContext& ctx) override
 	{
 		ui::Buildable::OnPaint(ctx);
+		// interned once instead of on every paint
+		static const ui::Atom DIST("dist");
+		static const ui::Atom ALPHA("alpha");
 		for (const auto& anim : anims)
 		{
-			float dist = anim->player.GetVariable("dist");
-			float alpha = anim->player.GetVariable("alpha", 1);
+			float dist = anim->player.GetVariable(DIST);
+			float alpha = anim->player.GetVariable(ALPHA, 1);
 			ui::draw::RectCutoutCol(anim->baseRect.ExtendBy(dist), anim->baseRect, ui::Color4f(1, alpha));
 		}
 		for (size_t i = 0; i < anims.size(); i++)
 		{
-			if (anims[i]->player.GetVariable("alpha", 1) <= 0)
+			if (anims[i]->player.GetVariable(ALPHA, 1) <= 0)
 				anims.RemoveAt(i--);
 		}
 	}
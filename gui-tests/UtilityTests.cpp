@@ -19,22 +19,25 @@ struct BasicEasingAnimTest : ui::Buildable
 	}
 	void Build() override
 	{
+		// rebuilt on every animation update
+		static const ui::Atom TEST("test");
+
 		WPush<ui::StackTopDownLayoutElement>();
 
 		ui::LabeledProperty::Begin("Control");
 		if (ui::imButton(ui::DefaultIconStyle::Play))
 		{
-			animPlayer.SetVariable("test", 0);
+			animPlayer.SetVariable(TEST, 0);
 			animPlayer.PlayAnim(anim);
 		}
 		if (ui::imButton(ui::DefaultIconStyle::Stop))
 		{
 			animPlayer.StopAnim(anim);
 		}
-		ui::MakeWithText<ui::FrameElement>(std::to_string(animPlayer.GetVariable("test")))
+		ui::MakeWithText<ui::FrameElement>(std::to_string(animPlayer.GetVariable(TEST)))
 			.SetDefaultFrameStyle(ui::DefaultFrameStyle::GroupBox);
 		ui::LabeledProperty::End();
-		sliderVal = animPlayer.GetVariable("test");
+		sliderVal = animPlayer.GetVariable(TEST);
 		ui::Make<ui::Slider>().Init(sliderVal, { 0, 123, 0 });
 
 		WPop();
@@ -624,6 +624,8 @@ struct TEST : ui::Buildable
 			rootMenu.Last().submenu.Append(ui::MenuItem("Add wrappers", {}, false, GetWrapperSetting()).Func([this]() { GetWrapperSetting() ^= true; Rebuild(); }));
 			rootMenu.Last().submenu.Append(ui::MenuItem("Draw rectangles", {}, false, GetNativeWindow()->IsDebugDrawEnabled()).Func([this]() {
 				auto* w = GetNativeWindow(); w->SetDebugDrawEnabled(!w->IsDebugDrawEnabled()); Rebuild(); }));
+			rootMenu.Last().submenu.Append(ui::MenuItem("Frame stats", {}, false, GetNativeWindow()->IsFrameStatsOverlayEnabled()).Func([this]() {
+				auto* w = GetNativeWindow(); w->SetFrameStatsOverlayEnabled(!w->IsFrameStatsOverlayEnabled()); Rebuild(); }));
 
 			rootMenu.Last().submenu.Append(ui::MenuItem::Separator());
 
@@ -674,6 +676,8 @@ struct TEST : ui::Buildable
 			ui::Make<ui::MenuItemElement>().SetText("Dump layout").onActivate = [this]() { DumpLayout(lastChild); };
 			ui::Make<ui::MenuItemElement>().SetText("Draw rectangles").SetChecked(GetNativeWindow()->IsDebugDrawEnabled()).onActivate = [this]() {
 				auto* w = GetNativeWindow(); w->SetDebugDrawEnabled(!w->IsDebugDrawEnabled()); Rebuild(); };
+			ui::Make<ui::MenuItemElement>().SetText("Frame stats").SetChecked(GetNativeWindow()->IsFrameStatsOverlayEnabled()).onActivate = [this]() {
+				auto* w = GetNativeWindow(); w->SetFrameStatsOverlayEnabled(!w->IsFrameStatsOverlayEnabled()); Rebuild(); };
 		}
 		ui::Pop();
 
@@ -221,33 +221,46 @@ struct Array
 	// simple modification
 	void _Realloc(size_t newCap)
 	{
-		auto* newData = (T*)malloc(sizeof(T) * newCap);
 		size_t numToCopy = _size < newCap ? _size : newCap;
 
-		UI_IF_MAYBE_CONSTEXPR(std::is_trivially_copyable<T>::value)
+		UI_IF_MAYBE_CONSTEXPR(!std::is_trivially_destructible<T>::value)
+		{
+			for (size_t i = numToCopy; i < _size; i++)
+				_data[i].~T();
+		}
+
+		UI_IF_MAYBE_CONSTEXPR(IsTriviallyRelocatable<T>::value)
 		{
-			memcpy(newData, _data, numToCopy * sizeof(T));
+			// can often grow in place
+			_data = (T*)realloc(_data, sizeof(T) * newCap);
 		}
 		else
 		{
+			auto* newData = (T*)malloc(sizeof(T) * newCap);
 			for (size_t i = 0; i < numToCopy; i++)
 			{
 				new (&newData[i]) T(Move(_data[i]));
 				_data[i].~T();
 			}
+			free(_data);
+			_data = newData;
 		}
-
-		UI_IF_MAYBE_CONSTEXPR(!std::is_trivially_destructible<T>::value)
-		{
-			for (size_t i = numToCopy; i < _size; i++)
-				_data[i].~T();
-		}
-
-		free(_data);
-		_data = newData;
 		_capacity = newCap;
 	}
 
+	// 1.5x growth, rounded up to fill the allocator size classes (16 bytes for small blocks, pages for large ones)
+	size_t _GetGrownCapacity(size_t minCap) const
+	{
+		size_t cap = _capacity + _capacity / 2;
+		if (cap < minCap)
+			cap = minCap;
+		size_t bytes = cap * sizeof(T);
+		size_t align = bytes < 65536 ? 16 : 4096;
+		bytes = (bytes + align - 1) & ~(align - 1);
+		size_t roundedCap = bytes / sizeof(T);
+		return roundedCap > cap ? roundedCap : cap;
+	}
+
 	UI_FORCEINLINE void Reserve(size_t newSize)
 	{
 		if (newSize > _capacity)
@@ -256,7 +269,7 @@ struct Array
 	UI_FORCEINLINE void ReserveForAppend(size_t newSize)
 	{
 		if (newSize > _capacity)
-			_Realloc(newSize + _capacity);
+			_Realloc(_GetGrownCapacity(newSize));
 	}
 	void Resize(size_t newSize)
 	{
@@ -375,6 +388,30 @@ struct Array
 		new (&_data[to]) T(Move(_data[from]));
 		_data[from].~T();
 	}
+	// moves [from, from + n) to [to, to + n), the source range is left uninitialized
+	void _HardMoveRange(size_t to, size_t from, size_t n)
+	{
+		UI_IF_MAYBE_CONSTEXPR(IsTriviallyRelocatable<T>::value)
+		{
+			memmove(&_data[to], &_data[from], sizeof(T) * n);
+		}
+		else
+		{
+			if (to < from)
+			{
+				for (size_t i = 0; i < n; i++)
+					_HardMove(to + i, from + i);
+			}
+			else
+			{
+				for (size_t i = n; i > 0; )
+				{
+					i--;
+					_HardMove(to + i, from + i);
+				}
+			}
+		}
+	}
 	inline bool UnorderedRemoveAt(size_t at)
 	{
 		assert(at < _size);
@@ -396,23 +433,14 @@ struct Array
 
 		_size -= n;
 		if (at < _size)
-		{
-			for (size_t p = at; p < _size; p++)
-				_HardMove(p, p + n);
-		}
+			_HardMoveRange(at, at + n, _size - at);
 	}
 	void _MakeHole(size_t at)
 	{
 		assert(at <= _size);
 		ReserveForAppend(_size + 1);
 		if (at < _size)
-		{
-			for (size_t p = _size; p > at; )
-			{
-				p--;
-				_HardMove(p + 1, p);
-			}
-		}
+			_HardMoveRange(at + 1, at, _size - at);
 		_size++;
 	}
 	void InsertAt(size_t at, const T& v)
@@ -434,13 +462,7 @@ struct Array
 		assert(at <= _size);
 		ReserveForAppend(_size + n);
 		if (at < _size)
-		{
-			for (size_t p = _size; p > at; )
-			{
-				p--;
-				_HardMove(p + n, p);
-			}
-		}
+			_HardMoveRange(at + n, at, _size - at);
 		for (size_t i = 0; i < n; i++)
 			new (&_data[at + i]) T(p[i]);
 		_size += n;
@@ -0,0 +1,219 @@
+
+#include "Atom.h"
+
+#include "Array.h"
+#include "HashMap.h"
+
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+
+
+namespace ui {
+
+struct AtomEntry
+{
+	StringView str;
+	size_t hash;
+};
+
+static constexpr u32 ATOM_CHUNK_BITS = 10;
+static constexpr u32 ATOM_CHUNK_SIZE = 1 << ATOM_CHUNK_BITS;
+static constexpr u32 ATOM_MAX_CHUNKS = 4096;
+static constexpr size_t ATOM_STRING_BLOCK_SIZE = 65536;
+
+struct AtomTable
+{
+	std::shared_mutex mutex;
+	HashMap<StringView, u32> ids;
+	// entries never move so they can be read without locking
+	std::atomic<AtomEntry*> chunks[ATOM_MAX_CHUNKS] = {};
+	std::atomic<u32> count;
+
+	char* _strMem = nullptr;
+	size_t _strMemLeft = 0;
+
+	AtomTable()
+	{
+		auto* chunk = new AtomEntry[ATOM_CHUNK_SIZE];
+		chunk[0] = { StringView("", 0), HashValue(StringView()) };
+		chunks[0].store(chunk, std::memory_order_release);
+		count.store(1, std::memory_order_release);
+	}
+
+	StringView _StoreString(StringView str)
+	{
+		size_t size = str.size() + 1;
+		if (size > _strMemLeft)
+		{
+			// the rest of the previous block is wasted
+			size_t blockSize = max(size, ATOM_STRING_BLOCK_SIZE);
+			_strMem = (char*)malloc(blockSize);
+			_strMemLeft = blockSize;
+		}
+		char* mem = _strMem;
+		memcpy(mem, str.data(), str.size());
+		mem[str.size()] = 0;
+		_strMem += size;
+		_strMemLeft -= size;
+		return StringView(mem, str.size());
+	}
+
+	u32 Find(StringView str)
+	{
+		std::shared_lock<std::shared_mutex> lock(mutex);
+		if (auto* pid = ids.GetValuePtr(str))
+			return *pid;
+		return UINT32_MAX;
+	}
+
+	u32 Intern(StringView str)
+	{
+		u32 id = Find(str);
+		if (id != UINT32_MAX)
+			return id;
+
+		std::unique_lock<std::shared_mutex> lock(mutex);
+		// could have been added while the lock was released
+		if (auto* pid = ids.GetValuePtr(str))
+			return *pid;
+
+		id = count.load(std::memory_order_relaxed);
+		u32 chunkIndex = id >> ATOM_CHUNK_BITS;
+		if (chunkIndex >= ATOM_MAX_CHUNKS)
+		{
+			assert(!"too many atoms");
+			return 0;
+		}
+		AtomEntry* chunk = chunks[chunkIndex].load(std::memory_order_relaxed);
+		if (!chunk)
+		{
+			chunk = new AtomEntry[ATOM_CHUNK_SIZE];
+			chunks[chunkIndex].store(chunk, std::memory_order_release);
+		}
+
+		StringView stored = _StoreString(str);
+		chunk[id & (ATOM_CHUNK_SIZE - 1)] = { stored, HashValue(stored) };
+		ids.Insert(stored, id);
+		count.store(id + 1, std::memory_order_release);
+		return id;
+	}
+
+	UI_FORCEINLINE const AtomEntry& GetEntry(u32 id)
+	{
+		assert(id < count.load(std::memory_order_acquire));
+		return chunks[id >> ATOM_CHUNK_BITS].load(std::memory_order_acquire)[id & (ATOM_CHUNK_SIZE - 1)];
+	}
+};
+
+static AtomTable& GetAtomTable()
+{
+	// never destroyed since atoms may be used in static destructors
+	static AtomTable* table = new AtomTable;
+	return *table;
+}
+
+Atom::Atom(StringView str)
+{
+	if (str.NotEmpty())
+		_id = GetAtomTable().Intern(str);
+}
+
+Atom Atom::Find(StringView str)
+{
+	Atom a;
+	if (str.NotEmpty())
+	{
+		u32 id = GetAtomTable().Find(str);
+		if (id != UINT32_MAX)
+			a._id = id;
+	}
+	return a;
+}
+
+u32 Atom::GetCount()
+{
+	return GetAtomTable().count.load(std::memory_order_acquire);
+}
+
+StringView Atom::Str() const
+{
+	return GetAtomTable().GetEntry(_id).str;
+}
+
+size_t Atom::StrHash() const
+{
+	return GetAtomTable().GetEntry(_id).hash;
+}
+
+
+#if UI_BUILD_TESTS
+#include "Test.h"
+
+DEFINE_TEST_CATEGORY(Atom, 70);
+
+DEFINE_TEST(Atom, Basic)
+{
+	Atom empty;
+	ASSERT_EQUAL(true, empty.IsEmpty());
+	ASSERT_EQUAL(true, empty.Str() == "");
+	ASSERT_EQUAL(true, Atom("") == empty);
+
+	Atom a("test.atom.a");
+	Atom b(std::string("test.atom.b"));
+	ASSERT_EQUAL(true, a != b);
+	ASSERT_EQUAL(true, a == Atom(StringView("test.atom.a")));
+	ASSERT_EQUAL(true, a.Str() == "test.atom.a");
+	ASSERT_EQUAL(true, strcmp(b.CStr(), "test.atom.b") == 0);
+	ASSERT_EQUAL(true, a.StrHash() == HashValue(StringView("test.atom.a")));
+
+	ASSERT_EQUAL(true, Atom::Find("test.atom.a") == a);
+	ASSERT_EQUAL(true, Atom::Find("test.atom.never.created").IsEmpty());
+
+	HashMap<Atom, int> map;
+	map.Insert(a, 1);
+	map.Insert(b, 2);
+	ASSERT_EQUAL(true, map.GetValueOrDefault("test.atom.a") == 1);
+	ASSERT_EQUAL(true, map.GetValueOrDefault(b) == 2);
+	ASSERT_EQUAL(true, map.GetValueOrDefault("test.atom.c") == 0);
+}
+
+DEFINE_TEST(Atom, Threads)
+{
+	// every thread interns the same strings in a different order, the IDs must match
+	constexpr int NUM_THREADS = 4;
+	constexpr int NUM_STRINGS = 5000;
+	static const int mults[NUM_THREADS] = { 1, 3, 7, 9 }; // coprime with NUM_STRINGS
+	Array<u32> ids[NUM_THREADS];
+	Array<std::thread> threads;
+	for (int t = 0; t < NUM_THREADS; t++)
+	{
+		threads.Append(std::thread([t, &ids]()
+		{
+			ids[t].ResizeWith(NUM_STRINGS, 0);
+			char bfr[32];
+			for (int i = 0; i < NUM_STRINGS; i++)
+			{
+				int n = (i * mults[t] + t * 997) % NUM_STRINGS;
+				snprintf(bfr, sizeof(bfr), "test.atom.thread.%d", n);
+				ids[t][n] = Atom(bfr).GetID();
+			}
+		}));
+	}
+	for (auto& t : threads)
+		t.join();
+
+	for (int i = 0; i < NUM_STRINGS; i++)
+	{
+		for (int t = 1; t < NUM_THREADS; t++)
+			ASSERT_EQUAL(true, ids[t][i] == ids[0][i]);
+		char bfr[32];
+		snprintf(bfr, sizeof(bfr), "test.atom.thread.%d", i);
+		ASSERT_EQUAL(true, Atom::Find(bfr).GetID() == ids[0][i]);
+		ASSERT_EQUAL(true, Atom::Find(bfr).Str() == bfr);
+	}
+}
+#endif
+
+} // ui
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "String.h"
+
+
+namespace ui {
+
+// interned string - equal strings always get the same atom
+// - comparison and hashing only use the small integer ID
+// - the string and its hash are stored once, on first use, and never freed
+// - creating atoms is thread-safe, reading the string of an existing atom doesn't lock
+// - converts implicitly from strings for convenience, so avoid creating atoms from unbounded sets of strings
+struct Atom
+{
+	u32 _id = 0; // 0 = empty string
+
+	UI_FORCEINLINE Atom() {}
+	Atom(StringView str);
+	UI_FORCEINLINE Atom(const char* str) : Atom(StringView(str)) {}
+	UI_FORCEINLINE Atom(const std::string& str) : Atom(StringView(str)) {}
+
+	// returns an empty atom if the string was never interned
+	static Atom Find(StringView str);
+	static u32 GetCount();
+
+	UI_FORCEINLINE bool IsEmpty() const { return _id == 0; }
+	UI_FORCEINLINE bool NotEmpty() const { return _id != 0; }
+	UI_FORCEINLINE u32 GetID() const { return _id; }
+	// always null-terminated
+	StringView Str() const;
+	UI_FORCEINLINE const char* CStr() const { return Str().data(); }
+	// the same as HashValue(Str()), for lookups in string-keyed tables
+	size_t StrHash() const;
+
+	UI_FORCEINLINE bool operator == (const Atom& o) const { return _id == o._id; }
+	UI_FORCEINLINE bool operator != (const Atom& o) const { return _id != o._id; }
+	UI_FORCEINLINE bool operator < (const Atom& o) const { return _id < o._id; }
+};
+
+UI_FORCEINLINE size_t HashValue(Atom a) { return HashValue(a._id); }
+
+} // ui
@@ -3,6 +3,14 @@
 
 #include "ObjectIterationCore.h"
 
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#  define UI_BITARRAY_SSE2 1
+#  include <emmintrin.h>
+#elif defined(__ARM_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+#  define UI_BITARRAY_NEON 1
+#  include <arm_neon.h>
+#endif
+
 
 namespace ui {
 
@@ -90,6 +98,196 @@ void BitArray::_MoveBitsDown(size_t dst, size_t src, size_t n)
 	}
 }
 
+void BitArray::SetRange(size_t from, size_t to, bool v)
+{
+	size_t sz = Size();
+	assert(from <= sz);
+	assert(to <= sz);
+	if (from >= to)
+		return;
+
+	Word* data = Data();
+	size_t fw = from >> SHIFT_WORD_NUM;
+	size_t lw = (to - 1) >> SHIFT_WORD_NUM;
+	Word fm = ~Word(0) << (from & MASK_WORD_BIT);
+	Word lm = ~Word(0) >> (MASK_WORD_BIT - ((to - 1) & MASK_WORD_BIT));
+	if (fw == lw)
+		fm &= lm;
+
+	if (v)
+		data[fw] |= fm;
+	else
+		data[fw] &= ~fm;
+	if (fw == lw)
+		return;
+
+	if (lw > fw + 1)
+		memset(&data[fw + 1], v ? -1 : 0, (lw - fw - 1) * WORD_BYTES);
+
+	if (v)
+		data[lw] |= lm;
+	else
+		data[lw] &= ~lm;
+}
+
+struct BitOpAnd
+{
+	static UI_FORCEINLINE BitArray::Word Scalar(BitArray::Word a, BitArray::Word b) { return a & b; }
+#if UI_BITARRAY_SSE2
+	static UI_FORCEINLINE __m128i Vec(__m128i a, __m128i b) { return _mm_and_si128(a, b); }
+#elif UI_BITARRAY_NEON
+	static UI_FORCEINLINE uint8x16_t Vec(uint8x16_t a, uint8x16_t b) { return vandq_u8(a, b); }
+#endif
+};
+struct BitOpOr
+{
+	static UI_FORCEINLINE BitArray::Word Scalar(BitArray::Word a, BitArray::Word b) { return a | b; }
+#if UI_BITARRAY_SSE2
+	static UI_FORCEINLINE __m128i Vec(__m128i a, __m128i b) { return _mm_or_si128(a, b); }
+#elif UI_BITARRAY_NEON
+	static UI_FORCEINLINE uint8x16_t Vec(uint8x16_t a, uint8x16_t b) { return vorrq_u8(a, b); }
+#endif
+};
+struct BitOpXor
+{
+	static UI_FORCEINLINE BitArray::Word Scalar(BitArray::Word a, BitArray::Word b) { return a ^ b; }
+#if UI_BITARRAY_SSE2
+	static UI_FORCEINLINE __m128i Vec(__m128i a, __m128i b) { return _mm_xor_si128(a, b); }
+#elif UI_BITARRAY_NEON
+	static UI_FORCEINLINE uint8x16_t Vec(uint8x16_t a, uint8x16_t b) { return veorq_u8(a, b); }
+#endif
+};
+struct BitOpAndNot
+{
+	static UI_FORCEINLINE BitArray::Word Scalar(BitArray::Word a, BitArray::Word b) { return a & ~b; }
+#if UI_BITARRAY_SSE2
+	static UI_FORCEINLINE __m128i Vec(__m128i a, __m128i b) { return _mm_andnot_si128(b, a); }
+#elif UI_BITARRAY_NEON
+	static UI_FORCEINLINE uint8x16_t Vec(uint8x16_t a, uint8x16_t b) { return vbicq_u8(a, b); }
+#endif
+};
+
+template <class Op>
+static void BitArrayBulkOp(BitArray::Word* dst, const BitArray::Word* src, size_t nwords)
+{
+	char* d = (char*)dst;
+	const char* s = (const char*)src;
+	size_t nbytes = nwords * BitArray::WORD_BYTES;
+	size_t i = 0;
+#if UI_BITARRAY_SSE2
+	for (; i + 16 <= nbytes; i += 16)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i*)(d + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(s + i));
+		_mm_storeu_si128((__m128i*)(d + i), Op::Vec(a, b));
+	}
+#elif UI_BITARRAY_NEON
+	for (; i + 16 <= nbytes; i += 16)
+		vst1q_u8((uint8_t*)(d + i), Op::Vec(vld1q_u8((const uint8_t*)(d + i)), vld1q_u8((const uint8_t*)(s + i))));
+#endif
+	for (size_t w = i / BitArray::WORD_BYTES; w < nwords; w++)
+		dst[w] = Op::Scalar(dst[w], src[w]);
+}
+
+void BitArray::And(const BitArray& o)
+{
+	assert(Size() == o.Size());
+	BitArrayBulkOp<BitOpAnd>(Data(), o.Data(), SizeInWords());
+}
+
+void BitArray::Or(const BitArray& o)
+{
+	assert(Size() == o.Size());
+	BitArrayBulkOp<BitOpOr>(Data(), o.Data(), SizeInWords());
+}
+
+void BitArray::Xor(const BitArray& o)
+{
+	assert(Size() == o.Size());
+	BitArrayBulkOp<BitOpXor>(Data(), o.Data(), SizeInWords());
+}
+
+void BitArray::AndNot(const BitArray& o)
+{
+	assert(Size() == o.Size());
+	BitArrayBulkOp<BitOpAndNot>(Data(), o.Data(), SizeInWords());
+}
+
+size_t BitArray::CountOnes() const
+{
+	size_t nwords = SizeInWords();
+	if (!nwords)
+		return 0;
+	const Word* data = Data();
+	// separate sums to avoid a dependency chain
+	size_t sum0 = 0, sum1 = 0;
+	size_t i = 0;
+	for (; i + 2 < nwords; i += 2)
+	{
+		sum0 += _PopCount(data[i]);
+		sum1 += _PopCount(data[i + 1]);
+	}
+	for (; i + 1 < nwords; i++)
+		sum0 += _PopCount(data[i]);
+	return sum0 + sum1 + _PopCount(data[nwords - 1] & _LastWordMask());
+}
+
+bool BitArray::AnySet() const
+{
+	size_t nwords = SizeInWords();
+	if (!nwords)
+		return false;
+	const Word* data = Data();
+	Word acc = data[nwords - 1] & _LastWordMask();
+	for (size_t i = 0; i + 1 < nwords; i++)
+		acc |= data[i];
+	return acc != 0;
+}
+
+size_t BitArray::FindNextSet(size_t from) const
+{
+	size_t sz = Size();
+	if (from >= sz)
+		return SIZE_MAX;
+	const Word* data = Data();
+	size_t i = from >> SHIFT_WORD_NUM;
+	size_t nwords = SizeInWords();
+	Word w = data[i] & (~Word(0) << (from & MASK_WORD_BIT));
+	for (;;)
+	{
+		if (w)
+		{
+			size_t pos = (i << SHIFT_WORD_NUM) + _LowestBit(w);
+			return pos < sz ? pos : SIZE_MAX;
+		}
+		if (++i == nwords)
+			return SIZE_MAX;
+		w = data[i];
+	}
+}
+
+size_t BitArray::FindNextClear(size_t from) const
+{
+	size_t sz = Size();
+	if (from >= sz)
+		return SIZE_MAX;
+	const Word* data = Data();
+	size_t i = from >> SHIFT_WORD_NUM;
+	size_t nwords = SizeInWords();
+	Word w = ~data[i] & (~Word(0) << (from & MASK_WORD_BIT));
+	for (;;)
+	{
+		if (w)
+		{
+			size_t pos = (i << SHIFT_WORD_NUM) + _LowestBit(w);
+			return pos < sz ? pos : SIZE_MAX;
+		}
+		if (++i == nwords)
+			return SIZE_MAX;
+		w = ~data[i];
+	}
+}
+
 void BitArray::OnSerialize(IObjectIterator& oi, const FieldInfo& fi)
 {
 	if (oi.IsBinary())
@@ -244,7 +442,7 @@ DEFINE_TEST(BitArray, Append)
 static void CheckSeq(BitArray& a, const char* vals)
 {
 	size_t n = strlen(vals);
-	ASSERT_EQUAL(n, a.Size());
+	ASSERT_EQUAL(true, a.Size() == n);
 	for (size_t i = 0; i < n; i++)
 		ASSERT_EQUAL(vals[i] == '1', a.Get(i));
 }
@@ -325,6 +523,149 @@ DEFINE_TEST(BitArray, InsertRemove)
 	a.Resize(1);
 	CheckSeq(a, "0");
 }
+static void FillRandom(BitArray& a, bool* ref, size_t n, unsigned& seed)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		bool v = ((seed >> 16) & 3) == 0;
+		a.Set(i, v);
+		ref[i] = v;
+	}
+}
+
+static void CheckRef(const BitArray& a, const bool* ref, size_t n)
+{
+	ASSERT_EQUAL(true, a.Size() == n);
+	for (size_t i = 0; i < n; i++)
+		ASSERT_EQUAL(ref[i], a.Get(i));
+}
+
+DEFINE_TEST(BitArray, SetRange)
+{
+	bool ref[129];
+	for (size_t S : SensSizes)
+	{
+		for (size_t from = 0; from <= S; from++)
+		{
+			for (size_t to = from; to <= S; to++)
+			{
+				for (int v = 0; v < 2; v++)
+				{
+					BitArray a(S, !v);
+					a.SetRange(from, to, v != 0);
+					for (size_t i = 0; i < S; i++)
+						ref[i] = i >= from && i < to ? v != 0 : !v;
+					CheckRef(a, ref, S);
+				}
+			}
+		}
+	}
+}
+
+DEFINE_TEST(BitArray, BulkOps)
+{
+	static size_t sizes[] = { 0, 1, 63, 64, 65, 127, 128, 129, 200, 255, 256, 257, 1000 };
+	bool refA[1000], refB[1000];
+	unsigned seed = 1234;
+	for (size_t S : sizes)
+	{
+		for (int op = 0; op < 4; op++)
+		{
+			// garbage past the end of the last word must not affect the results
+			BitArray a(S + 50, true), b(S + 50, true);
+			a.Resize(S);
+			b.Resize(S);
+			FillRandom(a, refA, S, seed);
+			FillRandom(b, refB, S, seed);
+
+			switch (op)
+			{
+			case 0: a.And(b); for (size_t i = 0; i < S; i++) refA[i] = refA[i] && refB[i]; break;
+			case 1: a.Or(b); for (size_t i = 0; i < S; i++) refA[i] = refA[i] || refB[i]; break;
+			case 2: a.Xor(b); for (size_t i = 0; i < S; i++) refA[i] = refA[i] != refB[i]; break;
+			case 3: a.AndNot(b); for (size_t i = 0; i < S; i++) refA[i] = refA[i] && !refB[i]; break;
+			}
+			CheckRef(a, refA, S);
+
+			size_t count = 0;
+			for (size_t i = 0; i < S; i++)
+				count += refA[i];
+			ASSERT_EQUAL(true, a.CountOnes() == count);
+			ASSERT_EQUAL(true, a.CountZeros() == S - count);
+			ASSERT_EQUAL(true, a.AnySet() == (count != 0));
+
+			for (size_t from = 0; from <= S; from++)
+			{
+				size_t expSet = SIZE_MAX, expClear = SIZE_MAX;
+				for (size_t i = from; i < S; i++)
+				{
+					if (refA[i] && expSet == SIZE_MAX)
+						expSet = i;
+					if (!refA[i] && expClear == SIZE_MAX)
+						expClear = i;
+				}
+				ASSERT_EQUAL(true, a.FindNextSet(from) == expSet);
+				ASSERT_EQUAL(true, a.FindNextClear(from) == expClear);
+			}
+
+			size_t next = 0;
+			a.ForEachSet([&](size_t i)
+			{
+				while (next < S && !refA[next])
+					next++;
+				ASSERT_EQUAL(true, i == next);
+				next++;
+			});
+			while (next < S && !refA[next])
+				next++;
+			ASSERT_EQUAL(true, next == S);
+		}
+	}
+}
+
+double hqtime();
+
+DEFINE_TEST(BitArray, BulkOpsBenchmark)
+{
+	constexpr size_t N = 1 << 20;
+	constexpr int REPEAT = 50;
+	BitArray a(N, false), b(N, false);
+	for (size_t i = 0; i < N; i += 3)
+		a.Set1(i);
+	for (size_t i = 0; i < N; i += 5)
+		b.Set1(i);
+
+	size_t sum = 0;
+	double t0 = hqtime();
+	for (int r = 0; r < REPEAT; r++)
+	{
+		for (size_t i = 0; i < N; i++)
+			a.SetUnchecked(i, a.GetUnchecked(i) & b.GetUnchecked(i));
+		for (size_t i = 0; i < N; i++)
+			sum += a.GetUnchecked(i);
+	}
+	double t1 = hqtime();
+	for (int r = 0; r < REPEAT; r++)
+	{
+		a.And(b);
+		sum += a.CountOnes();
+	}
+	double t2 = hqtime();
+	printf("- and+count %zu bits x%d: per-bit=%.3f ms bulk=%.3f ms (%zu)\n", N, REPEAT, (t1 - t0) * 1000, (t2 - t1) * 1000, sum);
+
+	sum = 0;
+	t0 = hqtime();
+	for (int r = 0; r < REPEAT; r++)
+		for (size_t i = 0; i < N; i++)
+			if (b.GetUnchecked(i))
+				sum += i;
+	t1 = hqtime();
+	for (int r = 0; r < REPEAT; r++)
+		b.ForEachSet([&sum](size_t i) { sum += i; });
+	t2 = hqtime();
+	printf("- iterate set bits %zu bits x%d: per-bit=%.3f ms bulk=%.3f ms (%zu)\n", N, REPEAT, (t1 - t0) * 1000, (t2 - t1) * 1000, sum);
+}
 #endif
 
 } // ui
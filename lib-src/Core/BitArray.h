@@ -4,6 +4,9 @@
 #include "Common.h"
 
 #include <string.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 
 namespace ui {
@@ -219,23 +222,8 @@ struct BitArray
 		Word bm = Word(1) << bit;
 		w ^= bm;
 	}
-	void SetRange(size_t from, size_t to, bool v)
-	{
-		size_t sz = Size();
-		assert(from <= sz);
-		assert(to <= sz);
-		// TODO optimize
-		if (v)
-		{
-			for (size_t i = from; i < to; i++)
-				Set1Unchecked(i);
-		}
-		else
-		{
-			for (size_t i = from; i < to; i++)
-				Set0Unchecked(i);
-		}
-	}
+	// [from; to)
+	void SetRange(size_t from, size_t to, bool v);
 
 	inline void Reserve(size_t sz)
 	{
@@ -310,6 +298,85 @@ struct BitArray
 	void RemoveRange(size_t from, size_t to);
 	void _MoveBitsDown(size_t dst, size_t src, size_t n);
 
+	// bulk operations
+	// - operate on whole words, the arrays must be of the same size
+	void And(const BitArray& o);
+	void Or(const BitArray& o);
+	void Xor(const BitArray& o);
+	void AndNot(const BitArray& o); // this & ~o
+
+	size_t CountOnes() const;
+	UI_FORCEINLINE size_t CountZeros() const { return Size() - CountOnes(); }
+	bool AnySet() const;
+
+	// return SIZE_MAX if there are no such bits at or after `from`
+	size_t FindNextSet(size_t from = 0) const;
+	size_t FindNextClear(size_t from = 0) const;
+
+	// calls func(size_t index) for each set bit, in order
+	template <class F>
+	void ForEachSet(F&& func) const
+	{
+		const Word* data = Data();
+		size_t nwords = SizeInWords();
+		for (size_t i = 0; i < nwords; i++)
+		{
+			Word w = data[i];
+			if (i + 1 == nwords)
+				w &= _LastWordMask();
+			while (w)
+			{
+				func((i << SHIFT_WORD_NUM) + _LowestBit(w));
+				w &= w - 1;
+			}
+		}
+	}
+
+	// the valid bits of the last word (the rest may contain anything)
+	UI_FORCEINLINE Word _LastWordMask() const
+	{
+		size_t bits = Size() & MASK_WORD_BIT;
+		return bits ? (Word(1) << bits) - 1 : ~Word(0);
+	}
+	static UI_FORCEINLINE size_t _LowestBit(Word w)
+	{
+#ifdef _MSC_VER
+		unsigned long i;
+#  ifdef _WIN64
+		_BitScanForward64(&i, w);
+#  else
+		_BitScanForward(&i, w);
+#  endif
+		return i;
+#else
+		return sizeof(Word) == 8 ? __builtin_ctzll(w) : __builtin_ctz(unsigned(w));
+#endif
+	}
+	static UI_FORCEINLINE size_t _PopCount(Word w)
+	{
+#ifdef _MSC_VER
+		// __popcnt requires a CPU with POPCNT
+		UI_IF_MAYBE_CONSTEXPR(sizeof(Word) == 8)
+		{
+			uint64_t x = w;
+			x = x - ((x >> 1) & 0x5555555555555555ull);
+			x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+			x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+			return size_t((x * 0x0101010101010101ull) >> 56);
+		}
+		else
+		{
+			uint32_t x = uint32_t(w);
+			x = x - ((x >> 1) & 0x55555555u);
+			x = (x & 0x33333333u) + ((x >> 2) & 0x33333333u);
+			x = (x + (x >> 4)) & 0x0f0f0f0fu;
+			return (x * 0x01010101u) >> 24;
+		}
+#else
+		return sizeof(Word) == 8 ? __builtin_popcountll(w) : __builtin_popcount(unsigned(w));
+#endif
+	}
+
 	void OnSerialize(IObjectIterator& oi, const FieldInfo& fi);
 };
 
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "HashMap.h"
+#include "Threading.h"
+
+
+namespace ui {
+
+// hash map that can be shared between threads
+// - split into shards by key hash, each with its own HashMap and reader-writer lock
+// - lookups only take the shared lock of one shard, so readers don't block each other
+// - values are returned by copy since the storage may move as soon as the lock is released
+//   (use handles or pointers for big values)
+template <class K, class V, class HEC = HashEqualityComparer<K>, size_t NUM_SHARDS = 16>
+struct ConcurrentHashMap
+{
+	static_assert((NUM_SHARDS & (NUM_SHARDS - 1)) == 0, "the number of shards must be a power of 2");
+
+	using Key = K;
+	using Value = V;
+
+	struct alignas(64) Shard
+	{
+		mutable RWMutex mutex;
+		HashMap<K, V, HEC> map;
+	};
+
+	Shard _shards[NUM_SHARDS];
+
+	ConcurrentHashMap() {}
+	ConcurrentHashMap(const ConcurrentHashMap&) = delete;
+	ConcurrentHashMap& operator = (const ConcurrentHashMap&) = delete;
+
+	template <class T>
+	UI_FORCEINLINE Shard& _GetShard(const T& key) const
+	{
+		size_t hash = HEC::GetHash(key);
+		// the low bits pick the slot in the shard's own table
+		hash ^= hash >> 17;
+		hash ^= hash >> 31;
+		return const_cast<Shard&>(_shards[(hash >> 7) & (NUM_SHARDS - 1)]);
+	}
+
+	size_t Size() const
+	{
+		size_t ret = 0;
+		for (auto& s : _shards)
+		{
+			RWMutexSharedLock lock(s.mutex);
+			ret += s.map.Size();
+		}
+		return ret;
+	}
+
+	void Clear()
+	{
+		for (auto& s : _shards)
+		{
+			RWMutexLock lock(s.mutex);
+			s.map.Clear();
+		}
+	}
+
+	bool Contains(const K& key) const
+	{
+		Shard& s = _GetShard(key);
+		RWMutexSharedLock lock(s.mutex);
+		return s.map.Contains(key);
+	}
+
+	bool TryGetValue(const K& key, V& outValue) const
+	{
+		Shard& s = _GetShard(key);
+		RWMutexSharedLock lock(s.mutex);
+		if (const V* pv = s.map.GetValuePtr(key))
+		{
+			outValue = *pv;
+			return true;
+		}
+		return false;
+	}
+
+	V GetValueOrDefault(const K& key, const V& def = {}) const
+	{
+		Shard& s = _GetShard(key);
+		RWMutexSharedLock lock(s.mutex);
+		return s.map.GetValueOrDefault(key, def);
+	}
+
+	// inserts or overwrites the key and the value, returns true if the key was not in the map
+	bool Insert(const K& key, const V& value)
+	{
+		Shard& s = _GetShard(key);
+		RWMutexLock lock(s.mutex);
+		bool inserted = false;
+		s.map.Insert(key, value, &inserted);
+		return inserted;
+	}
+
+	bool Remove(const K& key)
+	{
+		Shard& s = _GetShard(key);
+		RWMutexLock lock(s.mutex);
+		return s.map.Remove(key);
+	}
+
+	// returns the existing value or inserts the one returned by the factory
+	// - the factory is called at most once per key, even if multiple threads ask for the same key at once
+	// - it's called with the shard locked so it must not access this map
+	template <class F>
+	V GetOrCreate(const K& key, F&& factory, bool* created = nullptr)
+	{
+		Shard& s = _GetShard(key);
+		{
+			RWMutexSharedLock lock(s.mutex);
+			if (const V* pv = s.map.GetValuePtr(key))
+			{
+				if (created)
+					*created = false;
+				return *pv;
+			}
+		}
+
+		RWMutexLock lock(s.mutex);
+		// could have been created while no lock was held
+		if (const V* pv = s.map.GetValuePtr(key))
+		{
+			if (created)
+				*created = false;
+			return *pv;
+		}
+		if (created)
+			*created = true;
+		return s.map.Insert(key, factory())->value;
+	}
+
+	// calls the function for each entry with a (const K&, V&) pair
+	// - shards are locked one at a time, so the result is not a snapshot of the whole map
+	template <class F>
+	void ForEach(F&& func)
+	{
+		for (auto& s : _shards)
+		{
+			RWMutexLock lock(s.mutex);
+			for (auto e : s.map)
+				func(static_cast<const K&>(e.key), e.value);
+		}
+	}
+};
+
+} // ui
@@ -2,10 +2,18 @@
 #if UI_BUILD_TESTS
 
 #include "Array.h"
+#include "ConcurrentHashMap.h"
 #include "HashMap.h"
+#include "HashSet.h"
+#include "RefCounted.h"
+#include "SmallArray.h"
+#include "String.h"
 
+#include <algorithm>
+#include <atomic>
 #include <stdarg.h>
 #include <stdio.h>
+#include <thread>
 #include <vector>
 #include <unordered_map>
 #ifdef _MSC_VER
@@ -169,32 +177,32 @@ DEFINE_TEST(Containers, Array)
 		CHECK_INT_EQ(arr0, 0);
 		CHECK_INT_EQ(arr.Size(), 0);
 		CHECK_INT_EQ(arr.Capacity(), 0);
-		// - append & remove all
+		// - append & remove all (growth is rounded up to 16 bytes)
 		arr.Append({});
 		CHECK_INT_EQ(arr0, 1);
 		CHECK_INT_EQ(arr.Size(), 1);
-		CHECK_INT_EQ(arr.Capacity(), 1);
+		CHECK_INT_EQ(arr.Capacity(), 16);
 		arr.Clear();
 		CHECK_INT_EQ(arr0, 0);
 		CHECK_INT_EQ(arr.Size(), 0);
-		CHECK_INT_EQ(arr.Capacity(), 1);
+		CHECK_INT_EQ(arr.Capacity(), 16);
 		// - gradually append
 		arr.Append({});
 		CHECK_INT_EQ(arr0, 1);
 		CHECK_INT_EQ(arr.Size(), 1);
-		CHECK_INT_EQ(arr.Capacity(), 1);
+		CHECK_INT_EQ(arr.Capacity(), 16);
 		arr.Append({});
 		CHECK_INT_EQ(arr0, 2);
 		CHECK_INT_EQ(arr.Size(), 2);
-		CHECK_INT_EQ(arr.Capacity(), 3);
+		CHECK_INT_EQ(arr.Capacity(), 16);
 		arr.Append({});
 		CHECK_INT_EQ(arr0, 3);
 		CHECK_INT_EQ(arr.Size(), 3);
-		CHECK_INT_EQ(arr.Capacity(), 3);
+		CHECK_INT_EQ(arr.Capacity(), 16);
 		arr.Append({});
 		CHECK_INT_EQ(arr0, 4);
 		CHECK_INT_EQ(arr.Size(), 4);
-		CHECK_INT_EQ(arr.Capacity(), 7);
+		CHECK_INT_EQ(arr.Capacity(), 16);
 		// - copy ctor
 		{
 			auto arr2(arr);
@@ -1103,6 +1111,653 @@ DEFINE_TEST(Containers, HashMap)
 }
 #undef TEST_CMP
 
+template <class HM>
+static void CheckHashMapAgainstReference(HM& v, const std::unordered_map<int, int>& ref)
+{
+	assert(v.Size() == ref.size());
+	for (auto kvp : v)
+	{
+		auto it = ref.find(kvp.key);
+		assert(it != ref.end() && it->second == kvp.value);
+	}
+	for (auto& kvp : ref)
+		assert(v.GetValueOrDefault(kvp.first, -1) == kvp.second);
+}
+
+template <class HM>
+static void TestHashMapRandomOps()
+{
+	HM v;
+	std::unordered_map<int, int> ref;
+	unsigned seed = 123;
+	for (int i = 0; i < 20000; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		int key = int((seed >> 8) % 3000);
+		if ((seed >> 4) % 3 == 0)
+		{
+			bool removed = v.Remove(key);
+			assert(removed == (ref.erase(key) != 0));
+		}
+		else
+		{
+			v.Insert(key, i);
+			ref[key] = i;
+		}
+		if (i % 1000 == 0)
+			CheckHashMapAgainstReference(v, ref);
+	}
+	CheckHashMapAgainstReference(v, ref);
+
+	HM copy = v;
+	CheckHashMapAgainstReference(copy, ref);
+	HM moved = Move(copy);
+	CheckHashMapAgainstReference(moved, ref);
+	assert(copy.Size() == 0);
+
+	v.Clear();
+	ref.clear();
+	CheckHashMapAgainstReference(v, ref);
+	v.Insert(5, 6);
+	ref[5] = 6;
+	CheckHashMapAgainstReference(v, ref);
+}
+
+DEFINE_TEST(Containers, HashTableIndexPolicies)
+{
+	TestHashMapRandomOps<HashMap<int, int>>();
+	TestHashMapRandomOps<HashMap<int, int, HashEqualityComparer<int>, HashTableIndex_Group16>>();
+
+	// tombstone cleanup with a full table and many collisions in the same group
+	{
+		HashMap<KeyIC, ValueIC, KeyICHasher, HashTableIndex_Group16> v;
+		for (int round = 0; round < 10; round++)
+		{
+			for (int i = 0; i < 1000; i++)
+				v.Insert(i * 128, i);
+			assert(v.Size() == 1000);
+			for (int i = 0; i < 1000; i += 2)
+				assert(v.Remove(i * 128));
+			for (int i = 0; i < 1000; i++)
+				assert(v.Contains(i * 128) == (i % 2 == 1));
+			for (int i = 1; i < 1000; i += 2)
+				assert(v.GetValuePtr(i * 128)->num == i);
+			v.Clear();
+		}
+	}
+	assert(g_numKeys == 0 && g_numVals == 0);
+
+	{
+		HashSet<StringView, HashEqualityComparer<StringView>, HashTableIndex_Group16> set;
+		Array<std::string> strs;
+		for (int i = 0; i < 500; i++)
+			strs.Append("string " + std::to_string(i));
+		for (auto& s : strs)
+			set.Insert(s);
+		assert(set.Size() == 500);
+		for (auto& s : strs)
+			assert(set.Contains(s));
+		assert(!set.Contains("string 500"));
+	}
+}
+
+#define TEST_CMP(name) Test _test(name, true)
+// raise to 10'000'000 for the full comparison (needs ~1 GB of memory)
+static constexpr size_t HASH_TABLE_BENCHMARK_MAX_SIZE = 1000000;
+
+DEFINE_TEST(Containers, HashTableIndexBenchmark)
+{
+	using HashMapLinear = HashMap<int, int>;
+	using HashMapGroup16 = HashMap<int, int, HashEqualityComparer<int>, HashTableIndex_Group16>;
+	for (size_t count = 1000; count <= HASH_TABLE_BENCHMARK_MAX_SIZE; count *= 10)
+	{
+		// each line: group16 vs linear
+		char bfr[128];
+		unsigned testval = 0;
+		{TEST((snprintf(bfr, 128, "group16 insert x%u", unsigned(count)), bfr));
+		HashMapGroup16 v;
+		for (size_t i = 0; i < count; i++)
+			v.Insert(int(i * 7919), int(i));
+		testval += unsigned(v.Size());
+		}
+		{TEST_CMP(" linear:");
+		HashMapLinear v;
+		for (size_t i = 0; i < count; i++)
+			v.Insert(int(i * 7919), int(i));
+		testval += unsigned(v.Size());
+		}
+		END_TEST_GROUP;
+
+		HashMapGroup16 vg;
+		HashMapLinear vl;
+		std::unordered_map<int, int> vs;
+		for (size_t i = 0; i < count; i++)
+		{
+			vg.Insert(int(i * 7919), int(i));
+			vl.Insert(int(i * 7919), int(i));
+			vs.insert({ int(i * 7919), int(i) });
+		}
+
+		{TEST((snprintf(bfr, 128, "group16 find (hit) x%u", unsigned(count)), bfr));
+		for (size_t i = 0; i < count; i++)
+			testval += vg.GetValueOrDefault(int(i * 7919), 0);
+		}
+		{TEST_CMP(" linear:");
+		for (size_t i = 0; i < count; i++)
+			testval += vl.GetValueOrDefault(int(i * 7919), 0);
+		}
+		END_TEST_GROUP;
+
+		{TEST((snprintf(bfr, 128, "group16 find (miss) x%u", unsigned(count)), bfr));
+		for (size_t i = 0; i < count; i++)
+			testval += vg.Contains(int(i * 7919 + 1));
+		}
+		{TEST_CMP(" linear:");
+		for (size_t i = 0; i < count; i++)
+			testval += vl.Contains(int(i * 7919 + 1));
+		}
+		END_TEST_GROUP;
+
+		{TEST((snprintf(bfr, 128, "group16 find (hit) x%u", unsigned(count)), bfr));
+		for (size_t i = 0; i < count; i++)
+			testval += vg.GetValueOrDefault(int(i * 7919), 0);
+		}
+		{TEST_CMP(" unordered_map:");
+		for (size_t i = 0; i < count; i++)
+		{
+			auto it = vs.find(int(i * 7919));
+			testval += it != vs.end() ? it->second : 0;
+		}
+		}
+		END_TEST_GROUP;
+
+		{TEST((snprintf(bfr, 128, "group16 iterate x%u", unsigned(count)), bfr));
+		for (auto kvp : vg)
+			testval += kvp.value;
+		}
+		{TEST_CMP(" linear:");
+		for (auto kvp : vl)
+			testval += kvp.value;
+		}
+		END_TEST_GROUP;
+
+		{TEST((snprintf(bfr, 128, "group16 erase x%u", unsigned(count)), bfr));
+		for (size_t i = 0; i < count; i++)
+			vg.Remove(int(i * 7919));
+		}
+		{TEST_CMP(" linear:");
+		for (size_t i = 0; i < count; i++)
+			vl.Remove(int(i * 7919));
+		}
+		END_TEST_GROUP;
+
+		printf("%10u" ERASE10 "\n", testval);
+	}
+}
+#undef TEST_CMP
+
+static void GenerateTestPaths(Array<std::string>& out)
+{
+	// long paths sharing most of the prefix, differing only in a few characters in the middle
+	static const char* dirs[] = { "textures", "models", "sounds", "scripts" };
+	char bfr[512];
+	for (int d = 0; d < 4; d++)
+	{
+		for (int i = 0; i < 4096; i++)
+		{
+			snprintf(bfr, sizeof(bfr),
+				"C:/Users/developer/Documents/Projects/SomeLongProjectName/build/intermediate/assets/%s/level_%02d/item_%04d/source_variant.ext",
+				dirs[d], i % 37, i);
+			out.Append(bfr);
+		}
+	}
+}
+
+template <class F>
+static size_t CountHashCollisions(const Array<std::string>& keys, F&& hashFunc, size_t& outMaxBucketSize)
+{
+	Array<u64> hashes;
+	for (const auto& k : keys)
+		hashes.Append(hashFunc(k));
+
+	// bucket distribution in a table with the same size as the hash table would use
+	size_t cap = 1;
+	while (cap < keys.Size())
+		cap *= 2;
+	Array<u32> buckets;
+	buckets.ResizeWith(cap, 0);
+	outMaxBucketSize = 0;
+	for (u64 h : hashes)
+		outMaxBucketSize = max(outMaxBucketSize, size_t(++buckets[size_t(h) & (cap - 1)]));
+
+	std::sort(hashes.begin(), hashes.end());
+	size_t numCollisions = 0;
+	for (size_t i = 1; i < hashes.Size(); i++)
+		if (hashes[i] == hashes[i - 1])
+			numCollisions++;
+	return numCollisions;
+}
+
+DEFINE_TEST(Containers, HashBytesFull)
+{
+	// wyhash reference values
+	static const char* messages[] = { "", "a", "abc", "message digest", "abcdefghijklmnopqrstuvwxyz" };
+	static const u64 expected[] = { 0x93228a4de0eec5a2, 0xc5bac3db178713c4, 0xa97f2f7b1d9b3314, 0x786d1f1df3801df4, 0xdca5a8138ad37c87 };
+	for (int i = 0; i < 5; i++)
+		ASSERT_EQUAL(true, HashBytesFull64(messages[i], strlen(messages[i]), i) == expected[i]);
+
+	// every length and every byte must contribute
+	char buf[200] = {};
+	for (size_t len = 1; len <= sizeof(buf); len++)
+	{
+		u64 h0 = HashBytesFull64(buf, len);
+		ASSERT_EQUAL(true, h0 != HashBytesFull64(buf, len - 1));
+		for (size_t i = 0; i < len; i++)
+		{
+			buf[i] = 1;
+			ASSERT_EQUAL(true, h0 != HashBytesFull64(buf, len));
+			buf[i] = 0;
+		}
+	}
+
+	Array<std::string> paths;
+	GenerateTestPaths(paths);
+
+	size_t maxBucket = 0;
+	size_t numCollisions = CountHashCollisions(paths, [](const std::string& s) { return HashBytesFull64(s.data(), s.size()); }, maxBucket);
+	ASSERT_EQUAL(true, numCollisions == 0);
+	ASSERT_EQUAL(true, maxBucket <= 16);
+
+	size_t maxBucketSampled = 0;
+	size_t numCollisionsSampled = CountHashCollisions(paths, [](const std::string& s) { return u64(HashManyBytesFast(s.data(), s.size())); }, maxBucketSampled);
+	printf("paths: %d, full hash: %d collisions, max bucket=%d; sampled hash: %d collisions, max bucket=%d\n",
+		int(paths.Size()), int(numCollisions), int(maxBucket), int(numCollisionsSampled), int(maxBucketSampled));
+
+	HashMap<StringView, int> map;
+	for (size_t i = 0; i < paths.Size(); i++)
+		map.Insert(paths[i], int(i));
+	for (size_t i = 0; i < paths.Size(); i++)
+		ASSERT_EQUAL(true, map.GetValueOrDefault(paths[i], -1) == int(i));
+}
+
+#define TEST_CMP(name) Test _test(name, true)
+DEFINE_TEST(Containers, HashBytesThroughput)
+{
+	Array<std::string> paths;
+	GenerateTestPaths(paths);
+	std::string big((1 << 20) + 16, 'x'); // + space for misaligned starts
+	for (size_t i = 0; i < big.size(); i++)
+		big[i] = char(i * 2654435761u >> 13);
+
+	for (size_t len : { size_t(8), size_t(32), size_t(128), size_t(1024), size_t(1 << 20) })
+	{
+		char bfr[128];
+		snprintf(bfr, 128, "hash %d bytes x%d", int(len), int((16 << 20) / len));
+		int count = int((16 << 20) / len);
+
+		{TEST(bfr);
+		size_t testval = 0;
+		for (int i = 0; i < count; i++)
+			testval += HashBytesFull(big.data() + (i & 15), len);
+		END_MEASURING;
+		printf("%10u" ERASE10, unsigned(testval));
+		}
+
+		{TEST_CMP(" FNV-1a (all):");
+		size_t testval = 0;
+		for (int i = 0; i < count; i++)
+			testval += HashBytesAll(big.data() + (i & 15), len);
+		END_MEASURING;
+		printf("%10u" ERASE10, unsigned(testval));
+		}
+		END_TEST_GROUP;
+
+		{TEST(bfr);
+		size_t testval = 0;
+		for (int i = 0; i < count; i++)
+			testval += HashBytesFull(big.data() + (i & 15), len);
+		END_MEASURING;
+		printf("%10u" ERASE10, unsigned(testval));
+		}
+
+		{TEST_CMP(" FNV-1a (sampled):");
+		size_t testval = 0;
+		for (int i = 0; i < count; i++)
+			testval += HashManyBytesFast(big.data() + (i & 15), len);
+		END_MEASURING;
+		printf("%10u" ERASE10, unsigned(testval));
+		}
+		END_TEST_GROUP;
+	}
+
+	{TEST("HashMap<StringView> insert+find paths x16k");
+	HashMap<StringView, int> map;
+	for (size_t i = 0; i < paths.Size(); i++)
+		map.Insert(paths[i], int(i));
+	int testval = 0;
+	for (size_t i = 0; i < paths.Size(); i++)
+		testval += map.GetValueOrDefault(paths[i], 0);
+	END_MEASURING;
+	printf("%10u" ERASE10, unsigned(testval));
+	}
+	END_TEST_GROUP;
+}
+#undef TEST_CMP
+
+static int SumArrayView(ArrayView<int> v)
+{
+	int sum = 0;
+	for (int x : v)
+		sum += x;
+	return sum;
+}
+
+#define TEST_CMP Test _test(" Array:", true)
+DEFINE_TEST(Containers, SmallArray)
+{
+	{
+		SmallArray<int, 4> a;
+		assert(a.IsInline() && a.Capacity() == 4);
+		for (int i = 0; i < 4; i++)
+			a.Append(i);
+		assert(a.IsInline());
+		assert(SumArrayView(a) == 6);
+		a.Append(4);
+		assert(!a.IsInline() && a.Size() == 5);
+		assert(SumArrayView(a) == 10);
+
+		a.RemoveAt(1, 2);
+		assert(a.Size() == 3 && a[0] == 0 && a[1] == 3 && a[2] == 4);
+		a.InsertAt(1, a[2]);
+		assert(a.Size() == 4 && a[1] == 4 && a[2] == 3);
+		assert(a.RemoveFirstOf(3) && !a.Contains(3));
+		assert(a.PrevWrap(0) == 4 && a.NextWrap(2) == 0);
+	}
+
+	// instance counting through inline/heap copies and moves
+	{
+		SmallArray<KeyIC, 2> a;
+		a.Append(1);
+		a.Append(2);
+		SmallArray<KeyIC, 2> b = a;
+		assert(g_numKeys == 4 && b.IsInline() && b[1].num == 2);
+
+		SmallArray<KeyIC, 2> c = Move(b);
+		assert(g_numKeys == 4 && c.IsInline() && b.Size() == 0 && c[0].num == 1);
+
+		c.Append(3);
+		assert(!c.IsInline() && g_numKeys == 5);
+		auto* heapData = c.Data();
+		SmallArray<KeyIC, 2> d = Move(c);
+		assert(d.Data() == heapData && c.IsInline() && c.Size() == 0 && g_numKeys == 5);
+
+		a = d;
+		assert(a.Size() == 3 && a[2].num == 3 && g_numKeys == 6);
+		a.UnorderedRemoveAt(0);
+		assert(a.Size() == 2 && a[0].num == 3 && g_numKeys == 5);
+		d.Clear();
+		assert(g_numKeys == 2);
+	}
+	assert(g_numKeys == 0);
+
+	{TEST("append 8 ints x100000");
+	int testval = 0;
+	for (int n = 0; n < 100000; n++)
+	{
+		SmallArray<int, 8> a;
+		for (int i = 0; i < 8; i++)
+			a.Append(i + n);
+		testval += a.Last();
+	}
+	END_MEASURING;
+	printf("%10u" ERASE10, unsigned(testval));
+	}
+
+	{TEST_CMP;
+	int testval = 0;
+	for (int n = 0; n < 100000; n++)
+	{
+		Array<int> a;
+		for (int i = 0; i < 8; i++)
+			a.Append(i + n);
+		testval += a.Last();
+	}
+	END_MEASURING;
+	printf("%10u" ERASE10, unsigned(testval));
+	}
+	END_TEST_GROUP;
+}
+#undef TEST_CMP
+
+// counts the constructions to check which growth path was used
+static int g_numRelocTestCopies;
+template <bool Reloc>
+struct RelocTestItem
+{
+	int* value;
+
+	RelocTestItem(int v) : value(new int(v)) {}
+	RelocTestItem(const RelocTestItem& o) : value(new int(*o.value)) { g_numRelocTestCopies++; }
+	RelocTestItem(RelocTestItem&& o) : value(o.value) { o.value = nullptr; g_numRelocTestCopies++; }
+	~RelocTestItem() { delete value; }
+	RelocTestItem& operator = (const RelocTestItem&) = delete;
+};
+UI_DECLARE_TRIVIALLY_RELOCATABLE(RelocTestItem<true>);
+
+template <class T>
+static void TestArrayRelocation(bool expectMoves)
+{
+	g_numRelocTestCopies = 0;
+	{
+		Array<T> a;
+		for (int i = 0; i < 1000; i++)
+			a.Append(T(i));
+		int numAfterAppend = g_numRelocTestCopies; // 1000 for the temporaries
+
+		a.RemoveAt(10, 5);
+		a.InsertAt(0, T(-1));
+		a.RemoveAt(500);
+		assert(a.Size() == 995);
+		assert(*a[0].value == -1 && *a[1].value == 0 && *a[10].value == 9 && *a[11].value == 15);
+		for (size_t i = 11; i < 500; i++)
+			assert(*a[i].value == int(i) + 4);
+		for (size_t i = 500; i < a.Size(); i++)
+			assert(*a[i].value == int(i) + 5);
+
+		if (expectMoves)
+			assert(numAfterAppend > 1000 && g_numRelocTestCopies > numAfterAppend + 1);
+		else
+			assert(numAfterAppend == 1000 && g_numRelocTestCopies == numAfterAppend + 1);
+	}
+}
+
+#define TEST_CMP Test _test(" vector:", true)
+DEFINE_TEST(Containers, ArrayRelocation)
+{
+	static_assert(IsTriviallyRelocatable<int>::value, "");
+	static_assert(IsTriviallyRelocatable<RCHandle<RefCountedST>>::value, "");
+	static_assert(!IsTriviallyRelocatable<RelocTestItem<false>>::value, "");
+	static_assert(IsTriviallyRelocatable<RelocTestItem<true>>::value, "");
+
+	TestArrayRelocation<RelocTestItem<false>>(true);
+	TestArrayRelocation<RelocTestItem<true>>(false);
+
+	// growth rounding
+	{
+		Array<u8> a;
+		a.Append(1);
+		assert(a.Capacity() == 16);
+		Array<int> b;
+		for (int i = 0; i < 100000; i++)
+		{
+			size_t cap = b.Capacity();
+			b.Append(i);
+			if (b.Capacity() != cap)
+				assert(b.Capacity() >= cap + cap / 2 && (b.Capacity() * sizeof(int)) % 16 == 0);
+		}
+	}
+
+	{TEST("append u8 x16M");
+	Array<u8> a;
+	for (int i = 0; i < (16 << 20); i++)
+		a.Append(u8(i));
+	END_MEASURING;
+	printf("%10u" ERASE10, unsigned(a.Size()));
+	}
+	{TEST_CMP;
+	std::vector<u8> a;
+	for (int i = 0; i < (16 << 20); i++)
+		a.push_back(u8(i));
+	END_MEASURING;
+	printf("%10u" ERASE10, unsigned(a.size()));
+	}
+	END_TEST_GROUP;
+
+	{TEST("append RCHandle x1M");
+	Array<RCHandle<RefCountedST>> a;
+	RCHandle<RefCountedST> h = new RefCountedST;
+	for (int i = 0; i < (1 << 20); i++)
+		a.Append(h);
+	END_MEASURING;
+	}
+	{TEST_CMP;
+	std::vector<RCHandle<RefCountedST>> a;
+	RCHandle<RefCountedST> h = new RefCountedST;
+	for (int i = 0; i < (1 << 20); i++)
+		a.push_back(h);
+	END_MEASURING;
+	}
+	END_TEST_GROUP;
+}
+#undef TEST_CMP
+
+
+DEFINE_TEST(Containers, ConcurrentHashMap)
+{
+	{
+		ConcurrentHashMap<std::string, int> m;
+		assert(m.Size() == 0);
+		assert(m.Insert("a", 1));
+		assert(!m.Insert("a", 2));
+		assert(m.Insert("b", 3));
+		CHECK_INT_EQ(m.Size(), 2);
+		CHECK_INT_EQ(m.GetValueOrDefault("a"), 2);
+		CHECK_INT_EQ(m.GetValueOrDefault("c", -1), -1);
+		int v = 0;
+		assert(m.TryGetValue("b", v) && v == 3);
+		assert(!m.TryGetValue("c", v));
+		bool created = false;
+		CHECK_INT_EQ(m.GetOrCreate("b", []() { return 4; }, &created), 3);
+		assert(!created);
+		CHECK_INT_EQ(m.GetOrCreate("c", []() { return 5; }, &created), 5);
+		assert(created);
+		int sum = 0;
+		m.ForEach([&sum](const std::string&, int& v) { sum += v; });
+		CHECK_INT_EQ(sum, 10);
+		assert(m.Remove("a"));
+		assert(!m.Remove("a"));
+		assert(!m.Contains("a") && m.Contains("c"));
+		m.Clear();
+		CHECK_INT_EQ(m.Size(), 0);
+	}
+
+	// get-or-create from multiple threads:
+	// the factory must run once per key and every thread must observe the value it produced
+	{
+		constexpr int NUM_THREADS = 8;
+		constexpr int NUM_KEYS = 10000;
+		ConcurrentHashMap<int, int> m;
+		std::atomic<int> nextValue(1);
+		std::atomic<int> numCreateCalls[NUM_KEYS];
+		for (auto& c : numCreateCalls)
+			c.store(0);
+		Array<int> seen[NUM_THREADS];
+
+		Array<std::thread> threads;
+		for (int t = 0; t < NUM_THREADS; t++)
+		{
+			threads.Append(std::thread([&, t]()
+			{
+				seen[t].ResizeWith(NUM_KEYS, 0);
+				for (int i = 0; i < NUM_KEYS; i++)
+				{
+					// every thread walks the keys in a different order
+					int key = (i * 7 + t * 1237) % NUM_KEYS;
+					seen[t][key] = m.GetOrCreate(key, [&]()
+					{
+						numCreateCalls[key]++;
+						return nextValue++;
+					});
+				}
+			}));
+		}
+		for (auto& t : threads)
+			t.join();
+
+		CHECK_INT_EQ(m.Size(), NUM_KEYS);
+		CHECK_INT_EQ(nextValue.load(), NUM_KEYS + 1);
+		for (int i = 0; i < NUM_KEYS; i++)
+		{
+			CHECK_INT_EQ(numCreateCalls[i].load(), 1);
+			int v = m.GetValueOrDefault(i);
+			for (int t = 0; t < NUM_THREADS; t++)
+				CHECK_INT_EQ(seen[t][i], v);
+		}
+	}
+
+	// readers running alongside writers must only ever see missing keys or complete values
+	{
+		constexpr int NUM_WRITERS = 4;
+		constexpr int NUM_READERS = 4;
+		constexpr int NUM_KEYS = 4096;
+		ConcurrentHashMap<int, std::string> m;
+		std::atomic<bool> done(false);
+		std::atomic<int> numBadReads(0);
+
+		Array<std::thread> threads;
+		for (int t = 0; t < NUM_WRITERS; t++)
+		{
+			threads.Append(std::thread([&, t]()
+			{
+				for (int pass = 0; pass < 8; pass++)
+				{
+					for (int i = t; i < NUM_KEYS; i += NUM_WRITERS)
+						m.Insert(i, std::to_string(i * 3));
+					if (pass < 7)
+					{
+						for (int i = t; i < NUM_KEYS; i += NUM_WRITERS * 2)
+							m.Remove(i);
+					}
+				}
+			}));
+		}
+		for (int t = 0; t < NUM_READERS; t++)
+		{
+			threads.Append(std::thread([&, t]()
+			{
+				int i = t;
+				while (!done.load())
+				{
+					std::string v;
+					if (m.TryGetValue(i, v) && v != std::to_string(i * 3))
+						numBadReads++;
+					i = (i + 13) % NUM_KEYS;
+				}
+			}));
+		}
+		for (int t = 0; t < NUM_WRITERS; t++)
+			threads[t].join();
+		done.store(true);
+		for (int t = NUM_WRITERS; t < NUM_WRITERS + NUM_READERS; t++)
+			threads[t].join();
+
+		CHECK_INT_EQ(numBadReads.load(), 0);
+		CHECK_INT_EQ(m.Size(), NUM_KEYS);
+		for (int i = 0; i < NUM_KEYS; i++)
+			assert(m.GetValueOrDefault(i) == std::to_string(i * 3));
+	}
+}
+
 } // ui
 
 #endif // UI_BUILD_TESTS
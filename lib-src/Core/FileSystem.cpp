@@ -189,6 +189,50 @@ bool WriteBinaryFile(StringView path, const void* data, size_t size)
 }
 
 
+struct MappedFileBuffer : IBuffer
+{
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+	void* data = nullptr;
+	size_t size = 0;
+
+	~MappedFileBuffer()
+	{
+		if (data)
+			UnmapViewOfFile(data);
+		if (mapping)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+	}
+	void* Data() const override { return data; }
+	size_t Size() const override { return size; }
+};
+
+FileReadResult MapBinaryFile(StringView path)
+{
+	RCHandle<MappedFileBuffer> buf = new MappedFileBuffer;
+	buf->file = CreateFileW(UTF8toWCHAR(path).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (buf->file == INVALID_HANDLE_VALUE)
+		return { GetLastError() == ERROR_FILE_NOT_FOUND ? IOResult::FileNotFound : IOResult::Unknown };
+
+	LARGE_INTEGER size;
+	if (!::GetFileSizeEx(buf->file, &size))
+		return { IOResult::Unknown };
+	buf->size = size_t(size.QuadPart);
+	if (buf->size == 0)
+		return { IOResult::Success, buf };
+
+	buf->mapping = CreateFileMappingW(buf->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!buf->mapping)
+		return { IOResult::Unknown };
+	buf->data = MapViewOfFile(buf->mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!buf->data)
+		return { IOResult::Unknown };
+
+	return { IOResult::Success, buf };
+}
+
 bool DirectoryExists(StringView path)
 {
 	auto attr = ::GetFileAttributesW(UTF8toWCHAR(path).c_str());
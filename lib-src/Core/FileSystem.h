@@ -63,6 +63,8 @@ FileReadResult ReadTextFile(StringView path);
 bool WriteTextFile(StringView path, StringView text);
 FileReadResult ReadBinaryFile(StringView path);
 bool WriteBinaryFile(StringView path, const void* data, size_t size);
+// maps the whole file into memory (read-only), pages are loaded on first access
+FileReadResult MapBinaryFile(StringView path);
 
 bool DirectoryExists(StringView path);
 bool CreateDirectory(StringView path);
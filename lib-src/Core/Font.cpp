@@ -1,6 +1,11 @@
 
 #include "FontImpl.h"
 
+#include "FontIndex.h"
+#include "MemoryAccounting.h"
+
+#include "../Model/Native.h"
+
 #define STB_TRUETYPE_IMPLEMENTATION
 #include "../../ThirdParty/stb_truetype.h"
 
@@ -25,18 +30,92 @@ bool Font::LoadFromPath(const char* path)
 	return InitFromMemory();
 }
 
-bool Font::InitFromMemory()
+bool Font::InitFromMemory(int offset)
 {
 	if (!data)
 		return false;
-	if (!stbtt_InitFont(&info, (const unsigned char*)data->Data(), 0))
+	if (!stbtt_InitFont(&info, (const unsigned char*)data->Data(), offset))
 		return false;
+	_BuildCoverage();
 	return true;
 }
 
+void Font::_BuildCoverage()
+{
+	coverage.Clear();
+
+	u8* cmap = info.data + info.index_map;
+	u16 format = ttUSHORT(cmap);
+	if (format == 4)
+	{
+		u16 segCount = ttUSHORT(cmap + 6) / 2;
+		u8* endCodes = cmap + 14;
+		u8* startCodes = endCodes + segCount * 2 + 2;
+		u8* idDeltas = startCodes + segCount * 2;
+		u8* idRangeOffsets = idDeltas + segCount * 2;
+
+		coverage.AssignFill(0x10000, false);
+		for (u16 i = 0; i < segCount; i++)
+		{
+			u32 start = ttUSHORT(startCodes + i * 2);
+			u32 end = ttUSHORT(endCodes + i * 2);
+			u16 delta = ttUSHORT(idDeltas + i * 2);
+			u16 rangeOffset = ttUSHORT(idRangeOffsets + i * 2);
+			if (start == 0xffff)
+				continue;
+			for (u32 c = start; c <= end; c++)
+			{
+				u16 glyph;
+				if (rangeOffset == 0)
+					glyph = u16(c + delta);
+				else
+				{
+					glyph = ttUSHORT(idRangeOffsets + i * 2 + rangeOffset + (c - start) * 2);
+					if (glyph)
+						glyph += delta;
+				}
+				if (glyph)
+					coverage.Set1(c);
+			}
+		}
+	}
+	else if (format == 12 || format == 13)
+	{
+		u32 numGroups = ttULONG(cmap + 12);
+		u32 maxCode = 0;
+		for (u32 i = 0; i < numGroups; i++)
+			maxCode = max(maxCode, min(ttULONG(cmap + 16 + i * 12 + 4), u32(0x10ffff)));
+		coverage.AssignFill(maxCode + 1, false);
+
+		for (u32 i = 0; i < numGroups; i++)
+		{
+			u8* group = cmap + 16 + i * 12;
+			u32 start = ttULONG(group);
+			u32 end = min(ttULONG(group + 4), u32(0x10ffff));
+			u32 glyph = ttULONG(group + 8);
+			for (u32 c = start; c <= end; c++)
+			{
+				// format 13 maps the whole group to the same glyph
+				if (format == 13 ? glyph != 0 : glyph + (c - start) != 0)
+					coverage.Set1(c);
+			}
+		}
+	}
+	else
+	{
+		// formats 0 and 6 only map a small range
+		coverage.AssignFill(0x10000, false);
+		for (u32 c = 0; c < 0x10000; c++)
+			if (stbtt_FindGlyphIndex(&info, c))
+				coverage.Set1(c);
+	}
+}
+
 Font::SizeContext& Font::GetSizeContext(int size)
 {
 	auto& sctx = sizes[size];
+	if (sctx.size == size)
+		return sctx;
 	sctx.size = size;
 
 	float scale = stbtt_ScaleForMappingEmToPixels(&info, float(size));
@@ -73,41 +152,230 @@ Font::SizeContext& Font::GetSizeContext(int size)
 	return sctx;
 }
 
-GlyphValue Font::FindGlyph(SizeContext& sctx, uint32_t codepoint, bool needTex)
+GlyphValue* Font::_FindGlyphMetrics(SizeContext& sctx, uint32_t codepoint)
 {
-	GlyphValue* gv = sctx.glyphMap.GetValuePtr(codepoint);
-	if (gv && (!needTex || gv->img))
-		return *gv;
+	if (GlyphValue* gv = sctx.glyphMap.GetValuePtr(codepoint))
+		return gv;
+
+	if (!HasGlyph(codepoint))
+	{
+		if (Font* fallback = _FindFallbackFont(codepoint))
+		{
+			GlyphValue fgv = *fallback->_FindGlyphMetrics(fallback->GetSizeContext(sctx.size), codepoint);
+			GlyphValue* gv = &sctx.glyphMap[codepoint];
+			*gv = fgv;
+			gv->fallbackFont = fallback;
+			return gv;
+		}
+	}
 
 	int glyphID = stbtt_FindGlyphIndex(&info, codepoint);
 	float scale = stbtt_ScaleForMappingEmToPixels(&info, float(sctx.size));
 
-	if (!gv)
+	int xadv = 0, lsb = 0, x0, y0, x1, y1;
+	stbtt_GetGlyphHMetrics(&info, glyphID, &xadv, &lsb);
+	stbtt_GetGlyphBitmapBox(&info, glyphID, scale, scale, &x0, &y0, &x1, &y1);
+	//y0 += sctx.size;
+
+	GlyphValue* gv = &sctx.glyphMap[codepoint];
+	gv->xadv = int16_t(roundf(xadv * scale));
+	gv->xoff = int16_t(x0);
+	gv->yoff = int16_t(y0);
+	gv->w = x1 - x0;
+	gv->h = y1 - y0;
+	return gv;
+}
+
+static u64 g_numRasterizedGlyphs;
+
+GlyphValue Font::FindGlyph(SizeContext& sctx, uint32_t codepoint, bool needTex)
+{
+	GlyphValue* gv = _FindGlyphMetrics(sctx, codepoint);
+
+	if (needTex && !gv->img && gv->fallbackFont)
 	{
-		int xadv = 0, lsb = 0, x0, y0, x1, y1;
-		stbtt_GetGlyphHMetrics(&info, glyphID, &xadv, &lsb);
-		stbtt_GetGlyphBitmapBox(&info, glyphID, scale, scale, &x0, &y0, &x1, &y1);
-		//y0 += sctx.size;
-
-		gv = &sctx.glyphMap[codepoint];
-		gv->xadv = int16_t(roundf(xadv * scale));
-		gv->xoff = int16_t(x0);
-		gv->yoff = int16_t(y0);
-		gv->w = x1 - x0;
-		gv->h = y1 - y0;
+		Font* fallback = gv->fallbackFont;
+		gv->img = fallback->FindGlyph(fallback->GetSizeContext(sctx.size), codepoint, true).img;
+		gv->texPending = false;
 	}
-
-	if (needTex && !gv->img)
+	else if (needTex && !gv->img)
 	{
+		int glyphID = stbtt_FindGlyphIndex(&info, codepoint);
+		float scale = stbtt_ScaleForMappingEmToPixels(&info, float(sctx.size));
+
 		int x, y, w, h;
 		auto* bitmap = stbtt_GetGlyphBitmap(&info, scale, scale, glyphID, &w, &h, &x, &y);
+		MemTagScope memScope(MemTag::Glyphs);
 		gv->img = draw::ImageCreateA8(w, h, bitmap, draw::TexFlags::Packed);
+		gv->texPending = false;
 		stbtt_FreeBitmap(bitmap, nullptr);
+		g_numRasterizedGlyphs++;
 	}
 
 	return *gv;
 }
 
+static bool g_asyncGlyphRasterization = true;
+static size_t g_numPendingGlyphs;
+static Array<JobHandle> g_glyphJobs;
+
+static constexpr size_t MAX_GLYPHS_PER_JOB = 64;
+
+struct GlyphJobItem
+{
+	uint32_t codepoint;
+	int glyphID;
+	int w;
+	int h;
+	Array<u8> bitmap;
+};
+
+static void AddGlyphJob(JobHandle&& job)
+{
+	// drop the finished jobs once in a while
+	if (g_glyphJobs.Size() >= 64)
+	{
+		size_t n = 0;
+		for (size_t i = 0; i < g_glyphJobs.Size(); i++)
+			if (!g_glyphJobs[i].IsDone())
+				g_glyphJobs[n++] = Move(g_glyphJobs[i]);
+		g_glyphJobs.Resize(n);
+	}
+	g_glyphJobs.Append(Move(job));
+}
+
+GlyphValue Font::FindGlyphAsync(SizeContext& sctx, uint32_t codepoint)
+{
+	GlyphValue* gv = _FindGlyphMetrics(sctx, codepoint);
+	if (gv->img)
+		return *gv;
+
+	// the fallback font keeps track of its own rasterization
+	if (gv->fallbackFont)
+	{
+		Font* fallback = gv->fallbackFont;
+		gv->img = fallback->FindGlyphAsync(fallback->GetSizeContext(sctx.size), codepoint).img;
+		return *gv;
+	}
+	if (gv->texPending)
+		return *gv;
+
+	// empty glyphs have nothing to rasterize
+	if (!g_asyncGlyphRasterization || !gv->w || !gv->h)
+		return FindGlyph(sctx, codepoint, true);
+
+	_QueueGlyphRasterization(sctx, &codepoint, 1);
+	return *sctx.glyphMap.GetValuePtr(codepoint);
+}
+
+// the glyphs found in one of the fallback fonts, queued in one batch per font
+struct FallbackGlyphs
+{
+	Font* font;
+	Array<uint32_t> codepoints;
+};
+
+void Font::_QueueGlyphRasterization(SizeContext& sctx, const uint32_t* codepoints, size_t count)
+{
+	float scale = stbtt_ScaleForMappingEmToPixels(&info, float(sctx.size));
+	Array<FallbackGlyphs> fallbacks;
+
+	for (size_t start = 0; start < count; start += MAX_GLYPHS_PER_JOB)
+	{
+		size_t end = min(count, start + MAX_GLYPHS_PER_JOB);
+
+		Array<GlyphJobItem> items;
+		for (size_t i = start; i < end; i++)
+		{
+			uint32_t codepoint = codepoints[i];
+			GlyphValue* gv = _FindGlyphMetrics(sctx, codepoint);
+			if (gv->img || gv->texPending)
+				continue;
+			if (gv->fallbackFont)
+			{
+				FallbackGlyphs* fg = nullptr;
+				for (auto& F : fallbacks)
+				{
+					if (F.font == gv->fallbackFont)
+					{
+						fg = &F;
+						break;
+					}
+				}
+				if (!fg)
+				{
+					fallbacks.Append({ gv->fallbackFont, {} });
+					fg = &fallbacks.Last();
+				}
+				fg->codepoints.Append(codepoint);
+				continue;
+			}
+			if (!gv->w || !gv->h)
+			{
+				FindGlyph(sctx, codepoint, true);
+				continue;
+			}
+			gv->texPending = true;
+			items.Append({ codepoint, stbtt_FindGlyphIndex(&info, codepoint), gv->w, gv->h });
+		}
+		if (items.IsEmpty())
+			continue;
+
+		g_numPendingGlyphs += items.Size();
+
+		// the font info is copied so that each job reads it independently,
+		// the data buffer is referenced to keep it alive if the font is freed in the meantime
+		AddGlyphJob(ThreadPool::Get().Run([
+			font{ this },
+			lt{ GetLivenessToken() },
+			fontData{ data },
+			fontInfo{ info },
+			size{ sctx.size },
+			scale,
+			items{ Move(items) }]() mutable
+		{
+			for (auto& item : items)
+			{
+				if (ThreadPool::IsCurrentJobCancelled())
+					return;
+				item.bitmap.ResizeWithZeroes(size_t(item.w) * size_t(item.h));
+				stbtt_MakeGlyphBitmap(&fontInfo, item.bitmap.Data(), item.w, item.h, item.w, scale, scale, item.glyphID);
+			}
+
+			Application::PushEvent([font, lt, size, items{ Move(items) }]()
+			{
+				g_numPendingGlyphs -= items.Size();
+				if (!lt.IsAlive())
+					return;
+				auto* sctx = font->sizes.GetValuePtr(size);
+				if (!sctx)
+					return;
+				MemTagScope memScope(MemTag::Glyphs);
+				for (auto& item : items)
+				{
+					GlyphValue* gv = sctx->glyphMap.GetValuePtr(item.codepoint);
+					// may have been rasterized synchronously in the meantime
+					if (!gv || gv->img)
+						continue;
+					gv->img = draw::ImageCreateA8(item.w, item.h, item.bitmap.Data(), draw::TexFlags::Packed);
+					gv->texPending = false;
+					g_numRasterizedGlyphs++;
+				}
+				Application::InvalidateAllWindows();
+			});
+		}, JobPriority::High));
+	}
+
+	for (auto& F : fallbacks)
+	{
+		auto& fsctx = F.font->GetSizeContext(sctx.size);
+		F.font->_QueueGlyphRasterization(fsctx, F.codepoints.Data(), F.codepoints.Size());
+		// the rest are picked up by FindGlyphAsync after their jobs are done
+		for (uint32_t codepoint : F.codepoints)
+			sctx.glyphMap.GetValuePtr(codepoint)->img = fsctx.glyphMap.GetValuePtr(codepoint)->img;
+	}
+}
+
 float Font::FindKerning(int size, u32 prevCP, u32 currCP)
 {
 	float scale = stbtt_ScaleForMappingEmToPixels(&info, float(size));
@@ -121,6 +389,94 @@ float Font::FindKerning(int size, u32 prevCP, u32 currCP)
 }
 
 
+static HashMap<std::string, Array<std::string>> g_fontFallbacks;
+static bool g_fontFallbacksInited;
+
+static void InitDefaultFontFallbacks()
+{
+	if (g_fontFallbacksInited)
+		return;
+	g_fontFallbacksInited = true;
+
+	// symbols, emoji, CJK, Korean, Indic
+	static const StringView defaults[] =
+	{
+		"Segoe UI Symbol",
+		"Segoe UI Emoji",
+		"Microsoft YaHei",
+		"Malgun Gothic",
+		"Nirmala UI",
+	};
+	for (const char* family : { FONT_FAMILY_SANS_SERIF, FONT_FAMILY_SERIF, FONT_FAMILY_MONOSPACE })
+	{
+		auto& chain = g_fontFallbacks[family];
+		for (StringView name : defaults)
+			chain.Append(to_string(name));
+	}
+}
+
+static bool FontExists(const char* name);
+
+Font* Font::_FindFallbackFont(uint32_t codepoint)
+{
+	for (size_t i = 0; ; i++)
+	{
+		// load the next font in the chain only if none of the previous ones have the glyph
+		while (i == _fallbacks.Size())
+		{
+			InitDefaultFontFallbacks();
+			auto* chain = g_fontFallbacks.GetValuePtr(_fallbackKey);
+			if (!chain || _numFallbacksTried >= chain->Size())
+				return nullptr;
+
+			const std::string& name = (*chain)[_numFallbacksTried++];
+			if (!FontExists(name.c_str()))
+				continue;
+			Font* font = GetFontByName(name.c_str(), key.weight >= 0 ? key.weight : FONT_WEIGHT_NORMAL, key.italic);
+			if (font != this && font->coverage.Size())
+				_fallbacks.Append(font);
+		}
+
+		if (_fallbacks[i]->HasGlyph(codepoint))
+			return _fallbacks[i];
+	}
+}
+
+void Font::_ResetFallbacks()
+{
+	_fallbacks.Clear();
+	_numFallbacksTried = 0;
+	// cached glyphs may have been taken from the previous fallbacks
+	for (auto sctx : sizes)
+		sctx.value.glyphMap.Clear();
+}
+
+void SetFontFallbacks(const char* nameOrFamily, ArrayView<StringView> fallbackNames)
+{
+	InitDefaultFontFallbacks();
+
+	auto& chain = g_fontFallbacks[nameOrFamily];
+	chain.Clear();
+	for (StringView name : fallbackNames)
+		chain.Append(to_string(name));
+
+	for (auto font : g_loadedFonts)
+		font.value->_ResetFallbacks();
+}
+
+bool FontHasGlyph(Font* font, uint32_t codepoint)
+{
+	return font->HasGlyph(codepoint);
+}
+
+Font* FindFontForCodepoint(Font* font, uint32_t codepoint)
+{
+	if (font->HasGlyph(codepoint))
+		return font;
+	return font->_FindFallbackFont(codepoint);
+}
+
+
 struct FontEnumData
 {
 	int weight;
@@ -163,6 +519,18 @@ static BufferHandle FindFontDataByName(const char* name, int weight, bool italic
 	return ret;
 }
 
+static bool FontExists(const char* name)
+{
+	if (FontIndexGetNumEntries())
+		return FontIndexHasFamily(name);
+
+	FontEnumData fed = { FONT_WEIGHT_NORMAL, false };
+	HDC dc = GetDC(nullptr);
+	EnumFontFamiliesA(dc, name, _FontEnumCallback, (LPARAM)&fed);
+	ReleaseDC(nullptr, dc);
+	return fed.lastProximity != INT_MAX;
+}
+
 static Font* FindExistingFont(const FontKey& key)
 {
 	if (auto* pp = g_loadedFonts.GetValuePtr(key))
@@ -178,6 +546,7 @@ Font* GetFontByPath(const char* path)
 	auto* font = new Font;
 	font->LoadFromPath(path);
 	font->key = key;
+	font->_fallbackKey = path;
 	g_loadedFonts[key] = font;
 	return font;
 }
@@ -188,21 +557,40 @@ Font* GetFontByName(const char* name, int weight, bool italic)
 	if (auto* f = FindExistingFont(key))
 		return f;
 	Font* font = new Font;
-	font->data = FindFontDataByName(name, weight, italic);
-	font->InitFromMemory();
+	// the system font enumeration is only used if the font is not in the index
+	int offset = -1;
+	if (auto* e = FontIndexFind(name, weight, italic))
+		offset = FontIndexMapFace(*e, font->data);
+	if (offset < 0)
+	{
+		font->data = FindFontDataByName(name, weight, italic);
+		offset = 0;
+	}
+	font->InitFromMemory(offset);
 	font->key = key;
+	font->_fallbackKey = name;
 	g_loadedFonts[key] = font;
 	return font;
 }
 
+static Font* UseFamilyFallbacks(Font* font, const char* family)
+{
+	if (font->_fallbackKey != family)
+	{
+		font->_fallbackKey = family;
+		font->_ResetFallbacks();
+	}
+	return font;
+}
+
 Font* GetFontByFamily(const char* family, int weight, bool italic)
 {
 	if (strcmp(family, FONT_FAMILY_SANS_SERIF) == 0)
-		return GetFontByName("Segoe UI", weight, italic);
+		return UseFamilyFallbacks(GetFontByName("Segoe UI", weight, italic), family);
 	if (strcmp(family, FONT_FAMILY_SERIF) == 0)
-		return GetFontByName("Times New Roman", weight, italic);
+		return UseFamilyFallbacks(GetFontByName("Times New Roman", weight, italic), family);
 	if (strcmp(family, FONT_FAMILY_MONOSPACE) == 0)
-		return GetFontByName("Consolas", weight, italic);
+		return UseFamilyFallbacks(GetFontByName("Consolas", weight, italic), family);
 	return nullptr;
 }
 
@@ -244,20 +632,120 @@ float GetTextWidth(Font* font, int size, StringView text)
 	float out = 0;
 	u32 prevChar = 0;
 
-	UTF8Iterator it(text);
-	for (;;)
+	uint32_t codepoints[128];
+	size_t pos = 0;
+	while (size_t num = UTF8Decode(text, pos, codepoints, 128))
 	{
-		uint32_t ch = it.Read();
-		if (ch == UTF8Iterator::END)
-			break;
-
-		float kern = font->FindKerning(sctx.size, prevChar, ch);
-		prevChar = ch;
-		out += roundf(font->FindGlyph(sctx, ch, false).xadv + kern);
+		for (size_t i = 0; i < num; i++)
+		{
+			uint32_t ch = codepoints[i];
+			float kern = font->FindKerning(sctx.size, prevChar, ch);
+			prevChar = ch;
+			out += roundf(font->FindGlyph(sctx, ch, false).xadv + kern);
+		}
 	}
 	return out * invScale;
 }
 
+// glyph advances of the first 256 codepoints, used for measuring many strings at once
+// only reads the font data after creation, so it can be used from worker threads
+struct TextMeasureTable
+{
+	Font* font;
+	Font::SizeContext* sctx;
+	float scale;
+	bool hasKerning;
+	int16_t xadv[256];
+	int glyphs[256];
+
+	void Init(Font* f, int size)
+	{
+		font = f;
+		sctx = &f->GetSizeContext(int(roundf(size * g_textResScale)));
+		scale = stbtt_ScaleForMappingEmToPixels(&f->info, float(sctx->size));
+		hasKerning = f->info.kern || f->info.gpos;
+		for (uint32_t c = 0; c < 256; c++)
+		{
+			xadv[c] = f->FindGlyph(*sctx, c, false).xadv;
+			glyphs[c] = hasKerning ? stbtt_FindGlyphIndex(&f->info, c) : 0;
+		}
+	}
+
+	// returns a negative value if the text has codepoints outside the table
+	float MeasureFast(StringView text) const
+	{
+		float out = 0;
+		uint32_t prevChar = 0;
+		uint32_t codepoints[128];
+		size_t pos = 0;
+		while (size_t num = UTF8Decode(text, pos, codepoints, 128))
+		{
+			for (size_t i = 0; i < num; i++)
+			{
+				uint32_t ch = codepoints[i];
+				if (ch >= 256)
+					return -1;
+
+				float kern = hasKerning ? stbtt_GetGlyphKernAdvance(&font->info, glyphs[prevChar], glyphs[ch]) * scale : 0;
+				prevChar = ch;
+				out += roundf(xadv[ch] + kern);
+			}
+		}
+		return out / g_textResScale;
+	}
+};
+
+void GetTextWidths(Font* font, int size, ArrayView<StringView> texts, float* outWidths, bool parallel)
+{
+	if (size <= 0)
+	{
+		for (size_t i = 0; i < texts.Size(); i++)
+			outWidths[i] = 0;
+		return;
+	}
+
+	TextMeasureTable table;
+	table.Init(font, size);
+
+	// the table is only read by the measuring jobs
+	constexpr size_t MIN_TEXTS_PER_JOB = 1024;
+	auto measureRange = [&table, &texts, outWidths](size_t from, size_t to)
+	{
+		for (size_t i = from; i < to; i++)
+			outWidths[i] = table.MeasureFast(texts[i]);
+	};
+	if (parallel && texts.Size() > MIN_TEXTS_PER_JOB)
+		ThreadPool::Get().ParallelFor(texts.Size(), MIN_TEXTS_PER_JOB, measureRange);
+	else
+		measureRange(0, texts.Size());
+
+	// the glyph cache can only be updated on this thread
+	for (size_t i = 0; i < texts.Size(); i++)
+		if (outWidths[i] < 0)
+			outWidths[i] = GetTextWidth(font, size, texts[i]);
+}
+
+void GetTextWidths(Font* font, int size, size_t count, const std::function<StringView(size_t, std::string&)>& getText, float* outWidths)
+{
+	if (size <= 0)
+	{
+		for (size_t i = 0; i < count; i++)
+			outWidths[i] = 0;
+		return;
+	}
+
+	TextMeasureTable table;
+	table.Init(font, size);
+
+	std::string buf;
+	for (size_t i = 0; i < count; i++)
+	{
+		StringView text = getText(i, buf);
+		float w = table.MeasureFast(text);
+		outWidths[i] = w >= 0 ? w : GetTextWidth(font, size, text);
+	}
+}
+
 static Font* g_tmFont;
 static Font::SizeContext* g_tmSizeCtx;
 static float g_tmInvScale;
@@ -294,6 +782,70 @@ float TextMeasureAddChar(uint32_t ch)
 }
 
 
+bool GetAsyncGlyphRasterization()
+{
+	return g_asyncGlyphRasterization;
+}
+
+bool SetAsyncGlyphRasterization(bool enable)
+{
+	bool r = g_asyncGlyphRasterization;
+	g_asyncGlyphRasterization = enable;
+	return r;
+}
+
+void PrewarmGlyphs(Font* font, int size, StringView charset)
+{
+	if (size <= 0)
+		return;
+
+	Array<uint32_t> codepoints;
+	codepoints.Resize(charset.size()); // at most one codepoint per byte
+	size_t pos = 0;
+	codepoints.Resize(UTF8Decode(charset, pos, codepoints.Data(), codepoints.Size()));
+
+	auto& sctx = font->GetSizeContext(int(roundf(size * g_textResScale)));
+	font->_QueueGlyphRasterization(sctx, codepoints.Data(), codepoints.Size());
+}
+
+void PrewarmGlyphRange(Font* font, int size, uint32_t firstCodepoint, uint32_t lastCodepoint)
+{
+	if (size <= 0 || firstCodepoint > lastCodepoint)
+		return;
+
+	Array<uint32_t> codepoints;
+	codepoints.Reserve(lastCodepoint - firstCodepoint + 1);
+	for (uint32_t ch = firstCodepoint; ; ch++)
+	{
+		codepoints.Append(ch);
+		if (ch == lastCodepoint)
+			break;
+	}
+
+	auto& sctx = font->GetSizeContext(int(roundf(size * g_textResScale)));
+	font->_QueueGlyphRasterization(sctx, codepoints.Data(), codepoints.Size());
+}
+
+size_t GetNumPendingGlyphs()
+{
+	return g_numPendingGlyphs;
+}
+
+u64 GetNumRasterizedGlyphs()
+{
+	return g_numRasterizedGlyphs;
+}
+
+void StopGlyphRasterizationJobs()
+{
+	for (auto& job : g_glyphJobs)
+		job.Cancel();
+	for (auto& job : g_glyphJobs)
+		job.Wait();
+	g_glyphJobs.Clear();
+}
+
+
 Font* CachedFontRef::GetCachedFont(const char* nameOrFamily, int weight, bool italic) const
 {
 	if (_cachedFont &&
@@ -4,6 +4,7 @@
 #include "String.h"
 #include "Image.h"
 
+#include <functional>
 #include <string>
 
 
@@ -23,17 +24,42 @@ Font* GetFontByName(const char* name, int weight = FONT_WEIGHT_NORMAL, bool ital
 Font* GetFontByFamily(const char* family, int weight = FONT_WEIGHT_NORMAL, bool italic = false);
 Font* GetFont(const char* nameOrFamily, int weight = FONT_WEIGHT_NORMAL, bool italic = false);
 
+// fonts that provide the glyphs for codepoints missing in the fonts of a family (or a font name), in order of preference
+// the fallback fonts are loaded on first use, with the weight/style of the primary font
+void SetFontFallbacks(const char* nameOrFamily, ArrayView<StringView> fallbackNames);
+bool FontHasGlyph(Font* font, uint32_t codepoint);
+// returns the font or one of its fallbacks that has the glyph (or nullptr if none have it)
+Font* FindFontForCodepoint(Font* font, uint32_t codepoint);
+
 float GetTextResolutionScale();
 float SetTextResolutionScale(float ntrs);
 float MultiplyTextResolutionScale(float ntrs);
 
 float GetTextWidth(Font* font, int size, StringView text);
+// batch measurement, returns the same widths as GetTextWidth
+// - with parallel = true, big batches are split across the thread pool
+void GetTextWidths(Font* font, int size, ArrayView<StringView> texts, float* outWidths, bool parallel = false);
+// - the callback returns the text at the index, the view may point into the buffer (reused for all texts)
+void GetTextWidths(Font* font, int size, size_t count, const std::function<StringView(size_t, std::string&)>& getText, float* outWidths);
 // ongoing measurement
 void TextMeasureBegin(Font* font, int size);
 void TextMeasureEnd();
 void TextMeasureReset();
 float TextMeasureAddChar(uint32_t ch);
 
+// background glyph rasterization
+// when enabled, glyphs that are drawn for the first time are rasterized on worker threads
+// and skipped while drawing (their metrics are still used for layout) until they are ready
+bool GetAsyncGlyphRasterization();
+bool SetAsyncGlyphRasterization(bool enable);
+// queue rasterization of all codepoints in the charset (UTF-8) / range (inclusive) in the background
+void PrewarmGlyphs(Font* font, int size, StringView charset);
+void PrewarmGlyphRange(Font* font, int size, uint32_t firstCodepoint, uint32_t lastCodepoint);
+size_t GetNumPendingGlyphs();
+// the total number of glyph images created (on the main thread, after synchronous or background rasterization)
+u64 GetNumRasterizedGlyphs();
+void StopGlyphRasterizationJobs();
+
 enum class TextHAlign
 {
 	Left,
@@ -3,8 +3,10 @@
 
 #include "Font.h"
 
+#include "BitArray.h"
 #include "FileSystem.h"
 #include "HashMap.h"
+#include "WeakPtr.h"
 #include "../Render/Render.h"
 
 #include "../../ThirdParty/stb_truetype.h"
@@ -42,6 +44,9 @@ struct GlyphValue
 	int16_t xoff;
 	int16_t yoff;
 	int16_t xadv;
+	bool texPending = false;
+	// set if the codepoint is missing in the font and the glyph is taken from a fallback font
+	Font* fallbackFont = nullptr;
 };
 
 
@@ -61,14 +66,32 @@ struct Font
 	stbtt_fontinfo info;
 	HashMap<int, SizeContext> sizes;
 	HashMap<u64, int> kerning;
+	// codepoints that map to a glyph (built from the cmap once)
+	BitArray coverage;
+
+	// name or family of the fallback chain
+	std::string _fallbackKey;
+	Array<Font*> _fallbacks;
+	size_t _numFallbacksTried = 0;
+
+	UI_DECLARE_WEAK_PTR_COMPATIBLE;
 
 	~Font();
 
 	bool LoadFromPath(const char* path);
-	bool InitFromMemory();
+	bool InitFromMemory(int offset = 0);
+	void _BuildCoverage();
+
+	UI_FORCEINLINE bool HasGlyph(uint32_t codepoint) const { return codepoint < coverage.Size() && coverage.GetUnchecked(codepoint); }
+	Font* _FindFallbackFont(uint32_t codepoint);
+	void _ResetFallbacks();
 
 	SizeContext& GetSizeContext(int size);
+	GlyphValue* _FindGlyphMetrics(SizeContext& sctx, uint32_t codepoint);
 	GlyphValue FindGlyph(SizeContext& sctx, uint32_t codepoint, bool needTex);
+	// returns the texture only if it's ready, otherwise queues background rasterization
+	GlyphValue FindGlyphAsync(SizeContext& sctx, uint32_t codepoint);
+	void _QueueGlyphRasterization(SizeContext& sctx, const uint32_t* codepoints, size_t count);
 	float FindKerning(int size, u32 prevCP, u32 currCP);
 };
 
@@ -0,0 +1,612 @@
+
+#include "FontIndex.h"
+
+#include "Font.h"
+
+#include "HashMap.h"
+#include "Logging.h"
+#include "Threading.h"
+
+
+namespace ui {
+
+LogCategory LOG_FONT_INDEX("FontIndex");
+
+static constexpr u32 FONT_INDEX_CACHE_MAGIC = 0x49464955; // "UIFI"
+static constexpr u32 FONT_INDEX_CACHE_VERSION = 1;
+
+struct FontDirStamp
+{
+	std::string path;
+	u64 modTime;
+};
+
+static Array<std::string> g_fontDirs;
+static bool g_fontDirsSet;
+static std::string g_fontIndexCachePath;
+static bool g_fontIndexCachePathSet;
+
+static bool g_fontIndexBuilt;
+static Array<FontIndexEntry> g_fontIndexEntries;
+static HashMap<std::string, Array<u32>> g_fontIndexFamilies;
+
+
+static std::string FamilyKey(StringView name)
+{
+	std::string key = to_string(name);
+	for (char& c : key)
+		c = ToLower(c);
+	return key;
+}
+
+static void GetDefaultFontDirectories(Array<std::string>& out)
+{
+#ifdef _WIN32
+	const char* windir = getenv("WINDIR");
+	out.Append(PathJoin(PathFromSystem(windir ? windir : "C:/Windows"), "Fonts"));
+	std::string localAppData = GetSystemDirPath(SystemDirectoryType::Windows_LocalAppData);
+	if (!localAppData.empty())
+		out.Append(PathJoin(localAppData, "Microsoft/Windows/Fonts"));
+#else
+	const char* home = getenv("HOME");
+#ifdef __APPLE__
+	out.Append("/System/Library/Fonts");
+	out.Append("/Library/Fonts");
+	if (home)
+		out.Append(PathJoin(home, "Library/Fonts"));
+#else
+	out.Append("/usr/share/fonts");
+	out.Append("/usr/local/share/fonts");
+	if (home)
+	{
+		out.Append(PathJoin(home, ".local/share/fonts"));
+		out.Append(PathJoin(home, ".fonts"));
+	}
+#endif
+#endif
+}
+
+static std::string GetDefaultFontIndexCachePath()
+{
+#ifdef _WIN32
+	std::string dir = GetSystemDirPath(SystemDirectoryType::Windows_LocalAppData);
+#else
+	const char* home = getenv("HOME");
+	std::string dir = home ? PathJoin(home, ".cache") : std::string();
+#endif
+	if (dir.empty())
+		return {};
+	return PathJoin(dir, "ToolUILib/fontindex.bin");
+}
+
+
+static bool IsFontFileName(StringView name)
+{
+	StringView ext = name.substr(name.size() >= 4 ? name.size() - 4 : 0);
+	return ext.EqualToCI(".ttf") || ext.EqualToCI(".otf") || ext.EqualToCI(".ttc") || ext.EqualToCI(".otc");
+}
+
+static void ScanFontDirectory(StringView dir, Array<std::string>& outFiles, Array<FontDirStamp>& outDirs)
+{
+	outDirs.Append({ to_string(dir), GetFileModTimeUnixMS(dir) });
+
+	auto it = CreateDirectoryIterator(dir);
+	std::string name;
+	while (it->GetNext(name))
+	{
+		std::string path = PathJoin(dir, name);
+		unsigned attr = GetFileAttributes(path);
+		if (attr & FA_Directory)
+		{
+			if (!(attr & FA_Symlink))
+				ScanFontDirectory(path, outFiles, outDirs);
+		}
+		else if (IsFontFileName(name))
+			outFiles.Append(Move(path));
+	}
+}
+
+
+// big endian readers with bounds checking (font files may be truncated or corrupted)
+struct FontDataReader
+{
+	const u8* data;
+	size_t size;
+
+	UI_FORCEINLINE bool Has(size_t off, size_t n) const { return off <= size && n <= size - off; }
+	UI_FORCEINLINE u16 U16(size_t off) const { return Has(off, 2) ? u16((data[off] << 8) | data[off + 1]) : 0; }
+	UI_FORCEINLINE u32 U32(size_t off) const { return Has(off, 4) ? (u32(data[off]) << 24) | (u32(data[off + 1]) << 16) | (u32(data[off + 2]) << 8) | data[off + 3] : 0; }
+
+	// returns the offset of the table or 0 if not found
+	size_t FindTable(size_t faceOffset, const char* tag, size_t& outLength) const
+	{
+		u16 numTables = U16(faceOffset + 4);
+		for (u16 i = 0; i < numTables; i++)
+		{
+			size_t rec = faceOffset + 12 + i * 16;
+			if (!Has(rec, 16))
+				break;
+			if (memcmp(data + rec, tag, 4) == 0)
+			{
+				size_t off = U32(rec + 8);
+				outLength = U32(rec + 12);
+				if (!Has(off, outLength))
+					return 0;
+				return off;
+			}
+		}
+		return 0;
+	}
+};
+
+static void AppendUTF8(std::string& out, u32 c)
+{
+	if (c < 0x80)
+		out.push_back(char(c));
+	else if (c < 0x800)
+	{
+		out.push_back(char(0xC0 | (c >> 6)));
+		out.push_back(char(0x80 | (c & 0x3F)));
+	}
+	else if (c < 0x10000)
+	{
+		out.push_back(char(0xE0 | (c >> 12)));
+		out.push_back(char(0x80 | ((c >> 6) & 0x3F)));
+		out.push_back(char(0x80 | (c & 0x3F)));
+	}
+	else
+	{
+		out.push_back(char(0xF0 | (c >> 18)));
+		out.push_back(char(0x80 | ((c >> 12) & 0x3F)));
+		out.push_back(char(0x80 | ((c >> 6) & 0x3F)));
+		out.push_back(char(0x80 | (c & 0x3F)));
+	}
+}
+
+static std::string ReadFontName(const FontDataReader& r, size_t nameTable, size_t nameLength, u16 nameID)
+{
+	u16 count = r.U16(nameTable + 2);
+	size_t strings = nameTable + r.U16(nameTable + 4);
+
+	// prefer Windows/Unicode/English, then any Windows/Unicode, then Mac/Roman
+	int bestScore = 0;
+	size_t bestRec = 0;
+	for (u16 i = 0; i < count; i++)
+	{
+		size_t rec = nameTable + 6 + i * 12;
+		if (rec + 12 > nameTable + nameLength)
+			break;
+		if (r.U16(rec + 6) != nameID)
+			continue;
+		u16 platform = r.U16(rec);
+		u16 encoding = r.U16(rec + 2);
+		u16 language = r.U16(rec + 4);
+
+		int score = 0;
+		if (platform == 3 && (encoding == 1 || encoding == 10))
+			score = language == 0x409 ? 3 : 2;
+		else if (platform == 1 && encoding == 0 && language == 0)
+			score = 1;
+		if (score > bestScore)
+		{
+			bestScore = score;
+			bestRec = rec;
+		}
+	}
+
+	std::string ret;
+	if (!bestScore)
+		return ret;
+
+	size_t len = r.U16(bestRec + 8);
+	size_t off = strings + r.U16(bestRec + 10);
+	if (!r.Has(off, len))
+		return ret;
+
+	if (bestScore == 1)
+	{
+		// ASCII subset of Mac Roman
+		for (size_t i = 0; i < len; i++)
+			if (r.data[off + i] < 0x80)
+				ret.push_back(char(r.data[off + i]));
+		return ret;
+	}
+
+	// UTF-16BE
+	for (size_t i = 0; i + 1 < len; i += 2)
+	{
+		u32 c = r.U16(off + i);
+		if (c >= 0xD800 && c < 0xDC00 && i + 3 < len)
+		{
+			u32 lo = r.U16(off + i + 2);
+			if (lo >= 0xDC00 && lo < 0xE000)
+			{
+				c = 0x10000 + ((c - 0xD800) << 10) + (lo - 0xDC00);
+				i += 2;
+			}
+		}
+		AppendUTF8(ret, c);
+	}
+	return ret;
+}
+
+static bool ParseFontFace(const FontDataReader& r, size_t faceOffset, FontIndexEntry& e)
+{
+	size_t nameLength = 0;
+	size_t nameTable = r.FindTable(faceOffset, "name", nameLength);
+	if (!nameTable)
+		return false;
+
+	e.family = ReadFontName(r, nameTable, nameLength, 1);
+	if (e.family.empty())
+		return false;
+	e.typoFamily = ReadFontName(r, nameTable, nameLength, 16);
+	if (e.typoFamily == e.family)
+		e.typoFamily.clear();
+
+	e.weight = FONT_WEIGHT_NORMAL;
+	e.italic = false;
+	for (u32& v : e.unicodeRanges)
+		v = 0;
+	for (u32& v : e.codePageRanges)
+		v = 0;
+
+	size_t os2Length = 0;
+	size_t os2 = r.FindTable(faceOffset, "OS/2", os2Length);
+	if (os2 && os2Length >= 64)
+	{
+		u16 version = r.U16(os2);
+		e.weight = r.U16(os2 + 4);
+		e.italic = (r.U16(os2 + 62) & ((1 << 0) | (1 << 9))) != 0; // italic | oblique
+		for (int i = 0; i < 4; i++)
+			e.unicodeRanges[i] = r.U32(os2 + 42 + i * 4);
+		if (version >= 1 && os2Length >= 86)
+		{
+			e.codePageRanges[0] = r.U32(os2 + 78);
+			e.codePageRanges[1] = r.U32(os2 + 82);
+		}
+	}
+	else
+	{
+		size_t headLength = 0;
+		size_t head = r.FindTable(faceOffset, "head", headLength);
+		if (head && headLength >= 46)
+		{
+			u16 macStyle = r.U16(head + 44);
+			e.weight = macStyle & 1 ? FONT_WEIGHT_BOLD : FONT_WEIGHT_NORMAL;
+			e.italic = (macStyle & 2) != 0;
+		}
+	}
+	return true;
+}
+
+static void ParseFontFile(const std::string& path, Array<FontIndexEntry>& out)
+{
+	auto frr = MapBinaryFile(path);
+	if (frr.result != IOResult::Success || !frr.data)
+		return;
+
+	FontDataReader r = { static_cast<const u8*>(frr.data->Data()), frr.data->Size() };
+	if (!r.Has(0, 12))
+		return;
+
+	if (memcmp(r.data, "ttcf", 4) == 0)
+	{
+		u32 numFonts = r.U32(8);
+		for (u32 i = 0; i < numFonts && r.Has(12 + i * 4, 4); i++)
+		{
+			FontIndexEntry e;
+			if (ParseFontFace(r, r.U32(12 + i * 4), e))
+			{
+				e.path = path;
+				e.faceIndex = i;
+				out.Append(Move(e));
+			}
+		}
+	}
+	else
+	{
+		FontIndexEntry e;
+		if (ParseFontFace(r, 0, e))
+		{
+			e.path = path;
+			e.faceIndex = 0;
+			out.Append(Move(e));
+		}
+	}
+}
+
+
+struct FontIndexCacheWriter
+{
+	std::string data;
+
+	void U8(u8 v) { data.push_back(char(v)); }
+	void U32(u32 v) { data.append(reinterpret_cast<const char*>(&v), 4); }
+	void U64(u64 v) { data.append(reinterpret_cast<const char*>(&v), 8); }
+	void Str(StringView s)
+	{
+		U32(u32(s.size()));
+		data.append(s.data(), s.size());
+	}
+};
+
+struct FontIndexCacheReader
+{
+	StringView data;
+	size_t pos = 0;
+	bool error = false;
+
+	bool Read(void* out, size_t n)
+	{
+		if (error || n > data.size() - pos)
+		{
+			error = true;
+			memset(out, 0, n);
+			return false;
+		}
+		memcpy(out, data.data() + pos, n);
+		pos += n;
+		return true;
+	}
+	u8 U8() { u8 v; Read(&v, 1); return v; }
+	u32 U32() { u32 v; Read(&v, 4); return v; }
+	u64 U64() { u64 v; Read(&v, 8); return v; }
+	std::string Str()
+	{
+		u32 len = U32();
+		if (error || len > data.size() - pos)
+		{
+			error = true;
+			return {};
+		}
+		std::string ret(data.data() + pos, len);
+		pos += len;
+		return ret;
+	}
+};
+
+static bool LoadFontIndexCache(StringView path, Array<FontIndexEntry>& outEntries)
+{
+	auto frr = ReadBinaryFile(path);
+	if (frr.result != IOResult::Success || !frr.data)
+		return false;
+
+	FontIndexCacheReader r;
+	r.data = frr.data->GetStringView();
+	if (r.U32() != FONT_INDEX_CACHE_MAGIC || r.U32() != FONT_INDEX_CACHE_VERSION)
+		return false;
+
+	// the same root directories must be indexed
+	u32 numRoots = r.U32();
+	if (r.error || numRoots != g_fontDirs.Size())
+		return false;
+	for (u32 i = 0; i < numRoots; i++)
+		if (r.Str() != g_fontDirs[i])
+			return false;
+
+	// adding/removing files changes the modification time of the containing directory
+	u32 numDirs = r.U32();
+	for (u32 i = 0; i < numDirs && !r.error; i++)
+	{
+		std::string dir = r.Str();
+		u64 modTime = r.U64();
+		if (GetFileModTimeUnixMS(dir) != modTime)
+			return false;
+	}
+
+	u32 numEntries = r.U32();
+	for (u32 i = 0; i < numEntries && !r.error; i++)
+	{
+		FontIndexEntry e;
+		e.path = r.Str();
+		e.faceIndex = r.U32();
+		e.family = r.Str();
+		e.typoFamily = r.Str();
+		e.weight = int(r.U32());
+		e.italic = r.U8() != 0;
+		for (u32& v : e.unicodeRanges)
+			v = r.U32();
+		for (u32& v : e.codePageRanges)
+			v = r.U32();
+		outEntries.Append(Move(e));
+	}
+	return !r.error;
+}
+
+static void SaveFontIndexCache(StringView path, ArrayView<FontDirStamp> dirs, ArrayView<FontIndexEntry> entries)
+{
+	FontIndexCacheWriter w;
+	w.U32(FONT_INDEX_CACHE_MAGIC);
+	w.U32(FONT_INDEX_CACHE_VERSION);
+
+	w.U32(u32(g_fontDirs.Size()));
+	for (const auto& dir : g_fontDirs)
+		w.Str(dir);
+
+	w.U32(u32(dirs.Size()));
+	for (const auto& dir : dirs)
+	{
+		w.Str(dir.path);
+		w.U64(dir.modTime);
+	}
+
+	w.U32(u32(entries.Size()));
+	for (const auto& e : entries)
+	{
+		w.Str(e.path);
+		w.U32(e.faceIndex);
+		w.Str(e.family);
+		w.Str(e.typoFamily);
+		w.U32(u32(e.weight));
+		w.U8(e.italic);
+		for (u32 v : e.unicodeRanges)
+			w.U32(v);
+		for (u32 v : e.codePageRanges)
+			w.U32(v);
+	}
+
+	CreateMissingParentDirectories(path);
+	if (!WriteBinaryFile(path, w.data.data(), w.data.size()))
+		LogWarn(LOG_FONT_INDEX, "failed to write the cache file: %.*s", int(path.size()), path.data());
+}
+
+static void ScanFontDirectories(Array<FontIndexEntry>& outEntries)
+{
+	Array<std::string> files;
+	Array<FontDirStamp> dirs;
+	for (const auto& dir : g_fontDirs)
+		if (GetFileAttributes(dir) & FA_Directory)
+			ScanFontDirectory(dir, files, dirs);
+
+	// each thread parses every Nth file into per-file slots so that the order stays the same
+	Array<Array<FontIndexEntry>> perFile;
+	perFile.Resize(files.Size());
+
+	ThreadPool& pool = ThreadPool::Get();
+	size_t numThreads = min<size_t>(pool.GetNumThreads() + 1, (files.Size() + 7) / 8);
+	auto parseFiles = [&files, &perFile](size_t first, size_t step)
+	{
+		for (size_t i = first; i < files.Size(); i += step)
+			ParseFontFile(files[i], perFile[i]);
+	};
+	if (numThreads > 1)
+	{
+		Array<JobHandle> jobs;
+		for (size_t t = 1; t < numThreads; t++)
+			jobs.Append(pool.Run([&parseFiles, t, numThreads]() { parseFiles(t, numThreads); }));
+		parseFiles(0, numThreads);
+		for (auto& job : jobs)
+			job.Wait();
+	}
+	else
+		parseFiles(0, 1);
+
+	for (auto& fileEntries : perFile)
+		for (auto& e : fileEntries)
+			outEntries.Append(Move(e));
+
+	LogInfo(LOG_FONT_INDEX, "indexed %zu faces in %zu files", outEntries.Size(), files.Size());
+
+	if (!g_fontIndexCachePath.empty())
+		SaveFontIndexCache(g_fontIndexCachePath, dirs, outEntries);
+}
+
+static void EnsureFontIndexBuilt()
+{
+	if (g_fontIndexBuilt)
+		return;
+	g_fontIndexBuilt = true;
+
+	if (!g_fontDirsSet)
+	{
+		GetDefaultFontDirectories(g_fontDirs);
+		g_fontDirsSet = true;
+	}
+	if (!g_fontIndexCachePathSet)
+	{
+		g_fontIndexCachePath = GetDefaultFontIndexCachePath();
+		g_fontIndexCachePathSet = true;
+	}
+
+	g_fontIndexEntries.Clear();
+	g_fontIndexFamilies.Clear();
+	if (g_fontIndexCachePath.empty() || !LoadFontIndexCache(g_fontIndexCachePath, g_fontIndexEntries))
+	{
+		g_fontIndexEntries.Clear();
+		ScanFontDirectories(g_fontIndexEntries);
+	}
+
+	for (size_t i = 0; i < g_fontIndexEntries.Size(); i++)
+	{
+		const auto& e = g_fontIndexEntries[i];
+		g_fontIndexFamilies[FamilyKey(e.family)].Append(u32(i));
+		if (!e.typoFamily.empty())
+			g_fontIndexFamilies[FamilyKey(e.typoFamily)].Append(u32(i));
+	}
+}
+
+
+void FontIndexSetDirectories(ArrayView<StringView> dirs)
+{
+	g_fontDirs.Clear();
+	for (StringView dir : dirs)
+		g_fontDirs.Append(to_string(dir));
+	g_fontDirsSet = true;
+	FontIndexInvalidate();
+}
+
+void FontIndexSetCachePath(StringView path)
+{
+	g_fontIndexCachePath = to_string(path);
+	g_fontIndexCachePathSet = true;
+	FontIndexInvalidate();
+}
+
+void FontIndexInvalidate()
+{
+	g_fontIndexBuilt = false;
+	g_fontIndexEntries.Clear();
+	g_fontIndexFamilies.Clear();
+}
+
+size_t FontIndexGetNumEntries()
+{
+	EnsureFontIndexBuilt();
+	return g_fontIndexEntries.Size();
+}
+
+const FontIndexEntry& FontIndexGetEntry(size_t i)
+{
+	EnsureFontIndexBuilt();
+	return g_fontIndexEntries[i];
+}
+
+const FontIndexEntry* FontIndexFind(StringView family, int weight, bool italic)
+{
+	EnsureFontIndexBuilt();
+	auto* indices = g_fontIndexFamilies.GetValuePtr(FamilyKey(family));
+	if (!indices)
+		return nullptr;
+
+	// same proximity metric as the system font matching
+	const FontIndexEntry* best = nullptr;
+	int bestProximity = INT_MAX;
+	for (u32 i : *indices)
+	{
+		const auto& e = g_fontIndexEntries[i];
+		int proximity = abs(weight - e.weight) + abs(int(italic) - int(e.italic)) * 2000;
+		if (proximity < bestProximity)
+		{
+			best = &e;
+			bestProximity = proximity;
+		}
+	}
+	return best;
+}
+
+bool FontIndexHasFamily(StringView family)
+{
+	EnsureFontIndexBuilt();
+	return g_fontIndexFamilies.Contains(FamilyKey(family));
+}
+
+int FontIndexMapFace(const FontIndexEntry& e, BufferHandle& outData)
+{
+	auto frr = MapBinaryFile(e.path);
+	if (frr.result != IOResult::Success || !frr.data)
+		return -1;
+
+	FontDataReader r = { static_cast<const u8*>(frr.data->Data()), frr.data->Size() };
+	size_t offset = 0;
+	if (r.Has(0, 12) && memcmp(r.data, "ttcf", 4) == 0)
+	{
+		if (e.faceIndex >= r.U32(8) || !r.Has(12 + e.faceIndex * 4, 4))
+			return -1;
+		offset = r.U32(12 + e.faceIndex * 4);
+	}
+	outData = frr.data;
+	return int(offset);
+}
+
+} // ui
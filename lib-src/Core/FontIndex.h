@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Array.h"
+#include "FileSystem.h"
+#include "String.h"
+
+
+namespace ui {
+
+// a font face found in one of the indexed font directories
+struct FontIndexEntry
+{
+	std::string path;
+	u32 faceIndex; // in font collections (.ttc)
+	std::string family; // name ID 1
+	std::string typoFamily; // name ID 16 (empty if the same as family)
+	int weight;
+	bool italic;
+	u32 unicodeRanges[4]; // OS/2 ulUnicodeRange1-4
+	u32 codePageRanges[2]; // OS/2 ulCodePageRange1-2
+};
+
+// the font directories are scanned on first use (in parallel), parsing only the name and OS/2 tables
+// the results are stored in the cache file and reused as long as the directories are not modified
+// - default directories: the system and user font directories
+// - default cache file: <local app data>/ToolUILib/fontindex.bin (empty path = no cache file)
+void FontIndexSetDirectories(ArrayView<StringView> dirs);
+void FontIndexSetCachePath(StringView path);
+// drops the current index, it will be rebuilt (or reloaded from the cache) on next use
+void FontIndexInvalidate();
+
+size_t FontIndexGetNumEntries();
+const FontIndexEntry& FontIndexGetEntry(size_t i);
+// the family name is case-insensitive and can be either the (legacy) family or the typographic family
+// returns the closest match by weight and style, or nullptr if there is no such family
+const FontIndexEntry* FontIndexFind(StringView family, int weight, bool italic);
+bool FontIndexHasFamily(StringView family);
+
+// maps the font file of the entry, returns the offset of the face in the data (or -1 on failure)
+int FontIndexMapFace(const FontIndexEntry& e, BufferHandle& outData);
+
+} // ui
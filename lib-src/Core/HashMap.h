@@ -143,7 +143,7 @@ struct HashTableDataStorage_SeparateArrays
 
 	void Reserve(size_t cap)
 	{
-		if (std::is_standard_layout_v<K> && std::is_trivially_copy_constructible_v<K>)
+		if (IsTriviallyRelocatable<K>::value)
 		{
 			keys = (K*)realloc(keys, sizeof(K) * cap);
 		}
@@ -160,7 +160,7 @@ struct HashTableDataStorage_SeparateArrays
 			keys = newKeys;
 		}
 
-		if (std::is_standard_layout_v<V> && std::is_trivially_copy_constructible_v<V>)
+		if (IsTriviallyRelocatable<V>::value)
 		{
 			values = (V*)realloc(values, sizeof(V) * cap);
 		}
@@ -208,15 +208,16 @@ struct HashTableDataStorage_SeparateArrays
 	UI_FORCEINLINE const V& GetValueAt(size_t pos) const { return values[pos]; }
 };
 
-template <class K, class V, class HEC = HashEqualityComparer<K>>
-struct HashMap : HashTableExtBase<K, HEC, HashTableDataStorage_SeparateArrays<K, V>>
+// HTI - index policy (HashTableIndex_Linear or HashTableIndex_Group16)
+template <class K, class V, class HEC = HashEqualityComparer<K>, class HTI = HashTableIndex_Linear>
+struct HashMap : HashTableExtBase<K, HEC, HashTableDataStorage_SeparateArrays<K, V>, HTI>
 {
-	using Base = HashTableExtBase<K, HEC, HashTableDataStorage_SeparateArrays<K, V>>;
+	using Base = HashTableExtBase<K, HEC, HashTableDataStorage_SeparateArrays<K, V>, HTI>;
 
 	using Key = K;
 	using Value = V;
 
-	using HashTableExtBase<K, HEC, HashTableDataStorage_SeparateArrays<K, V>>::HashTableExtBase;
+	using Base::HashTableExtBase;
 
 	template <class T>
 	UI_FORCEINLINE V GetValueOrDefaultT(const T& key, const V& def = {}) const
@@ -82,7 +82,7 @@ struct HashSetDataStorage
 
 	void Reserve(size_t cap)
 	{
-		if (std::is_standard_layout_v<K> && std::is_trivially_copy_constructible_v<K>)
+		if (IsTriviallyRelocatable<K>::value)
 		{
 			keys = (K*)realloc(keys, sizeof(K) * cap);
 		}
@@ -114,14 +114,15 @@ struct HashSetDataStorage
 	UI_FORCEINLINE const K& GetKeyAt(size_t pos) const { return keys[pos]; }
 };
 
-template <class K, class HEC = HashEqualityComparer<K>>
-struct HashSet : HashTableExtBase<K, HEC, HashSetDataStorage<K>>
+// HTI - index policy (HashTableIndex_Linear or HashTableIndex_Group16)
+template <class K, class HEC = HashEqualityComparer<K>, class HTI = HashTableIndex_Linear>
+struct HashSet : HashTableExtBase<K, HEC, HashSetDataStorage<K>, HTI>
 {
-	using Base = HashTableExtBase<K, HEC, HashSetDataStorage<K>>;
+	using Base = HashTableExtBase<K, HEC, HashSetDataStorage<K>, HTI>;
 
 	using Key = K;
 
-	using HashTableExtBase<K, HEC, HashSetDataStorage<K>>::HashTableExtBase;
+	using Base::HashTableExtBase;
 
 	HashSet() {}
 	HashSet(const std::initializer_list<K>& keys)
@@ -6,11 +6,27 @@
 
 #include <assert.h>
 #include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define UI_HASH_GROUP_SSE2 1
+#include <emmintrin.h>
+#else
+#define UI_HASH_GROUP_SSE2 0
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 
 namespace ui {
 
-struct HashTableBase
+// index policies: map hashes to positions in the dense entry storage
+// - HashTableIndex_Linear: one slot per entry position, linear probing
+// - HashTableIndex_Group16: Swiss table style - a control byte per slot (7 bits of the hash), 16 slots are matched at once
+
+struct HashTableIndex_Linear
 {
 	using H = size_t;
 	using Hash = H;
@@ -36,16 +52,288 @@ struct HashTableBase
 		v |= v >> 4;
 		v |= v >> 8;
 		v |= v >> 16;
+#if SIZE_MAX > UINT32_MAX
+		v |= v >> 32;
+#endif
 		v++;
 		return v;
 	}
+
+	static UI_FORCEINLINE size_t _HashCapForCapacity(size_t cap) { return _next_po2(cap + cap / 4); }
+
+	void _MoveIndexFrom(HashTableIndex_Linear& o)
+	{
+		_hashTable = o._hashTable;
+		_hashCap = o._hashCap;
+		_hashes = o._hashes;
+		_removed = o._removed;
+
+		o._hashTable = nullptr;
+		o._hashCap = 0;
+		o._hashes = nullptr;
+		o._removed = 0;
+	}
+
+	void _FreeIndex()
+	{
+		if (_hashTable)
+		{
+			free(_hashTable);
+			_hashTable = nullptr;
+		}
+		_hashCap = 0;
+		_removed = 0;
+	}
+
+	void _ClearIndex()
+	{
+		for (size_t i = 0; i < _hashCap; i++)
+			_hashTable[i] = NO_VALUE;
+		_removed = 0;
+	}
+
+	void _InitIndex(size_t hashCap)
+	{
+		if (hashCap != _hashCap)
+		{
+			// no realloc since we don't need the old data
+			if (_hashTable)
+				free(_hashTable);
+			_hashTable = (size_t*)malloc(sizeof(size_t) * hashCap);
+		}
+		_hashCap = hashCap;
+
+		// mark all slots as unused
+		_ClearIndex();
+	}
+
+	void _InsertIndex(H hash, size_t pos)
+	{
+		size_t start = hash & (_hashCap - 1);
+		size_t i = start;
+		for (;;)
+		{
+			size_t idx = _hashTable[i];
+			if (idx == NO_VALUE || idx == REMOVED)
+			{
+				if (idx == REMOVED)
+					_removed--;
+				_hashTable[i] = pos;
+				break;
+			}
+			i = _advance(i);
+
+			// error
+			assert(i != start);
+			if (i == start)
+				break;
+		}
+	}
+
+	// returns the slot or SIZE_MAX
+	template <class F>
+	size_t _FindSlot(H hash, F&& isEntryAt) const
+	{
+		size_t start = hash & (_hashCap - 1);
+		size_t i = start;
+		for (;;)
+		{
+			size_t idx = _hashTable[i];
+			if (idx == NO_VALUE)
+				return SIZE_MAX;
+			if (idx != REMOVED && isEntryAt(idx))
+				return i;
+			i = _advance(i);
+			if (i == start)
+				break;
+		}
+		return SIZE_MAX;
+	}
+
+	UI_FORCEINLINE size_t _GetSlotPos(size_t slot) const { return _hashTable[slot]; }
+	UI_FORCEINLINE void _SetSlotPos(size_t slot, size_t pos) { _hashTable[slot] = pos; }
+	UI_FORCEINLINE void _RemoveSlot(size_t slot)
+	{
+		_hashTable[slot] = REMOVED;
+		_removed++;
+	}
 };
 
-template <class K, class HEC, class HTDS>
-struct HashTableExtBase : HashTableBase
+struct HashTableIndex_Group16
+{
+	using H = size_t;
+	using Hash = H;
+
+	static constexpr size_t GROUP_SIZE = 16;
+	static constexpr i8 CTRL_EMPTY = -128;
+	static constexpr i8 CTRL_REMOVED = -2;
+	// full slots store the low 7 bits of the hash (0-127), the rest of the bits select the group
+
+	i8* _ctrl = nullptr;
+	size_t* _slots = nullptr;
+	size_t _hashCap = 0;
+	H* _hashes = nullptr;
+	size_t _removed = 0;
+
+	static UI_FORCEINLINE u32 _MatchByte(const i8* group, i8 v)
+	{
+#if UI_HASH_GROUP_SSE2
+		__m128i g = _mm_loadu_si128((const __m128i*)group);
+		return u32(_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(v))));
+#else
+		u32 m = 0;
+		for (u32 i = 0; i < GROUP_SIZE; i++)
+			m |= u32(group[i] == v) << i;
+		return m;
+#endif
+	}
+	// empty or removed
+	static UI_FORCEINLINE u32 _MatchFree(const i8* group)
+	{
+#if UI_HASH_GROUP_SSE2
+		return u32(_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group)));
+#else
+		u32 m = 0;
+		for (u32 i = 0; i < GROUP_SIZE; i++)
+			m |= u32(group[i] < 0) << i;
+		return m;
+#endif
+	}
+	static UI_FORCEINLINE u32 _LowestBit(u32 m)
+	{
+#ifdef _MSC_VER
+		unsigned long i;
+		_BitScanForward(&i, m);
+		return u32(i);
+#else
+		return u32(__builtin_ctz(m));
+#endif
+	}
+
+	static UI_FORCEINLINE size_t _HashCapForCapacity(size_t cap)
+	{
+		size_t hc = HashTableIndex_Linear::_next_po2(cap + cap / 4);
+		return hc < GROUP_SIZE ? GROUP_SIZE : hc;
+	}
+
+	void _MoveIndexFrom(HashTableIndex_Group16& o)
+	{
+		_ctrl = o._ctrl;
+		_slots = o._slots;
+		_hashCap = o._hashCap;
+		_hashes = o._hashes;
+		_removed = o._removed;
+
+		o._ctrl = nullptr;
+		o._slots = nullptr;
+		o._hashCap = 0;
+		o._hashes = nullptr;
+		o._removed = 0;
+	}
+
+	void _FreeIndex()
+	{
+		// control bytes and slots share the allocation
+		if (_slots)
+		{
+			free(_slots);
+			_slots = nullptr;
+			_ctrl = nullptr;
+		}
+		_hashCap = 0;
+		_removed = 0;
+	}
+
+	void _ClearIndex()
+	{
+		if (_hashCap)
+			memset(_ctrl, CTRL_EMPTY, _hashCap);
+		_removed = 0;
+	}
+
+	void _InitIndex(size_t hashCap)
+	{
+		if (hashCap != _hashCap)
+		{
+			if (_slots)
+				free(_slots);
+			_slots = (size_t*)malloc((sizeof(size_t) + 1) * hashCap);
+			_ctrl = (i8*)(_slots + hashCap);
+		}
+		_hashCap = hashCap;
+
+		_ClearIndex();
+	}
+
+	void _InsertIndex(H hash, size_t pos)
+	{
+		size_t mask = _hashCap / GROUP_SIZE - 1;
+		size_t g = (hash >> 7) & mask;
+		for (size_t step = 0; step <= mask; )
+		{
+			i8* group = _ctrl + g * GROUP_SIZE;
+			if (u32 m = _MatchFree(group))
+			{
+				size_t slot = g * GROUP_SIZE + _LowestBit(m);
+				if (_ctrl[slot] == CTRL_REMOVED)
+					_removed--;
+				_ctrl[slot] = i8(hash & 0x7f);
+				_slots[slot] = pos;
+				return;
+			}
+			g = (g + ++step) & mask;
+		}
+		// error - the capacity always leaves free slots
+		assert(false);
+	}
+
+	// returns the slot or SIZE_MAX
+	template <class F>
+	size_t _FindSlot(H hash, F&& isEntryAt) const
+	{
+		size_t mask = _hashCap / GROUP_SIZE - 1;
+		size_t g = (hash >> 7) & mask;
+		i8 tag = i8(hash & 0x7f);
+		// triangular probing over groups visits each of them once
+		for (size_t step = 0; step <= mask; )
+		{
+			const i8* group = _ctrl + g * GROUP_SIZE;
+			for (u32 m = _MatchByte(group, tag); m; m &= m - 1)
+			{
+				size_t slot = g * GROUP_SIZE + _LowestBit(m);
+				if (isEntryAt(_slots[slot]))
+					return slot;
+			}
+			if (_MatchByte(group, CTRL_EMPTY))
+				return SIZE_MAX;
+			g = (g + ++step) & mask;
+		}
+		return SIZE_MAX;
+	}
+
+	UI_FORCEINLINE size_t _GetSlotPos(size_t slot) const { return _slots[slot]; }
+	UI_FORCEINLINE void _SetSlotPos(size_t slot, size_t pos) { _slots[slot] = pos; }
+	UI_FORCEINLINE void _RemoveSlot(size_t slot)
+	{
+		// probing stops at groups with empty slots so if there is one, no tombstone is needed
+		const i8* group = _ctrl + (slot & ~(GROUP_SIZE - 1));
+		if (_MatchByte(group, CTRL_EMPTY))
+			_ctrl[slot] = CTRL_EMPTY;
+		else
+		{
+			_ctrl[slot] = CTRL_REMOVED;
+			_removed++;
+		}
+	}
+};
+
+template <class K, class HEC, class HTDS, class HTI = HashTableIndex_Linear>
+struct HashTableExtBase : HTI
 {
 	using EqualityComparer = HEC;
 	using Storage = HTDS;
+	using Index = HTI;
+	using H = typename HTI::H;
 
 	using EntryRef = typename Storage::EntryRef;
 	using Iterator = typename Storage::Iterator;
@@ -111,20 +399,14 @@ struct HashTableExtBase : HashTableBase
 		Reserve(o._storage.count);
 
 		_storage.InitCopyFrom(o._storage);
-		memcpy(_hashes, o._hashes, sizeof(H) * o._storage.count);
+		memcpy(this->_hashes, o._hashes, sizeof(H) * o._storage.count);
 
-		_Rehash(_hashCap);
+		_Rehash(this->_hashCap);
 	}
 
 	void _MoveFrom(HashTableExtBase&& o)
 	{
-		_hashTable = o._hashTable;
-		_hashCap = o._hashCap;
-		_hashes = o._hashes;
-
-		o._hashTable = nullptr;
-		o._hashCap = 0;
-		o._hashes = nullptr;
+		this->_MoveIndexFrom(o);
 
 		_storage.MoveFrom(Move(o._storage));
 	}
@@ -134,65 +416,28 @@ struct HashTableExtBase : HashTableBase
 		_storage.DestructAll();
 		_storage.FreeMemory();
 
-		if (_hashTable)
-		{
-			free(_hashTable);
-			_hashTable = nullptr;
-		}
+		this->_FreeIndex();
 
-		if (_hashes)
+		if (this->_hashes)
 		{
-			free(_hashes);
-			_hashes = nullptr;
+			free(this->_hashes);
+			this->_hashes = nullptr;
 		}
-
-		_hashCap = 0;
 	}
 
 	void Clear()
 	{
 		_storage.DestructAll();
-		for (size_t i = 0; i < _hashCap; i++)
-			_hashTable[i] = NO_VALUE;
+		this->_ClearIndex();
 	}
 
 	void _Rehash(size_t hashCap)
 	{
-		if (hashCap != _hashCap)
-		{
-			// no realloc since we don't need the old data
-			if (_hashTable)
-				free(_hashTable);
-			_hashTable = (size_t*)malloc(sizeof(size_t) * hashCap);
-		}
-		_hashCap = hashCap;
-
-		// mark all slots as unused
-		for (size_t i = 0; i < hashCap; i++)
-			_hashTable[i] = NO_VALUE;
+		this->_InitIndex(hashCap);
 
 		// reinsert used elements
 		for (size_t n = 0; n < _storage.count; n++)
-		{
-			size_t start = _hashes[n] & (hashCap - 1);
-			size_t i = start;
-			for (;;)
-			{
-				size_t idx = _hashTable[i];
-				if (idx == NO_VALUE)
-				{
-					_hashTable[i] = n;
-					break;
-				}
-				i = _advance(i);
-
-				// error
-				assert(i != start);
-				if (i == start)
-					break;
-			}
-		}
-		_removed = 0;
+			this->_InsertIndex(this->_hashes[n], n);
 	}
 
 	void Reserve(size_t newcap)
@@ -200,33 +445,18 @@ struct HashTableExtBase : HashTableBase
 		if (newcap <= _storage.capacity)
 			return;
 
-		size_t hashCap = _next_po2(newcap + newcap / 4);
-		_Rehash(hashCap);
-		_hashes = (H*)realloc(_hashes, sizeof(H) * newcap);
+		_Rehash(HTI::_HashCapForCapacity(newcap));
+		this->_hashes = (H*)realloc(this->_hashes, sizeof(H) * newcap);
 
 		_storage.Reserve(newcap);
 	}
 
 	template <class T>
-	size_t _FindHashTableIndexT(const T& key) const
+	UI_FORCEINLINE size_t _FindHashTableIndexT(const T& key) const
 	{
 		if (!_storage.count)
 			return SIZE_MAX;
-		H hash = HEC::GetHash(key);
-		size_t start = hash & (_hashCap - 1);
-		size_t i = start;
-		for (;;)
-		{
-			size_t idx = _hashTable[i];
-			if (idx == NO_VALUE)
-				return SIZE_MAX;
-			if (idx != REMOVED && HEC::AreEqual(key, _storage.GetKeyAt(idx)))
-				return i;
-			i = _advance(i);
-			if (i == start)
-				break;
-		}
-		return SIZE_MAX;
+		return this->_FindSlot(HEC::GetHash(key), [this, &key](size_t pos) { return HEC::AreEqual(key, _storage.GetKeyAt(pos)); });
 	}
 	UI_FORCEINLINE size_t _FindHashTableIndex(const K& key) const
 	{
@@ -237,7 +467,7 @@ struct HashTableExtBase : HashTableBase
 	inline size_t _FindPosT(const T& key, size_t def) const
 	{
 		size_t i = _FindHashTableIndexT(key);
-		return i != SIZE_MAX ? _hashTable[i] : def;
+		return i != SIZE_MAX ? this->_GetSlotPos(i) : def;
 	}
 	inline size_t _FindPos(const K& key, size_t def) const
 	{
@@ -248,7 +478,7 @@ struct HashTableExtBase : HashTableBase
 	{
 		size_t idx = _FindHashTableIndex(key);
 		if (idx != SIZE_MAX)
-			return _hashTable[idx];
+			return this->_GetSlotPos(idx);
 
 		if (_storage.count == _storage.capacity)
 		{
@@ -256,27 +486,9 @@ struct HashTableExtBase : HashTableBase
 		}
 
 		H hash = HEC::GetHash(key);
-		size_t start = hash & (_hashCap - 1);
-		size_t i = start;
 		size_t pos = _storage.count;
-		_hashes[pos] = hash;
-		for (;;)
-		{
-			size_t idx = _hashTable[i];
-			if (idx == NO_VALUE || idx == REMOVED)
-			{
-				if (idx == REMOVED)
-					_removed--;
-				_hashTable[i] = pos;
-				break;
-			}
-			i = _advance(i);
-
-			// error
-			//assert(i != start);
-			if (i == start)
-				break;
-		}
+		this->_hashes[pos] = hash;
+		this->_InsertIndex(hash, pos);
 		return pos;
 	}
 
@@ -287,22 +499,21 @@ struct HashTableExtBase : HashTableBase
 		if (htidx == SIZE_MAX)
 			return false;
 
-		size_t pos = _hashTable[htidx];
-		_hashTable[htidx] = REMOVED;
+		size_t pos = this->_GetSlotPos(htidx);
+		this->_RemoveSlot(htidx);
 		size_t lastPos = _storage.count - 1;
 		if (pos != lastPos)
 		{
 			size_t newidx = _FindHashTableIndexT(_storage.GetKeyAt(lastPos));
-			assert(newidx < _hashCap);
+			assert(newidx < this->_hashCap);
 			_storage.MoveEntry(pos, lastPos);
-			_hashes[pos] = _hashes[lastPos];
-			_hashTable[newidx] = pos;
+			this->_hashes[pos] = this->_hashes[lastPos];
+			this->_SetSlotPos(newidx, pos);
 		}
 		_storage.DestructEntry(lastPos);
 		_storage.count--;
-		_removed++;
-		if (_removed > _storage.count / 2)
-			_Rehash(_hashCap);
+		if (this->_removed > _storage.count / 2)
+			_Rehash(this->_hashCap);
 		return true;
 	}
 	bool Remove(const K& key)
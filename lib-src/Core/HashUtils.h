@@ -3,6 +3,11 @@
 
 #include "Platform.h"
 
+#include <string.h>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+#include <intrin.h>
+#endif
+
 
 namespace ui {
 
@@ -21,6 +26,7 @@ inline size_t HashBytesAll(const void* bytes, size_t num)
 	return h;
 }
 
+// samples at most maxsteps bytes - only for keys that are known to differ in the sampled bytes
 inline size_t HashManyBytesFast(const void* bytes, size_t num, size_t maxsteps = 64)
 {
 	auto* arr = (const char*)bytes;
@@ -36,6 +42,104 @@ inline size_t HashManyBytesFast(const void* bytes, size_t num, size_t maxsteps =
 	return h;
 }
 
+namespace _wyhash {
+
+static constexpr const u64 SECRET0 = 0x2d358dccaa6c78a5ull;
+static constexpr const u64 SECRET1 = 0x8bb84b93962eacc9ull;
+static constexpr const u64 SECRET2 = 0x4b33a62ed433d4a3ull;
+static constexpr const u64 SECRET3 = 0x4d5a2da51de1aa47ull;
+
+UI_FORCEINLINE void Mul128(u64& a, u64& b)
+{
+#if defined(__SIZEOF_INT128__)
+	__uint128_t r = a;
+	r *= b;
+	a = u64(r);
+	b = u64(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+	a = _umul128(a, b, &b);
+#elif defined(_MSC_VER) && defined(_M_ARM64)
+	u64 lo = a * b;
+	b = __umulh(a, b);
+	a = lo;
+#else
+	u64 ha = a >> 32, hb = b >> 32, la = u32(a), lb = u32(b);
+	u64 rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	u64 t = rl + (rm0 << 32);
+	u64 c = t < rl;
+	u64 lo = t + (rm1 << 32);
+	c += lo < t;
+	a = lo;
+	b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+UI_FORCEINLINE u64 Mix(u64 a, u64 b) { Mul128(a, b); return a ^ b; }
+UI_FORCEINLINE u64 Read8(const u8* p) { u64 v; memcpy(&v, p, 8); return v; }
+UI_FORCEINLINE u64 Read4(const u8* p) { u32 v; memcpy(&v, p, 4); return v; }
+UI_FORCEINLINE u64 Read3(const u8* p, size_t k) { return (u64(p[0]) << 16) | (u64(p[k >> 1]) << 8) | p[k - 1]; }
+
+} // _wyhash
+
+// hashes every byte, 16-48 bytes per step (wyhash, final version 4)
+// the default for strings and other variable-length keys
+inline u64 HashBytesFull64(const void* bytes, size_t num, u64 seed = 0)
+{
+	using namespace _wyhash;
+	auto* p = (const u8*)bytes;
+	seed ^= Mix(seed ^ SECRET0, SECRET1);
+	u64 a, b;
+	if (num <= 16)
+	{
+		if (num >= 4)
+		{
+			a = (Read4(p) << 32) | Read4(p + ((num >> 3) << 2));
+			b = (Read4(p + num - 4) << 32) | Read4(p + num - 4 - ((num >> 3) << 2));
+		}
+		else if (num > 0)
+		{
+			a = Read3(p, num);
+			b = 0;
+		}
+		else
+			a = b = 0;
+	}
+	else
+	{
+		size_t i = num;
+		if (i > 48)
+		{
+			u64 see1 = seed, see2 = seed;
+			do
+			{
+				seed = Mix(Read8(p) ^ SECRET1, Read8(p + 8) ^ seed);
+				see1 = Mix(Read8(p + 16) ^ SECRET2, Read8(p + 24) ^ see1);
+				see2 = Mix(Read8(p + 32) ^ SECRET3, Read8(p + 40) ^ see2);
+				p += 48;
+				i -= 48;
+			}
+			while (i > 48);
+			seed ^= see1 ^ see2;
+		}
+		while (i > 16)
+		{
+			seed = Mix(Read8(p) ^ SECRET1, Read8(p + 8) ^ seed);
+			i -= 16;
+			p += 16;
+		}
+		a = Read8(p + i - 16);
+		b = Read8(p + i - 8);
+	}
+	a ^= SECRET1;
+	b ^= seed;
+	Mul128(a, b);
+	return Mix(a ^ SECRET0 ^ num, b ^ SECRET1);
+}
+
+UI_FORCEINLINE size_t HashBytesFull(const void* bytes, size_t num)
+{
+	return size_t(HashBytesFull64(bytes, num));
+}
+
 UI_FORCEINLINE size_t HashValue(unsigned char v) { return v * HASH_PRIME; }
 UI_FORCEINLINE size_t HashValue(signed char v) { return (unsigned char)v * HASH_PRIME; }
 UI_FORCEINLINE size_t HashValue(unsigned short v) { return v * HASH_PRIME; }
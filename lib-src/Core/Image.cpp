@@ -1,6 +1,14 @@
 
 #include "Image.h"
 
+#include "SystemInfo.h"
+
+#if UI_ARCH_X86
+#  include <immintrin.h>
+#elif UI_ARCH_ARM64
+#  include <arm_neon.h>
+#endif
+
 
 namespace ui {
 
@@ -163,28 +171,110 @@ static int dorectmask(int x, int y, const RRect& rr)
 	return 255;
 }
 
-static void blur(u8* scratch, u8* src, u32 count, u32 incr, int off, float* kernel, u32 ksize)
+// out[i] = sum(padded[i + k] * kernel[k]) for k in [0; ksize)
+// - all variants add the products in the same order, results only differ in rounding
+//   (the compiler may fuse the multiply-add when the target has FMA)
+typedef void BlurLineFunc(float* out, const float* padded, u32 count, const float* kernel, u32 ksize);
+
+static void BlurLine_Scalar(float* out, const float* padded, u32 count, const float* kernel, u32 ksize)
 {
-	// blur to scratch
 	for (u32 i = 0; i < count; i++)
 	{
 		float total = 0;
 		for (u32 k = 0; k < ksize; k++)
-		{
-			int sp = int(i + k) - off;
-			if (sp < 0 || sp >= count)
-				continue; // assume 0
-			total += src[sp * incr] * kernel[k];
-		}
-		scratch[i] = min(int(roundf(total)), 255);
+			total += padded[i + k] * kernel[k];
+		out[i] = total;
+	}
+}
+
+#if UI_ARCH_X86
+static void BlurLine_SSE2(float* out, const float* padded, u32 count, const float* kernel, u32 ksize)
+{
+	u32 i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 total = _mm_setzero_ps();
+		for (u32 k = 0; k < ksize; k++)
+			total = _mm_add_ps(total, _mm_mul_ps(_mm_loadu_ps(padded + i + k), _mm_set1_ps(kernel[k])));
+		_mm_storeu_ps(out + i, total);
 	}
+	BlurLine_Scalar(out + i, padded + i, count - i, kernel, ksize);
+}
+
+UI_TARGET_AVX2 static void BlurLine_AVX2(float* out, const float* padded, u32 count, const float* kernel, u32 ksize)
+{
+	u32 i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 total = _mm256_setzero_ps();
+		for (u32 k = 0; k < ksize; k++)
+			total = _mm256_add_ps(total, _mm256_mul_ps(_mm256_loadu_ps(padded + i + k), _mm256_set1_ps(kernel[k])));
+		_mm256_storeu_ps(out + i, total);
+	}
+	BlurLine_SSE2(out + i, padded + i, count - i, kernel, ksize);
+}
+
+UI_TARGET_AVX512 static void BlurLine_AVX512(float* out, const float* padded, u32 count, const float* kernel, u32 ksize)
+{
+	u32 i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		__m512 total = _mm512_setzero_ps();
+		for (u32 k = 0; k < ksize; k++)
+			total = _mm512_add_ps(total, _mm512_mul_ps(_mm512_loadu_ps(padded + i + k), _mm512_set1_ps(kernel[k])));
+		_mm512_storeu_ps(out + i, total);
+	}
+	BlurLine_SSE2(out + i, padded + i, count - i, kernel, ksize);
+}
+#elif UI_ARCH_ARM64
+static void BlurLine_NEON(float* out, const float* padded, u32 count, const float* kernel, u32 ksize)
+{
+	u32 i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		float32x4_t total = vdupq_n_f32(0);
+		for (u32 k = 0; k < ksize; k++)
+			total = vaddq_f32(total, vmulq_n_f32(vld1q_f32(padded + i + k), kernel[k]));
+		vst1q_f32(out + i, total);
+	}
+	BlurLine_Scalar(out + i, padded + i, count - i, kernel, ksize);
+}
+#endif
+
+static const CPUDispatchVariant<BlurLineFunc*> g_blurLineVariants[] =
+{
+#if UI_ARCH_X86
+	{ "AVX-512", CPUFeature_AVX512, BlurLine_AVX512 },
+	{ "AVX2", CPUFeature_AVX2, BlurLine_AVX2 },
+	{ "SSE2", CPUFeature_SSE2, BlurLine_SSE2 },
+#elif UI_ARCH_ARM64
+	{ "NEON", CPUFeature_NEON, BlurLine_NEON },
+#endif
+	{ "Scalar", 0, BlurLine_Scalar },
+};
+
+// scratch = floats for the padded line (count + ksize - 1) followed by the results (count)
+static void blur(float* scratch, u8* src, u32 count, u32 incr, u32 off, const float* kernel, u32 ksize)
+{
+	static BlurLineFunc* const blurLine = CPUDispatchSelect(g_blurLineVariants);
+
+	// zero padding so that the kernel doesn't need to check the bounds
+	float* padded = scratch;
+	float* totals = scratch + count + ksize - 1;
+	for (u32 i = 0; i < off; i++)
+		padded[i] = 0;
+	for (u32 i = 0; i < count; i++)
+		padded[off + i] = src[i * incr];
+	for (u32 i = off + count; i < count + ksize - 1; i++)
+		padded[i] = 0;
+
+	blurLine(totals, padded, count, kernel, ksize);
 
-	// copy back
 	for (u32 i = 0; i < count; i++)
-		src[i * incr] = scratch[i];
+		src[i * incr] = min(int(roundf(totals[i])), 255);
 }
 
-void SimpleMaskBlurGen::Generate(const Input& uinput, Output& output, Canvas& outCanvas)
+void SimpleMaskBlurGen::Generate(const Input& uinput, Output& output, Canvas& outCanvas, bool parallel)
 {
 	auto input = uinput.Normalized();
 
@@ -202,32 +292,33 @@ void SimpleMaskBlurGen::Generate(const Input& uinput, Output& output, Canvas& ou
 	// TODO: simplified version without inner overlap (sample a gradient based on distance from border)?
 	{
 		u32 imgmem = w * h;
-		u32 scratchmem = max(w, h);
 		int halfext = int(ceil(input.blurSize / 2.0f));
 		u32 kernelsize = halfext * 2 + 1;
-		u32 allmem = imgmem + scratchmem;
+		u32 allmem = imgmem;
 		allmem = (allmem + 3 % 4);
 		u32 f32kerneloffset = allmem;
 		allmem += kernelsize * 4;
 		u8* img = (u8*)malloc(allmem);
-		u8* scratch = img + imgmem;
 		float* f32kernel = (float*)(img + f32kerneloffset);
 
 		// rasterize the shape
-		memset(img, 0, imgmem);
 		u32 p0 = input.blurSize / 2 + 1;
 		RRect rrect =
 		{
 			int(p0), int(p0), int(w - p0 - 1), int(h - p0 - 1),
 			int(input.cornerLT), int(input.cornerLB), int(input.cornerRT), int(input.cornerRB),
 		};
-		for (u32 y = p0; y < h - p0; y++)
+		ParallelForImageLines(h, w, [img, w, h, p0, &rrect](size_t y0, size_t y1)
 		{
-			for (u32 x = p0; x < w - p0; x++)
+			memset(img + y0 * w, 0, (y1 - y0) * w);
+			for (u32 y = max(u32(y0), p0); y < min(u32(y1), h - p0); y++)
 			{
-				img[x + y * w] = dorectmask(x, y, rrect);
+				for (u32 x = p0; x < w - p0; x++)
+				{
+					img[x + y * w] = dorectmask(x, y, rrect);
+				}
 			}
-		}
+		}, parallel);
 
 		if (input.blurSize > 0)
 		{
@@ -248,28 +339,38 @@ void SimpleMaskBlurGen::Generate(const Input& uinput, Output& output, Canvas& ou
 				f32kernel[i] /= ksum;
 
 			// x blur
-			for (u32 y = 1; y + 1 < h; y++)
+			ParallelForImageLines(h - 2, w, [img, w, halfext, f32kernel, kernelsize](size_t y0, size_t y1)
 			{
-				blur(scratch, img + y * w + 1, w - 2, 1, halfext, f32kernel, kernelsize);
-			}
+				float* scratch = (float*)malloc(sizeof(float) * (w * 2 + kernelsize));
+				for (u32 y = u32(y0) + 1; y < u32(y1) + 1; y++)
+				{
+					blur(scratch, img + y * w + 1, w - 2, 1, halfext, f32kernel, kernelsize);
+				}
+				free(scratch);
+			}, parallel);
 
 			// y blur
-			for (u32 x = 1; x + 1 < w; x++)
+			ParallelForImageLines(w - 2, h, [img, w, h, halfext, f32kernel, kernelsize](size_t x0, size_t x1)
 			{
-				blur(scratch, img + x + w, h - 2, w, halfext, f32kernel, kernelsize);
-			}
+				float* scratch = (float*)malloc(sizeof(float) * (h * 2 + kernelsize));
+				for (u32 x = u32(x0) + 1; x < u32(x1) + 1; x++)
+				{
+					blur(scratch, img + x + w, h - 2, w, halfext, f32kernel, kernelsize);
+				}
+				free(scratch);
+			}, parallel);
 		}
 
 		// copy into canvas as alpha (rgb=255)
 		outCanvas.SetSize(w, h);
 		u32* px = outCanvas.GetPixels();
-		for (u32 y = 0; y < h; y++)
+		ParallelForImageLines(h, w, [img, px, w](size_t y0, size_t y1)
 		{
-			for (u32 x = 0; x < w; x++)
+			for (u32 i = u32(y0) * w, end = u32(y1) * w; i < end; i++)
 			{
-				px[x + y * w] = 0xffffff + (img[x + y * w] << 24);
+				px[i] = 0xffffff + (img[i] << 24);
 			}
-		}
+		}, parallel);
 
 		free(img);
 
@@ -306,4 +407,115 @@ void SimpleMaskBlurGen::Generate(const Input& uinput, Output& output, Canvas& ou
 	}
 }
 
+
+#if UI_BUILD_TESTS
+#include "Test.h"
+
+double hqtime();
+
+DEFINE_TEST_CATEGORY(Image, 80);
+
+static u32 TestHueSatPixel(int x, int y, int w)
+{
+	float c = w / 2.0f;
+	float d = sqrtf((x - c) * (x - c) + (y - c) * (y - c));
+	float angle = fmodf(atan2f(x - c, c - y) / (3.14159f * 2) + 1.0f, 1.0f);
+	return Color4f::HSV(angle, min(d / c, 1.0f), 1.0f, clamp(c - d, 0.0f, 1.0f)).GetColor32();
+}
+
+DEFINE_TEST(Image, ParallelForImageLines)
+{
+	constexpr int W = 1024;
+	constexpr int H = 1024;
+	Canvas serial(W, H), parallel(W, H);
+
+	double t0 = hqtime();
+	u32* px = serial.GetPixels();
+	for (int y = 0; y < H; y++)
+		for (int x = 0; x < W; x++)
+			px[x + y * W] = TestHueSatPixel(x, y, W);
+	double t1 = hqtime();
+	px = parallel.GetPixels();
+	ParallelForImageLines(H, W, [px](size_t y0, size_t y1)
+	{
+		for (int y = int(y0); y < int(y1); y++)
+			for (int x = 0; x < W; x++)
+				px[x + y * W] = TestHueSatPixel(x, y, W);
+	});
+	double t2 = hqtime();
+
+	ASSERT_EQUAL(true, memcmp(serial.GetPixels(), parallel.GetPixels(), serial.GetSizeBytes()) == 0);
+	printf("- %dx%d hue/sat fill: serial=%.3f ms parallel=%.3f ms (%u worker threads)\n",
+		W, H, (t1 - t0) * 1000, (t2 - t1) * 1000, ThreadPool::Get().GetNumThreads());
+}
+
+DEFINE_TEST(Image, BlurLineVariants)
+{
+	constexpr u32 MAX_COUNT = 1024;
+	constexpr u32 MAX_KSIZE = 41;
+	float padded[MAX_COUNT + MAX_KSIZE - 1];
+	float kernel[MAX_KSIZE];
+	float expected[MAX_COUNT];
+	float actual[MAX_COUNT];
+
+	unsigned seed = 1234;
+	for (auto& v : padded)
+	{
+		seed = seed * 1103515245 + 12345;
+		v = float((seed >> 16) % 256);
+	}
+
+	for (const auto& v : g_blurLineVariants)
+	{
+		if ((GetCPUFeatures() & v.requiredFeatures) != v.requiredFeatures)
+		{
+			printf("- skipping %s (not supported)\n", v.name);
+			continue;
+		}
+		for (u32 ksize : { 1, 3, 11, 41 })
+		{
+			for (u32 i = 0; i < ksize; i++)
+				kernel[i] = 1.0f / (1 + abs(int(i) - int(ksize / 2)));
+			for (u32 count : { 0, 1, 5, 15, 17, 63, 100, 1024 })
+			{
+				BlurLine_Scalar(expected, padded, count, kernel, ksize);
+				memset(actual, 0, sizeof(actual));
+				v.func(actual, padded, count, kernel, ksize);
+				for (u32 i = 0; i < count; i++)
+					ASSERT_EQUAL(true, fabsf(expected[i] - actual[i]) <= expected[i] * 1e-5f);
+			}
+		}
+
+		double t0 = hqtime();
+		for (int i = 0; i < 1024; i++)
+			v.func(actual, padded, MAX_COUNT, kernel, MAX_KSIZE);
+		double t1 = hqtime();
+		printf("- %s: 1024 lines of 1024 pixels (kernel size %u): %.3f ms\n", v.name, MAX_KSIZE, (t1 - t0) * 1000);
+	}
+}
+
+DEFINE_TEST(Image, SimpleMaskBlurGenParallel)
+{
+	// a circle, the corners don't leave any space to stretch so the canvas is ~1024x1024
+	SimpleMaskBlurGen::Input input = { 1000, 1000, 20, 500, 500, 500, 500 };
+	SimpleMaskBlurGen::Output outSerial, outParallel;
+	Canvas cSerial, cParallel;
+
+	double t0 = hqtime();
+	SimpleMaskBlurGen::Generate(input, outSerial, cSerial, false);
+	double t1 = hqtime();
+	SimpleMaskBlurGen::Generate(input, outParallel, cParallel);
+	double t2 = hqtime();
+
+	// the output does not depend on how the work was split
+	ASSERT_EQUAL(true, cSerial.GetWidth() == cParallel.GetWidth() && cSerial.GetHeight() == cParallel.GetHeight());
+	ASSERT_EQUAL(true, memcmp(cSerial.GetPixels(), cParallel.GetPixels(), cSerial.GetSizeBytes()) == 0);
+	ASSERT_EQUAL(true, memcmp(&outSerial, &outParallel, sizeof(outSerial)) == 0);
+	ASSERT_EQUAL(true, cParallel.GetPixels()[0] == 0xffffffu);
+	ASSERT_EQUAL(true, cParallel.GetPixels()[cParallel.GetWidth() / 2 + cParallel.GetHeight() / 2 * cParallel.GetWidth()] == 0xffffffffu);
+	printf("- SimpleMaskBlurGen %ux%u: serial=%.3f ms parallel=%.3f ms (%u worker threads)\n",
+		cParallel.GetWidth(), cParallel.GetHeight(), (t1 - t0) * 1000, (t2 - t1) * 1000, ThreadPool::Get().GetNumThreads());
+}
+#endif
+
 } // ui
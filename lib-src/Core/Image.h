@@ -3,6 +3,7 @@
 
 #include "../Core/Math.h"
 #include "../Core/ObjectIteration.h"
+#include "../Core/Threading.h"
 
 #include <inttypes.h>
 #include <string.h>
@@ -196,6 +197,23 @@ struct Canvas
 	uint32_t* _pixels = nullptr;
 };
 
+// splits the processing of an image into bands of rows (or columns) and runs them on the thread pool (see ThreadPool::ParallelFor)
+// - calls f(begin, end) for each band of lines, lineLength = the number of pixels in one line
+// - bands have a fixed size (~16K pixels), so small images are processed on the calling thread
+//   and the output does not depend on the number of threads
+// - parallel = false calls f(0, numLines) on the calling thread instead
+constexpr u32 PARALLEL_IMAGE_BAND_PIXELS = 16384;
+template <class F> void ParallelForImageLines(u32 numLines, u32 lineLength, F&& f, bool parallel = true)
+{
+	if (!parallel)
+	{
+		if (numLines)
+			f(size_t(0), size_t(numLines));
+		return;
+	}
+	ThreadPool::Get().ParallelFor(numLines, max(PARALLEL_IMAGE_BAND_PIXELS / max(lineLength, 1u), 1u), f);
+}
+
 
 // for shadow images
 struct SimpleMaskBlurGen
@@ -229,7 +247,8 @@ struct SimpleMaskBlurGen
 	};
 
 	static bool OutputWillDiffer(const Input& a, const Input& b);
-	static void Generate(const Input& input, Output& output, Canvas& outCanvas);
+	// parallel = false does all the work on the calling thread
+	static void Generate(const Input& input, Output& output, Canvas& outCanvas, bool parallel = true);
 };
 
 UI_FORCEINLINE size_t HashValue(const SimpleMaskBlurGen::Input& v)
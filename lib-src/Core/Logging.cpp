@@ -4,12 +4,19 @@
 #include "../../ThirdParty/stb_sprintf.h"
 
 #include <time.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 
 
 extern "C"
 {
 	void __stdcall OutputDebugStringA(const char*);
 	unsigned long __stdcall GetCurrentThreadId();
+
+	typedef long (__stdcall* UI_LPTOP_LEVEL_EXCEPTION_FILTER)(struct _EXCEPTION_POINTERS*);
+	UI_LPTOP_LEVEL_EXCEPTION_FILTER __stdcall SetUnhandledExceptionFilter(UI_LPTOP_LEVEL_EXCEPTION_FILTER);
 }
 
 
@@ -19,9 +26,8 @@ namespace log {
 MulticastDelegate<LogLevel, const LogCategory&, LogMsgRef> OnAnyLogMessage;
 LogLevel GlobalLogLevel = LogLevel::All;
 
-static tm CurTime()
+static tm ToLocalTime(time_t src)
 {
-	time_t src = time(nullptr);
 	tm t = {};
 	if (localtime_s(&t, &src))
 		t = {};
@@ -69,17 +75,647 @@ bool CanLogDebug(const LogCategory& category)
 	return CanLogDynLev(LogLevel::Debug, category);
 }
 
+
+// - format specifiers -
+
+enum LogArgType : u8
+{
+	LogArg_None, // %%
+	LogArg_Int32,
+	LogArg_Int64,
+	LogArg_Double,
+	LogArg_Ptr,
+	LogArg_Str,
+	LogArg_Unsupported, // (%n)
+};
+
+struct LogFormatSpec
+{
+	const char* start; // at '%'
+	const char* end;
+	u8 numStars; // width/precision passed as arguments
+	bool hasPrecision;
+	bool precisionIsArg;
+	int precision; // if not passed as an argument
+	LogArgType type;
+};
+
+// finds the next format specifier (with the same rules as stb_sprintf), returns false if there are no more
+static bool LogNextFormatSpec(const char*& p, LogFormatSpec& spec)
+{
+	while (*p && *p != '%')
+		p++;
+	if (!*p)
+		return false;
+
+	spec = {};
+	spec.start = p++;
+	spec.precision = -1;
+
+	// flags
+	while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '\'' || *p == '$' || *p == '_')
+		p++;
+	if (*p == '0')
+		p++;
+
+	// width
+	if (*p == '*')
+	{
+		spec.numStars++;
+		p++;
+	}
+	else
+	{
+		while (*p >= '0' && *p <= '9')
+			p++;
+	}
+
+	// precision
+	if (*p == '.')
+	{
+		spec.hasPrecision = true;
+		p++;
+		if (*p == '*')
+		{
+			spec.numStars++;
+			spec.precisionIsArg = true;
+			p++;
+		}
+		else
+		{
+			spec.precision = 0;
+			while (*p >= '0' && *p <= '9')
+				spec.precision = spec.precision * 10 + *p++ - '0';
+		}
+	}
+
+	// integer size
+	bool is64 = false;
+	switch (*p)
+	{
+	case 'h':
+		p++;
+		if (*p == 'h')
+			p++;
+		break;
+	case 'l':
+		is64 = sizeof(long) == 8;
+		p++;
+		if (*p == 'l')
+		{
+			is64 = true;
+			p++;
+		}
+		break;
+	case 'j':
+	case 'z':
+	case 't':
+		is64 = sizeof(size_t) == 8;
+		p++;
+		break;
+	case 'I':
+		if (p[1] == '6' && p[2] == '4')
+		{
+			is64 = true;
+			p += 3;
+		}
+		else if (p[1] == '3' && p[2] == '2')
+			p += 3;
+		else
+		{
+			is64 = sizeof(void*) == 8;
+			p++;
+		}
+		break;
+	}
+
+	switch (*p)
+	{
+	case '%':
+		spec.type = LogArg_None;
+		break;
+	case 's':
+		spec.type = LogArg_Str;
+		break;
+	case 'c':
+		spec.type = LogArg_Int32;
+		break;
+	case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'b': case 'B':
+		spec.type = is64 ? LogArg_Int64 : LogArg_Int32;
+		break;
+	case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+		spec.type = LogArg_Double;
+		break;
+	case 'p':
+		spec.type = LogArg_Ptr;
+		break;
+	default:
+		spec.type = LogArg_Unsupported;
+		break;
+	}
+	if (*p)
+		p++;
+	spec.end = p;
+	return true;
+}
+
+
+// - binary records -
+
+enum LogRecordType : u8
+{
+	LogRecord_Wrap, // skip to the start of the buffer
+	LogRecord_Binary, // format string + arguments
+	LogRecord_Text, // already formatted message
+};
+
+struct LogRecordHeader
+{
+	u32 size; // including the header and padding
+	LogRecordType type;
+	LogLevel level;
+	u16 textLength;
+	u32 threadID;
+	const LogCategory* category;
+	const char* fmt;
+	time_t time;
+};
+
+static constexpr u32 LOG_MAX_ARGS_SIZE = 1024;
+static constexpr u32 LOG_MAX_TEXT_LENGTH = 1022;
+
+struct LogArgWriter
+{
+	alignas(8) char data[LOG_MAX_ARGS_SIZE];
+	u32 size = 0;
+	bool overflow = false;
+
+	void* Alloc(u32 n)
+	{
+		n = (n + 7) & ~7u;
+		if (size + n > LOG_MAX_ARGS_SIZE)
+		{
+			overflow = true;
+			return nullptr;
+		}
+		void* ret = data + size;
+		size += n;
+		return ret;
+	}
+	template <class T> void Write(T v)
+	{
+		if (void* p = Alloc(sizeof(T)))
+			memcpy(p, &v, sizeof(T));
+	}
+	void WriteStr(const char* s, int precision)
+	{
+		if (!s)
+		{
+			Write(u32(UINT32_MAX));
+			return;
+		}
+		size_t len = 0;
+		while ((precision < 0 || len < size_t(precision)) && s[len])
+			len++;
+		Write(u32(len));
+		if (char* p = (char*)Alloc(u32(len + 1)))
+		{
+			memcpy(p, s, len);
+			p[len] = '\0';
+		}
+	}
+};
+
+struct LogArgReader
+{
+	const char* data;
+
+	template <class T> T Read()
+	{
+		T v;
+		memcpy(&v, data, sizeof(T));
+		data += (sizeof(T) + 7) & ~7u;
+		return v;
+	}
+	const char* ReadStr()
+	{
+		u32 len = Read<u32>();
+		if (len == UINT32_MAX)
+			return nullptr;
+		const char* s = data;
+		data += (len + 1 + 7) & ~7u;
+		return s;
+	}
+};
+
+// returns false if the format string has something that cannot be stored
+static bool LogEncodeArgs(LogArgWriter& out, const char* fmt, va_list args)
+{
+	LogFormatSpec spec;
+	while (LogNextFormatSpec(fmt, spec))
+	{
+		if (spec.type == LogArg_None)
+			continue;
+		if (spec.type == LogArg_Unsupported)
+			return false;
+
+		int precision = spec.precision;
+		for (u8 i = 0; i < spec.numStars; i++)
+		{
+			int v = va_arg(args, int);
+			out.Write(v);
+			// the precision is always the last one
+			if (spec.precisionIsArg && i + 1 == spec.numStars)
+				precision = v;
+		}
+
+		switch (spec.type)
+		{
+		case LogArg_Int32: out.Write(va_arg(args, i32)); break;
+		case LogArg_Int64: out.Write(va_arg(args, i64)); break;
+		case LogArg_Double: out.Write(va_arg(args, double)); break;
+		case LogArg_Ptr: out.Write(va_arg(args, void*)); break;
+		case LogArg_Str: out.WriteStr(va_arg(args, const char*), precision); break;
+		default: break;
+		}
+	}
+	return !out.overflow;
+}
+
+template <class T>
+static int LogFormatOne(char* buf, int size, const char* spec, const int* stars, int numStars, T value)
+{
+	switch (numStars)
+	{
+	case 0: return stbsp_snprintf(buf, size, spec, value);
+	case 1: return stbsp_snprintf(buf, size, spec, stars[0], value);
+	default: return stbsp_snprintf(buf, size, spec, stars[0], stars[1], value);
+	}
+}
+
+// formats the message from the stored arguments, returns the length
+static size_t LogFormatBinary(char* buf, size_t size, const char* fmt, const char* argData)
+{
+	LogArgReader args = { argData };
+	size_t at = 0;
+	const char* p = fmt;
+	LogFormatSpec spec;
+	for (;;)
+	{
+		const char* textStart = p;
+		bool found = LogNextFormatSpec(p, spec);
+		const char* textEnd = found ? spec.start : p;
+		size_t textLen = min(size_t(textEnd - textStart), size - 1 - at);
+		memcpy(buf + at, textStart, textLen);
+		at += textLen;
+		if (!found || at + 1 >= size)
+			break;
+
+		char specStr[32];
+		size_t specLen = min(size_t(spec.end - spec.start), sizeof(specStr) - 1);
+		memcpy(specStr, spec.start, specLen);
+		specStr[specLen] = '\0';
+
+		int stars[2];
+		for (u8 i = 0; i < spec.numStars; i++)
+			stars[i] = args.Read<int>();
+
+		char* dst = buf + at;
+		int avail = int(size - at);
+		int n = 0;
+		switch (spec.type)
+		{
+		case LogArg_None: n = stbsp_snprintf(dst, avail, "%%"); break;
+		case LogArg_Int32: n = LogFormatOne(dst, avail, specStr, stars, spec.numStars, args.Read<i32>()); break;
+		case LogArg_Int64: n = LogFormatOne(dst, avail, specStr, stars, spec.numStars, args.Read<i64>()); break;
+		case LogArg_Double: n = LogFormatOne(dst, avail, specStr, stars, spec.numStars, args.Read<double>()); break;
+		case LogArg_Ptr: n = LogFormatOne(dst, avail, specStr, stars, spec.numStars, args.Read<void*>()); break;
+		case LogArg_Str: n = LogFormatOne(dst, avail, specStr, stars, spec.numStars, args.ReadStr()); break;
+		default: break;
+		}
+		at += min(size_t(max(n, 0)), size - 1 - at);
+	}
+	buf[at] = '\0';
+	return at;
+}
+
+
+// - per-thread buffers -
+
+// single producer (the owning thread), single consumer (whoever holds g_logDrainMutex)
+struct LogThreadBuffer
+{
+	static constexpr u32 SIZE = 64 * 1024; // power of 2
+
+	alignas(8) char data[SIZE];
+	alignas(64) std::atomic<u32> writePos{ 0 };
+	alignas(64) std::atomic<u32> readPos{ 0 };
+	std::atomic<bool> orphaned{ false };
+	LogThreadBuffer* next = nullptr;
+};
+
+static std::mutex g_logDrainMutex;
+static std::mutex g_logBuffersMutex;
+static LogThreadBuffer* g_logBuffers;
+
+static std::mutex g_logWriterMutex;
+static std::condition_variable g_logWriterCV;
+static bool g_logWriterWake;
+static bool g_logWriterPending;
+static bool g_logWriterQuit;
+// set when the writer may have missed new messages, the next one to be logged wakes it up
+static std::atomic<bool> g_logWriterIdle{ true };
+static std::thread* g_logWriterThread;
+static std::once_flag g_logInitFlag;
+
+static std::atomic<bool> g_logAsync{ true };
+static std::atomic<bool> g_logOutputFileSet{ false };
+static std::atomic<FILE*> g_logOutputFile{ nullptr };
+
+struct LogThreadBufferRef
+{
+	LogThreadBuffer* buf = nullptr;
+
+	~LogThreadBufferRef()
+	{
+		// the writer frees it after writing the remaining messages
+		if (buf)
+			buf->orphaned = true;
+	}
+};
+static thread_local LogThreadBufferRef g_logThreadBuffer;
+
+static FILE* LogGetOutputFile()
+{
+	return g_logOutputFileSet ? g_logOutputFile.load() : stderr;
+}
+
+static void LogWriteLine(char* line, size_t len)
+{
+	// line has space for the newline and the terminator
+	line[len++] = '\n';
+	line[len] = '\0';
+	if (FILE* f = LogGetOutputFile())
+		fwrite(line, 1, len, f);
+	OutputDebugStringA(line);
+}
+
+static size_t LogFormatPrefix(char* buf, size_t size, time_t time, u32 threadID, LogLevel level, const LogCategory& category)
+{
+	// the local time only changes once per second
+	static thread_local time_t lastTime = -1;
+	static thread_local char timeStr[32];
+	if (time != lastTime)
+	{
+		tm t = ToLocalTime(time);
+		strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S", &t);
+		lastTime = time;
+	}
+	int n = stbsp_snprintf(buf, int(size), "%s % 5ld %s|%s ", timeStr, long(threadID), g_levelNames[int(level)], category.name);
+	return min(size_t(n), size - 1);
+}
+
+static void LogWriteRecord(const LogRecordHeader* hdr)
+{
+	char buf[1024];
+	if (hdr->type == LogRecord_Text)
+	{
+		size_t len = min(size_t(hdr->textLength), sizeof(buf) - 2);
+		memcpy(buf, hdr + 1, len);
+		LogWriteLine(buf, len);
+		return;
+	}
+
+	size_t at = LogFormatPrefix(buf, sizeof(buf), hdr->time, hdr->threadID, hdr->level, *hdr->category);
+	// leave space for the newline
+	at += LogFormatBinary(buf + at, sizeof(buf) - 1 - at, hdr->fmt, reinterpret_cast<const char*>(hdr + 1));
+	LogWriteLine(buf, at);
+}
+
+// g_logDrainMutex must be locked
+static void LogDrainBuffer(LogThreadBuffer* tb)
+{
+	u32 r = tb->readPos.load(std::memory_order_relaxed);
+	u32 w = tb->writePos.load(std::memory_order_acquire);
+	while (r != w)
+	{
+		auto* hdr = reinterpret_cast<const LogRecordHeader*>(tb->data + (r & (LogThreadBuffer::SIZE - 1)));
+		if (hdr->type != LogRecord_Wrap)
+			LogWriteRecord(hdr);
+		r += hdr->size;
+	}
+	tb->readPos.store(r, std::memory_order_release);
+}
+
+// g_logDrainMutex must be locked
+static void LogDrainAll()
+{
+	std::lock_guard<std::mutex> lock(g_logBuffersMutex);
+	for (LogThreadBuffer** ptb = &g_logBuffers; *ptb; )
+	{
+		LogThreadBuffer* tb = *ptb;
+		LogDrainBuffer(tb);
+		if (tb->orphaned.load())
+		{
+			// the thread has exited so nothing more can be written
+			LogDrainBuffer(tb);
+			*ptb = tb->next;
+			delete tb;
+		}
+		else
+			ptb = &tb->next;
+	}
+	if (FILE* f = LogGetOutputFile())
+		fflush(f);
+}
+
+static void LogWriterThreadProc()
+{
+	std::unique_lock<std::mutex> lock(g_logWriterMutex);
+	while (!g_logWriterQuit)
+	{
+		// sleep until something is logged (the timeout only covers a message racing the idle flag)
+		g_logWriterCV.wait_for(lock, std::chrono::seconds(1), []() { return g_logWriterPending || g_logWriterWake || g_logWriterQuit; });
+		g_logWriterPending = false;
+
+		// let more messages accumulate to write them in one batch, unless a buffer is getting full
+		g_logWriterCV.wait_for(lock, std::chrono::milliseconds(10), []() { return g_logWriterWake || g_logWriterQuit; });
+		g_logWriterWake = false;
+
+		// anything written after this may not be picked up by the drain below
+		g_logWriterIdle = true;
+		lock.unlock();
+		{
+			std::lock_guard<std::mutex> drainLock(g_logDrainMutex);
+			LogDrainAll();
+		}
+		lock.lock();
+	}
+}
+
+static void LogShutdownAtExit()
+{
+	{
+		std::lock_guard<std::mutex> lock(g_logWriterMutex);
+		g_logWriterQuit = true;
+	}
+	g_logWriterCV.notify_one();
+	g_logWriterThread->join();
+
+	// anything logged after this point (e.g. from destructors) is written immediately
+	g_logAsync = false;
+	std::lock_guard<std::mutex> drainLock(g_logDrainMutex);
+	LogDrainAll();
+}
+
+static UI_LPTOP_LEVEL_EXCEPTION_FILTER g_logPrevExceptionFilter;
+static long __stdcall LogOnUnhandledException(struct _EXCEPTION_POINTERS* ep)
+{
+	// the crash could have happened while the messages were being written, don't wait too long for the lock
+	for (int i = 0; i < 100; i++)
+	{
+		if (g_logDrainMutex.try_lock())
+		{
+			LogDrainAll();
+			g_logDrainMutex.unlock();
+			break;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return g_logPrevExceptionFilter ? g_logPrevExceptionFilter(ep) : 0 /* EXCEPTION_CONTINUE_SEARCH */;
+}
+
+static void LogInit()
+{
+	std::call_once(g_logInitFlag, []()
+	{
+		g_logWriterThread = new std::thread(LogWriterThreadProc);
+		atexit(LogShutdownAtExit);
+		g_logPrevExceptionFilter = SetUnhandledExceptionFilter(LogOnUnhandledException);
+	});
+}
+
+static LogThreadBuffer* LogGetThreadBuffer()
+{
+	LogThreadBuffer* tb = g_logThreadBuffer.buf;
+	if (!tb)
+	{
+		LogInit();
+		tb = new LogThreadBuffer;
+		{
+			std::lock_guard<std::mutex> lock(g_logBuffersMutex);
+			tb->next = g_logBuffers;
+			g_logBuffers = tb;
+		}
+		g_logThreadBuffer.buf = tb;
+	}
+	return tb;
+}
+
+static void LogPushRecord(const LogRecordHeader& hdr, const void* payload, u32 payloadSize)
+{
+	LogThreadBuffer* tb = LogGetThreadBuffer();
+	u32 size = hdr.size;
+
+	u32 w = tb->writePos.load(std::memory_order_relaxed);
+	u32 idx = w & (LogThreadBuffer::SIZE - 1);
+	u32 toEnd = LogThreadBuffer::SIZE - idx;
+	u32 needed = size > toEnd ? size + toEnd : size;
+	if (w + needed - tb->readPos.load(std::memory_order_acquire) > LogThreadBuffer::SIZE)
+	{
+		// full - write out everything on this thread instead of waiting
+		std::lock_guard<std::mutex> drainLock(g_logDrainMutex);
+		LogDrainAll();
+	}
+
+	if (size > toEnd)
+	{
+		// records are 8-byte aligned so there's always space for the size and the type
+		auto* wrap = reinterpret_cast<LogRecordHeader*>(tb->data + idx);
+		wrap->size = toEnd;
+		wrap->type = LogRecord_Wrap;
+		w += toEnd;
+		idx = 0;
+	}
+	memcpy(tb->data + idx, &hdr, sizeof(hdr));
+	memcpy(tb->data + idx + sizeof(hdr), payload, payloadSize);
+
+	u32 prevUsed = w - tb->readPos.load(std::memory_order_relaxed);
+	tb->writePos.store(w + size, std::memory_order_release);
+
+	// wake up the writer for the first message since it last drained, and without waiting once per half of the buffer
+	bool urgent = prevUsed < LogThreadBuffer::SIZE / 2 && prevUsed + size >= LogThreadBuffer::SIZE / 2;
+	bool first = g_logWriterIdle.load(std::memory_order_relaxed) && g_logWriterIdle.exchange(false);
+	if (urgent || first)
+	{
+		{
+			std::lock_guard<std::mutex> lock(g_logWriterMutex);
+			if (urgent)
+				g_logWriterWake = true;
+			g_logWriterPending = true;
+		}
+		g_logWriterCV.notify_one();
+	}
+}
+
+void LogFlush()
+{
+	std::lock_guard<std::mutex> drainLock(g_logDrainMutex);
+	LogDrainAll();
+}
+
+void LogSetAsync(bool async)
+{
+	if (!async)
+		LogFlush();
+	g_logAsync = async;
+}
+
+void LogSetOutputFile(FILE* f)
+{
+	LogFlush();
+	g_logOutputFile = f;
+	g_logOutputFileSet = true;
+}
+
 void LogDynLevVA(LogLevel level, const LogCategory& category, const char* fmt, va_list args)
 {
 	if (!CanLogDynLev(level, category))
 		return;
 
+	bool async = g_logAsync.load(std::memory_order_relaxed);
+	bool hasListeners = category.onCategoryLogMessage._first || OnAnyLogMessage._first;
+	time_t curTime = time(nullptr);
+	u32 threadID = u32(GetCurrentThreadId());
+
+	if (async && !hasListeners)
+	{
+		LogArgWriter argWriter;
+		va_list argsCopy;
+		va_copy(argsCopy, args);
+		bool encoded = LogEncodeArgs(argWriter, fmt, argsCopy);
+		va_end(argsCopy);
+		if (encoded)
+		{
+			LogRecordHeader hdr = {};
+			hdr.size = u32(sizeof(hdr)) + argWriter.size;
+			hdr.type = LogRecord_Binary;
+			hdr.level = level;
+			hdr.threadID = threadID;
+			hdr.category = &category;
+			hdr.fmt = fmt;
+			hdr.time = curTime;
+			LogPushRecord(hdr, argWriter.data, argWriter.size);
+			if (level == LogLevel::Error)
+				LogFlush();
+			return;
+		}
+	}
+
 	char buf[1024];
-	tm t = CurTime();
-	size_t at = strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &t);
-	at += stbsp_snprintf(buf + at, sizeof(buf) - at, " % 5ld %s|%s ", GetCurrentThreadId(), g_levelNames[int(level)], category.name);
+	size_t at = LogFormatPrefix(buf, sizeof(buf), curTime, threadID, level, category);
 	const char* msgonly = buf + at;
-	at += stbsp_vsnprintf(buf + at, sizeof(buf) - at, fmt, args);
+	at += stbsp_vsnprintf(buf + at, int(sizeof(buf) - at), fmt, args);
 	if (at + 2 > sizeof(buf))
 		at = sizeof(buf) - 2;
 
@@ -93,11 +729,24 @@ void LogDynLevVA(LogLevel level, const LogCategory& category, const char* fmt, v
 	category.onCategoryLogMessage.Call(level, mref);
 	OnAnyLogMessage.Call(level, category, mref);
 
-	buf[at++] = '\n';
-	buf[at] = '\0';
+	if (async)
+	{
+		// still written in order with the other messages from this thread
+		LogRecordHeader hdr = {};
+		hdr.size = u32((sizeof(hdr) + at + 7) & ~size_t(7));
+		hdr.type = LogRecord_Text;
+		hdr.level = level;
+		hdr.textLength = u16(min(at, size_t(LOG_MAX_TEXT_LENGTH)));
+		hdr.threadID = threadID;
+		hdr.category = &category;
+		hdr.time = curTime;
+		LogPushRecord(hdr, buf, u32(hdr.size - sizeof(hdr)));
+		if (level == LogLevel::Error)
+			LogFlush();
+		return;
+	}
 
-	fwrite(buf, 1, at, stderr);
-	OutputDebugStringA(buf);
+	LogWriteLine(buf, at);
 }
 
 void LogDynLev(LogLevel level, const LogCategory& category, const char* fmt, ...)
@@ -139,6 +788,179 @@ void LogDebug(const LogCategory& category, const char* fmt, ...)
 	LogDynLevVA(LogLevel::Debug, category, fmt, args);
 	va_end(args);
 }
-
 } // log
+
+
+#if UI_BUILD_TESTS
+#include "Test.h"
+
+double hqtime();
+
+DEFINE_TEST_CATEGORY(Logging, 65);
+
+static size_t TestFormatBinary(char* buf, size_t size, const char* fmt, ...)
+{
+	LogArgWriter writer;
+	va_list args;
+	va_start(args, fmt);
+	bool encoded = LogEncodeArgs(writer, fmt, args);
+	va_end(args);
+	ASSERT_EQUAL(true, encoded);
+	return LogFormatBinary(buf, size, fmt, writer.data);
+}
+
+static bool TestEncodeArgs(const char* fmt, ...)
+{
+	LogArgWriter writer;
+	va_list args;
+	va_start(args, fmt);
+	bool encoded = LogEncodeArgs(writer, fmt, args);
+	va_end(args);
+	return encoded;
+}
+
+static void TestFormatRef(char* buf, size_t size, const char* fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	stbsp_vsnprintf(buf, int(size), fmt, args);
+	va_end(args);
+}
+
+#define CHECK_LOG_FORMAT(...) \
+	TestFormatBinary(actual, sizeof(actual), __VA_ARGS__); \
+	TestFormatRef(expected, sizeof(expected), __VA_ARGS__); \
+	ASSERT_EQUAL(true, strcmp(expected, actual) == 0)
+
+DEFINE_TEST(Logging, BinaryFormat)
+{
+	char expected[256], actual[256];
+	const char* longStr = "0123456789abcdefghijklmnopqrstuvwxyz";
+	CHECK_LOG_FORMAT("no arguments, 100%% literal");
+	CHECK_LOG_FORMAT("ints: %d %5i %-5u| %x %X %o %c %hhd %hd", -12, 34, 56u, 0xabc, 0xdef, 8, 'z', 300, 70000);
+	CHECK_LOG_FORMAT("64-bit: %lld %llx %zu %I64d %jd", -1234567890123ll, 0xabcdef012345ull, size_t(1) << 40, i64(-5), i64(6));
+	CHECK_LOG_FORMAT("floats: %f %.2f %10.3e %g %'.1f %$d", 1.5, 3.14159, 1e-7, 2.5e10f, 1234567.89, 123456);
+	CHECK_LOG_FORMAT("stars: [%*d] [%-*d] [%.*f] [%*.*s]", 6, 42, 6, 42, 2, 1.23456, 8, 3, "abcdef");
+	CHECK_LOG_FORMAT("strings: '%s' '%.5s' '%.*s' '%10s' '%s'", "abc", longStr, 4, longStr + 10, "right", (const char*)nullptr);
+	CHECK_LOG_FORMAT("pointer: %p", (void*)0x1234);
+
+	// the precision limits how much of the string is read (not zero-terminated)
+	char unterminated[4] = { 'a', 'b', 'c', 'd' };
+	CHECK_LOG_FORMAT("[%.*s]", 4, unterminated);
+
+	// truncated
+	TestFormatBinary(actual, 8, "%s and more", longStr);
+	ASSERT_EQUAL(true, strcmp(actual, "0123456") == 0);
+
+	// arguments that can't be stored fall back to formatting on the calling thread
+	char big[LOG_MAX_ARGS_SIZE + 1];
+	memset(big, 'x', LOG_MAX_ARGS_SIZE);
+	big[LOG_MAX_ARGS_SIZE] = '\0';
+	ASSERT_EQUAL(false, TestEncodeArgs("%s", big));
+	ASSERT_EQUAL(true, TestEncodeArgs("%.10s", big));
+	ASSERT_EQUAL(false, TestEncodeArgs("%d%n", 1, (int*)nullptr));
+}
+
+static LogCategory LOG_TEST("Test", LogLevel::All);
+
+DEFINE_TEST(Logging, AsyncThreads)
+{
+	FILE* f = tmpfile();
+	LogSetOutputFile(f);
+
+	constexpr int NUM_THREADS = 4;
+	constexpr int NUM_MESSAGES = 20000;
+	std::thread threads[NUM_THREADS];
+	for (int t = 0; t < NUM_THREADS; t++)
+	{
+		threads[t] = std::thread([t]()
+		{
+			for (int i = 0; i < NUM_MESSAGES; i++)
+				LogDebug(LOG_TEST, "thread=%d msg=%d %s", t, i, "text");
+		});
+	}
+	for (auto& t : threads)
+		t.join();
+
+	// messages with listeners are formatted on the calling thread but stay in order
+	int numCalls = 0;
+	auto* e = LOG_TEST.onCategoryLogMessage.AddNoArgs([&numCalls]() { numCalls++; });
+	LogDebug(LOG_TEST, "thread=%d msg=%d %s", NUM_THREADS, 0, "text");
+	e->Destroy();
+	LogDebug(LOG_TEST, "thread=%d msg=%d %s", NUM_THREADS, 1, "text");
+	ASSERT_EQUAL(true, numCalls == 1);
+
+	LogFlush();
+	LogSetOutputFile(stderr);
+
+	int next[NUM_THREADS + 1] = {};
+	int numLines = 0;
+	char line[1024];
+	fseek(f, 0, SEEK_SET);
+	while (fgets(line, sizeof(line), f))
+	{
+		const char* msg = strstr(line, "debug|Test thread=");
+		ASSERT_EQUAL(true, msg != nullptr);
+		int t = -1, i = -1;
+		sscanf(msg, "debug|Test thread=%d msg=%d", &t, &i);
+		ASSERT_EQUAL(true, t >= 0 && t <= NUM_THREADS);
+		ASSERT_EQUAL(true, i == next[t]);
+		next[t] = i + 1;
+		ASSERT_EQUAL(true, strstr(msg, " text\n") != nullptr);
+		numLines++;
+	}
+	ASSERT_EQUAL(true, numLines == NUM_THREADS * NUM_MESSAGES + 2);
+	for (int t = 0; t < NUM_THREADS; t++)
+		ASSERT_EQUAL(true, next[t] == NUM_MESSAGES);
+	ASSERT_EQUAL(true, next[NUM_THREADS] == 2);
+	fclose(f);
+}
+
+DEFINE_TEST(Logging, Benchmark)
+{
+	constexpr int NUM_CALLS = 1000000;
+	FILE* f = tmpfile();
+	LogSetOutputFile(f);
+
+	double t0 = hqtime();
+	for (int i = 0; i < NUM_CALLS; i++)
+		LogDebug(LOG_TEST, "message %d of %d (%s) %f", i, NUM_CALLS, "benchmark", i * 0.5);
+	double t1 = hqtime();
+	LogFlush();
+	double t2 = hqtime();
+
+	// the time spent on the calling thread when the writer keeps up (short bursts that fit in the buffer)
+	constexpr int BURST_SIZE = 200;
+	double tBurst = 0;
+	for (int b = 0; b < NUM_CALLS / BURST_SIZE; b++)
+	{
+		double tb = hqtime();
+		for (int i = 0; i < BURST_SIZE; i++)
+			LogDebug(LOG_TEST, "message %d of %d (%s) %f", i, NUM_CALLS, "benchmark", i * 0.5);
+		tBurst += hqtime() - tb;
+		LogFlush();
+	}
+
+	LogSetAsync(false);
+	double t3 = hqtime();
+	for (int i = 0; i < NUM_CALLS; i++)
+		LogDebug(LOG_TEST, "message %d of %d (%s) %f", i, NUM_CALLS, "benchmark", i * 0.5);
+	double t4 = hqtime();
+	LogSetAsync(true);
+
+	// filtered out before anything is formatted or stored
+	LOG_TEST.level = LogLevel::Info;
+	double t5 = hqtime();
+	for (int i = 0; i < NUM_CALLS; i++)
+		LogDebug(LOG_TEST, "message %d of %d (%s) %f", i, NUM_CALLS, "benchmark", i * 0.5);
+	double t6 = hqtime();
+	LOG_TEST.level = LogLevel::All;
+
+	LogSetOutputFile(stderr);
+	fclose(f);
+	printf("- %d calls: async=%.1f ms (+%.1f ms flush) async caller only=%.1f ms sync=%.1f ms filtered=%.1f ms\n",
+		NUM_CALLS, (t1 - t0) * 1000, (t2 - t1) * 1000, tBurst * 1000, (t4 - t3) * 1000, (t6 - t5) * 1000);
+}
+#endif
+
 } // ui
@@ -5,6 +5,7 @@
 #include "Delegate.h"
 
 #include <stdarg.h>
+#include <stdio.h>
 
 
 namespace ui {
@@ -45,6 +46,18 @@ bool CanLogWarn(const LogCategory& category);
 bool CanLogInfo(const LogCategory& category);
 bool CanLogDebug(const LogCategory& category);
 
+// messages are written to the output file (stderr by default) and the debugger output by a background thread
+// - the arguments are stored in a per-thread buffer and the message is formatted by the writer thread,
+//   so the format string must be a literal (or otherwise stay valid until the message is written)
+// - messages are formatted on the calling thread if the category or OnAnyLogMessage has listeners
+//   (they're called before returning, as usual)
+// - errors are written before returning, the rest on exit, on crashes (unhandled exceptions) and by LogFlush
+void LogFlush();
+// disabled = each message is written before returning
+void LogSetAsync(bool async);
+// nullptr = only write to the debugger output
+void LogSetOutputFile(FILE* f);
+
 void LogDynLevVA(LogLevel level, const LogCategory& category, const char* fmt, va_list args);
 void LogDynLev(LogLevel level, const LogCategory& category, const char* fmt, ...);
 
@@ -0,0 +1,228 @@
+#include "MemoryAccounting.h"
+
+#include "FileSystem.h"
+#include "SerializationJSON.h"
+
+#include <atomic>
+
+
+namespace ui {
+
+static const char* const g_memTagNames[] =
+{
+	"Other",
+	"UIObjects",
+	"TextureAtlas",
+	"Images",
+	"Glyphs",
+	"VectorImages",
+	"BoxShadows",
+	"Theme",
+	"Serialization",
+};
+static_assert(sizeof(g_memTagNames) / sizeof(g_memTagNames[0]) == size_t(MemTag::COUNT), "tag names do not match the enum");
+
+const char* MemTagGetName(MemTag tag)
+{
+	return tag < MemTag::COUNT ? g_memTagNames[size_t(tag)] : "<invalid>";
+}
+
+
+// relaxed counters - the peaks can be slightly off while several threads are changing the same tag
+struct MemTagCounters
+{
+	std::atomic<u64> numAllocs;
+	std::atomic<u64> numBytes;
+	std::atomic<u64> peakAllocs;
+	std::atomic<u64> peakBytes;
+	std::atomic<u64> totalAllocs;
+};
+static MemTagCounters g_memTagCounters[size_t(MemTag::COUNT)];
+
+#if UI_MEMORY_ACCOUNTING
+static void MemUpdatePeak(std::atomic<u64>& peak, u64 value)
+{
+	u64 prev = peak.load(std::memory_order_relaxed);
+	while (value > prev && !peak.compare_exchange_weak(prev, value, std::memory_order_relaxed));
+}
+
+void MemTrackAlloc(MemTag tag, size_t bytes)
+{
+	auto& C = g_memTagCounters[size_t(tag)];
+	MemUpdatePeak(C.peakAllocs, C.numAllocs.fetch_add(1, std::memory_order_relaxed) + 1);
+	MemUpdatePeak(C.peakBytes, C.numBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+	C.totalAllocs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MemTrackFree(MemTag tag, size_t bytes)
+{
+	auto& C = g_memTagCounters[size_t(tag)];
+	C.numAllocs.fetch_sub(1, std::memory_order_relaxed);
+	C.numBytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+void MemTrackResize(MemTag tag, size_t oldBytes, size_t newBytes)
+{
+	auto& C = g_memTagCounters[size_t(tag)];
+	if (newBytes > oldBytes)
+		MemUpdatePeak(C.peakBytes, C.numBytes.fetch_add(newBytes - oldBytes, std::memory_order_relaxed) + (newBytes - oldBytes));
+	else
+		C.numBytes.fetch_sub(oldBytes - newBytes, std::memory_order_relaxed);
+}
+#endif
+
+MemTagStats MemGetStats(MemTag tag)
+{
+	auto& C = g_memTagCounters[size_t(tag)];
+	MemTagStats ret;
+	ret.numAllocs = C.numAllocs.load(std::memory_order_relaxed);
+	ret.numBytes = C.numBytes.load(std::memory_order_relaxed);
+	ret.peakAllocs = C.peakAllocs.load(std::memory_order_relaxed);
+	ret.peakBytes = C.peakBytes.load(std::memory_order_relaxed);
+	ret.totalAllocs = C.totalAllocs.load(std::memory_order_relaxed);
+	return ret;
+}
+
+void MemResetPeaks()
+{
+	for (auto& C : g_memTagCounters)
+	{
+		C.peakAllocs.store(C.numAllocs.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		C.peakBytes.store(C.numBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+}
+
+std::string MemStatsToJSON()
+{
+	// read everything first so that the writer's own buffer is not a part of the output
+	MemTagStats stats[size_t(MemTag::COUNT)];
+	for (size_t i = 0; i < size_t(MemTag::COUNT); i++)
+		stats[i] = MemGetStats(MemTag(i));
+
+	JSONLinearWriter w;
+	for (size_t i = 0; i < size_t(MemTag::COUNT); i++)
+	{
+		const auto& S = stats[i];
+		w.BeginDict(g_memTagNames[i]);
+		w.WriteInt("numAllocs", S.numAllocs);
+		w.WriteInt("numBytes", S.numBytes);
+		w.WriteInt("peakAllocs", S.peakAllocs);
+		w.WriteInt("peakBytes", S.peakBytes);
+		w.WriteInt("totalAllocs", S.totalAllocs);
+		w.EndDict();
+	}
+	return Move(w.GetData());
+}
+
+bool MemWriteStatsJSON(StringView path)
+{
+	return WriteTextFile(path, MemStatsToJSON());
+}
+
+
+static thread_local MemTag g_memScopeTag = MemTag::COUNT;
+
+MemTag MemGetScopeTag(MemTag defaultTag)
+{
+	return g_memScopeTag != MemTag::COUNT ? g_memScopeTag : defaultTag;
+}
+
+MemTagScope::MemTagScope(MemTag tag) : prevTag(g_memScopeTag)
+{
+	g_memScopeTag = tag;
+}
+
+MemTagScope::~MemTagScope()
+{
+	g_memScopeTag = prevTag;
+}
+
+
+#if UI_BUILD_TESTS && UI_MEMORY_ACCOUNTING
+#include "Test.h"
+
+DEFINE_TEST_CATEGORY(MemoryAccounting, 520);
+
+DEFINE_TEST(MemoryAccounting, Counters)
+{
+	MemResetPeaks();
+	auto base = MemGetStats(MemTag::Other);
+
+	MemTrackAlloc(MemTag::Other, 100);
+	MemTrackAlloc(MemTag::Other, 50);
+	MemTrackResize(MemTag::Other, 50, 250);
+	MemTrackResize(MemTag::Other, 250, 20);
+	MemTrackFree(MemTag::Other, 100);
+
+	auto s = MemGetStats(MemTag::Other);
+	ASSERT_EQUAL(true, s.numAllocs == base.numAllocs + 1);
+	ASSERT_EQUAL(true, s.numBytes == base.numBytes + 20);
+	ASSERT_EQUAL(true, s.peakAllocs == base.numAllocs + 2);
+	ASSERT_EQUAL(true, s.peakBytes == base.numBytes + 350);
+	ASSERT_EQUAL(true, s.totalAllocs == base.totalAllocs + 2);
+
+	MemTrackFree(MemTag::Other, 20);
+	s = MemGetStats(MemTag::Other);
+	ASSERT_EQUAL(true, s.numAllocs == base.numAllocs && s.numBytes == base.numBytes);
+
+	MemResetPeaks();
+	s = MemGetStats(MemTag::Other);
+	ASSERT_EQUAL(true, s.peakAllocs == base.numAllocs && s.peakBytes == base.numBytes);
+}
+
+DEFINE_TEST(MemoryAccounting, ScopesAndTrackedSizes)
+{
+	auto baseOther = MemGetStats(MemTag::Other);
+	auto baseTheme = MemGetStats(MemTag::Theme);
+
+	ASSERT_EQUAL(true, MemGetScopeTag(MemTag::Other) == MemTag::Other);
+	{
+		MemTagScope scope(MemTag::Theme);
+		ASSERT_EQUAL(true, MemGetScopeTag(MemTag::Other) == MemTag::Theme);
+		{
+			MemTagScope scope2(MemTag::Glyphs);
+			ASSERT_EQUAL(true, MemGetScopeTag(MemTag::Other) == MemTag::Glyphs);
+		}
+		ASSERT_EQUAL(true, MemGetScopeTag(MemTag::Other) == MemTag::Theme);
+
+		MemTrackedSize ts(MemTag::Other);
+		ts.Set(64);
+		ts.Set(128);
+		MemTrackedSize copy = ts;
+		ASSERT_EQUAL(true, copy.tag == MemTag::Theme && copy.bytes == 0);
+		copy.Set(10);
+
+		auto s = MemGetStats(MemTag::Theme);
+		ASSERT_EQUAL(true, s.numAllocs == baseTheme.numAllocs + 2);
+		ASSERT_EQUAL(true, s.numBytes == baseTheme.numBytes + 138);
+	}
+	ASSERT_EQUAL(true, MemGetScopeTag(MemTag::Other) == MemTag::Other);
+
+	auto s = MemGetStats(MemTag::Theme);
+	ASSERT_EQUAL(true, s.numAllocs == baseTheme.numAllocs && s.numBytes == baseTheme.numBytes);
+	s = MemGetStats(MemTag::Other);
+	ASSERT_EQUAL(true, s.numAllocs == baseOther.numAllocs && s.numBytes == baseOther.numBytes);
+}
+
+DEFINE_TEST(MemoryAccounting, JSON)
+{
+	MemTrackAlloc(MemTag::BoxShadows, 12345);
+	std::string json = MemStatsToJSON();
+	MemTrackFree(MemTag::BoxShadows, 12345);
+
+	JSONLinearReader r;
+	ASSERT_EQUAL(true, r.Parse(json));
+	for (size_t i = 0; i < size_t(MemTag::COUNT); i++)
+	{
+		ASSERT_EQUAL(true, r.BeginDict(MemTagGetName(MemTag(i))));
+		ASSERT_EQUAL(true, r.ReadUInt64("numAllocs").HasValue());
+		ASSERT_EQUAL(true, r.ReadUInt64("peakBytes").HasValue());
+		if (MemTag(i) == MemTag::BoxShadows)
+			ASSERT_EQUAL(true, r.ReadUInt64("numBytes").GetValueOrDefault(0) >= 12345);
+		r.EndDict();
+	}
+}
+
+#endif
+
+} // ui
@@ -0,0 +1,107 @@
+
+#pragma once
+#include "Platform.h"
+#include "String.h"
+
+
+// compiled out entirely if set to 0 (the stats stay at zero)
+#ifndef UI_MEMORY_ACCOUNTING
+#define UI_MEMORY_ACCOUNTING 1
+#endif
+
+
+namespace ui {
+
+// memory owned by each subsystem (allocation counts, bytes and their high-water marks)
+// - only the allocations explicitly tracked by the subsystems are counted, not the general heap usage
+// - texture sizes are estimated from their dimensions (the GPU memory is not queried)
+// - the counters can be updated and read from any thread
+
+enum class MemTag : u8
+{
+	Other,
+	UIObjects,
+	TextureAtlas, // atlas pages
+	Images, // images not created by any of the other subsystems
+	Glyphs,
+	VectorImages, // loaded vector images and their rasterizations
+	BoxShadows,
+	Theme, // theme files and the images loaded with them
+	Serialization, // reader/writer buffers
+
+	COUNT,
+};
+
+const char* MemTagGetName(MemTag tag);
+
+struct MemTagStats
+{
+	u64 numAllocs;
+	u64 numBytes;
+	u64 peakAllocs;
+	u64 peakBytes;
+	u64 totalAllocs; // including the freed ones
+};
+
+#if UI_MEMORY_ACCOUNTING
+void MemTrackAlloc(MemTag tag, size_t bytes);
+void MemTrackFree(MemTag tag, size_t bytes);
+// for buffers that change size without being reallocated as a whole
+void MemTrackResize(MemTag tag, size_t oldBytes, size_t newBytes);
+#else
+UI_FORCEINLINE void MemTrackAlloc(MemTag, size_t) {}
+UI_FORCEINLINE void MemTrackFree(MemTag, size_t) {}
+UI_FORCEINLINE void MemTrackResize(MemTag, size_t, size_t) {}
+#endif
+
+MemTagStats MemGetStats(MemTag tag);
+// sets the high-water marks to the current values
+void MemResetPeaks();
+
+// { "<tag name>": { "numAllocs": ..., "numBytes": ..., "peakAllocs": ..., "peakBytes": ..., "totalAllocs": ... }, ... }
+std::string MemStatsToJSON();
+bool MemWriteStatsJSON(StringView path);
+
+// the owner of the allocations made by shared code (e.g. images, serialization buffers) in the current thread
+// - returns defaultTag if there is no MemTagScope
+MemTag MemGetScopeTag(MemTag defaultTag);
+
+struct MemTagScope
+{
+	MemTag prevTag;
+
+	MemTagScope(MemTag tag);
+	~MemTagScope();
+	MemTagScope(const MemTagScope&) = delete;
+	MemTagScope& operator = (const MemTagScope&) = delete;
+};
+
+// the tracked size of a growable buffer (e.g. the capacity of a std::string), updated by its owner
+// - counted as one allocation while not empty
+// - the tag is picked when it's created (using MemGetScopeTag)
+struct MemTrackedSize
+{
+	MemTag tag;
+	size_t bytes = 0;
+
+	explicit MemTrackedSize(MemTag defaultTag) : tag(MemGetScopeTag(defaultTag)) {}
+	// the copies start out empty, their size is set by the new owner
+	MemTrackedSize(const MemTrackedSize& o) : tag(o.tag) {}
+	MemTrackedSize& operator = (const MemTrackedSize&) { return *this; }
+	~MemTrackedSize() { Set(0); }
+
+	void Set(size_t newBytes)
+	{
+		if (newBytes == bytes)
+			return;
+		if (!bytes)
+			MemTrackAlloc(tag, newBytes);
+		else if (!newBytes)
+			MemTrackFree(tag, bytes);
+		else
+			MemTrackResize(tag, bytes, newBytes);
+		bytes = newBytes;
+	}
+};
+
+} // ui
@@ -9,6 +9,7 @@
 #endif
 
 #include <inttypes.h>
+#include <type_traits>
 
 
 #ifdef _MSC_VER
@@ -26,6 +27,26 @@
 #endif
 
 
+// target architecture
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+# define UI_ARCH_X86 1
+#elif defined(_M_ARM64) || defined(__aarch64__)
+# define UI_ARCH_ARM64 1
+#endif
+
+// enables instruction sets beyond the compile-time target for one function
+// (only call it after checking GetCPUFeatures, MSVC allows the intrinsics without this)
+#if defined(__GNUC__) || defined(__clang__)
+# define UI_TARGET_SSE41 __attribute__((target("sse4.1")))
+# define UI_TARGET_AVX2 __attribute__((target("avx2")))
+# define UI_TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#else
+# define UI_TARGET_SSE41
+# define UI_TARGET_AVX2
+# define UI_TARGET_AVX512
+#endif
+
+
 namespace ui {
 
 using i8 = int8_t;
@@ -44,4 +65,10 @@ template <class T> struct RemoveReference<T&&> { typedef T Type; };
 template <class T> constexpr typename RemoveReference<T>::Type&& Move(T&& t) noexcept
 { return static_cast<typename RemoveReference<T>::Type&&>(t); }
 
+// types that can be moved to a new address with memcpy/realloc, without running any constructors or destructors
+// - true for all trivially copyable types
+// - other types can opt in with UI_DECLARE_TRIVIALLY_RELOCATABLE or a (partial) specialization (both inside namespace ui)
+template <class T> struct IsTriviallyRelocatable { static constexpr bool value = std::is_trivially_copyable<T>::value; };
+#define UI_DECLARE_TRIVIALLY_RELOCATABLE(T) template <> struct IsTriviallyRelocatable<T> { static constexpr bool value = true; }
+
 } // ui
@@ -0,0 +1,429 @@
+
+#include "Profiler.h"
+
+#include "FileSystem.h"
+#include "HashMap.h"
+#include "SerializationJSON.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+
+namespace ui {
+
+std::atomic<bool> g_profilerEnabled{ false };
+
+void ProfilerSetEnabled(bool enabled)
+{
+	g_profilerEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+static const auto g_profilerTimeBase = std::chrono::steady_clock::now();
+
+u64 ProfilerGetTime()
+{
+	return u64(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_profilerTimeBase).count());
+}
+
+
+// the owning thread writes to the last chunk without locking (publishing with `count`)
+// and takes the thread's mutex only to add chunks
+struct ProfilerChunk
+{
+	static constexpr u32 CAPACITY = 4096;
+
+	ProfilerZoneData zones[CAPACITY];
+	std::atomic<u32> count{ 0 };
+	u32 begin = 0; // zones before it were cleared
+	ProfilerChunk* next = nullptr;
+};
+
+struct ProfilerThreadBuffer
+{
+	std::mutex mutex;
+	ProfilerChunk* first = nullptr;
+	ProfilerChunk* last = nullptr;
+	u32 id = 0;
+	std::string name;
+	std::atomic<bool> exited{ false };
+	ProfilerThreadBuffer* next = nullptr;
+
+	~ProfilerThreadBuffer()
+	{
+		while (first)
+		{
+			auto* c = first;
+			first = first->next;
+			delete c;
+		}
+	}
+};
+
+static std::mutex g_profilerThreadsMutex;
+static ProfilerThreadBuffer* g_profilerThreads;
+static u32 g_profilerNextThreadID = 1;
+
+struct ProfilerThreadBufferRef
+{
+	ProfilerThreadBuffer* buf = nullptr;
+	std::string name; // until the buffer is created
+
+	~ProfilerThreadBufferRef()
+	{
+		// the recorded zones are kept until the next ProfilerClear
+		if (buf)
+			buf->exited = true;
+	}
+};
+static thread_local ProfilerThreadBufferRef g_profilerThreadBuffer;
+
+static ProfilerThreadBuffer* ProfilerGetThreadBuffer()
+{
+	ProfilerThreadBuffer* tb = g_profilerThreadBuffer.buf;
+	if (!tb)
+	{
+		tb = new ProfilerThreadBuffer;
+		tb->first = tb->last = new ProfilerChunk;
+		tb->name = Move(g_profilerThreadBuffer.name);
+
+		std::lock_guard<std::mutex> lock(g_profilerThreadsMutex);
+		tb->id = g_profilerNextThreadID++;
+		// kept in the order of creation
+		ProfilerThreadBuffer** ptb = &g_profilerThreads;
+		while (*ptb)
+			ptb = &(*ptb)->next;
+		*ptb = tb;
+		g_profilerThreadBuffer.buf = tb;
+	}
+	return tb;
+}
+
+void _ProfilerAddZone(const char* name, const char* detail, u64 start, u64 end)
+{
+	ProfilerThreadBuffer* tb = ProfilerGetThreadBuffer();
+	ProfilerChunk* chunk = tb->last;
+	u32 n = chunk->count.load(std::memory_order_relaxed);
+	if (n == ProfilerChunk::CAPACITY)
+	{
+		auto* nc = new ProfilerChunk;
+		std::lock_guard<std::mutex> lock(tb->mutex);
+		chunk->next = nc;
+		tb->last = nc;
+		chunk = nc;
+		n = 0;
+	}
+	chunk->zones[n] = { name, detail, start, end };
+	chunk->count.store(n + 1, std::memory_order_release);
+}
+
+void ProfilerSetThreadName(StringView name)
+{
+	// don't allocate the buffer for threads that never record anything
+	ProfilerThreadBuffer* tb = g_profilerThreadBuffer.buf;
+	if (!tb)
+	{
+		g_profilerThreadBuffer.name.assign(name.data(), name.size());
+		return;
+	}
+	std::lock_guard<std::mutex> lock(tb->mutex);
+	tb->name.assign(name.data(), name.size());
+}
+
+void ProfilerClear()
+{
+	std::lock_guard<std::mutex> lock(g_profilerThreadsMutex);
+	for (ProfilerThreadBuffer** ptb = &g_profilerThreads; *ptb; )
+	{
+		ProfilerThreadBuffer* tb = *ptb;
+		if (tb->exited.load())
+		{
+			*ptb = tb->next;
+			delete tb;
+			continue;
+		}
+
+		{
+			// the last chunk may be getting written to so it's only marked as cleared
+			std::lock_guard<std::mutex> tlock(tb->mutex);
+			while (tb->first != tb->last)
+			{
+				auto* c = tb->first;
+				tb->first = c->next;
+				delete c;
+			}
+			tb->last->begin = tb->last->count.load(std::memory_order_acquire);
+		}
+		ptb = &tb->next;
+	}
+}
+
+
+size_t ProfilerCapture::GetZoneCount() const
+{
+	size_t ret = 0;
+	for (const auto& T : threads)
+		ret += T.zones.Size();
+	return ret;
+}
+
+ProfilerCapture ProfilerGetCapture()
+{
+	ProfilerCapture ret;
+
+	std::lock_guard<std::mutex> lock(g_profilerThreadsMutex);
+	for (ProfilerThreadBuffer* tb = g_profilerThreads; tb; tb = tb->next)
+	{
+		ProfilerThreadData T;
+		T.id = tb->id;
+
+		std::lock_guard<std::mutex> tlock(tb->mutex);
+		T.name = tb->name;
+		for (ProfilerChunk* c = tb->first; c; c = c->next)
+		{
+			u32 count = c->count.load(std::memory_order_acquire);
+			for (u32 i = c->begin; i < count; i++)
+				T.zones.Append(c->zones[i]);
+		}
+		if (T.zones.NotEmpty() || !T.name.empty())
+			ret.threads.Append(Move(T));
+	}
+	return ret;
+}
+
+std::string ProfilerCapture::ToChromeTraceJSON() const
+{
+	JSONLinearWriter w;
+	w.indent = nullptr;
+	w.WriteString("displayTimeUnit", "ms");
+	w.BeginArray("traceEvents");
+	for (const auto& T : threads)
+	{
+		if (!T.name.empty())
+		{
+			w.BeginDict({});
+			w.WriteString("name", "thread_name");
+			w.WriteString("ph", "M");
+			w.WriteInt("pid", 1);
+			w.WriteInt("tid", T.id);
+			w.BeginDict("args");
+			w.WriteString("name", T.name);
+			w.EndDict();
+			w.EndDict();
+		}
+		for (const auto& Z : T.zones)
+		{
+			// complete events ("X"), nesting is derived from the times
+			w.BeginDict({});
+			w.WriteString("name", Z.name);
+			w.WriteString("cat", "ui");
+			w.WriteString("ph", "X");
+			w.WriteFloatDouble("ts", Z.start * 0.001);
+			w.WriteFloatDouble("dur", (Z.end - Z.start) * 0.001);
+			w.WriteInt("pid", 1);
+			w.WriteInt("tid", T.id);
+			if (Z.detail)
+			{
+				w.BeginDict("args");
+				w.WriteString("detail", Z.detail);
+				w.EndDict();
+			}
+			w.EndDict();
+		}
+	}
+	w.EndArray();
+	return Move(w.GetData());
+}
+
+// binary format (little endian):
+//   char[8] "UIPROF01"
+//   u32 string count, then each string: u32 length, chars (no terminator)
+//   u32 thread count, then each thread:
+//     u32 id, u32 name string (UINT32_MAX = none), u32 zone count, then each zone:
+//       u32 name string, u32 detail string (UINT32_MAX = none), u64 start, u64 end (nanoseconds)
+
+template <class T>
+static void ProfilerAppendBinary(std::string& out, T v)
+{
+	out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+std::string ProfilerCapture::ToBinary() const
+{
+	HashMap<const char*, u32> stringIndices;
+	Array<StringView> strings;
+	auto getStringIndex = [&](const char* s) -> u32
+	{
+		if (!s)
+			return UINT32_MAX;
+		bool inserted = false;
+		auto it = stringIndices.Insert(s, u32(strings.Size()), &inserted);
+		if (inserted)
+			strings.Append(s);
+		return it->value;
+	};
+
+	std::string body;
+	ProfilerAppendBinary(body, u32(threads.Size()));
+	for (const auto& T : threads)
+	{
+		ProfilerAppendBinary(body, T.id);
+		ProfilerAppendBinary(body, T.name.empty() ? UINT32_MAX : getStringIndex(T.name.c_str()));
+		ProfilerAppendBinary(body, u32(T.zones.Size()));
+		for (const auto& Z : T.zones)
+		{
+			ProfilerAppendBinary(body, getStringIndex(Z.name));
+			ProfilerAppendBinary(body, getStringIndex(Z.detail));
+			ProfilerAppendBinary(body, Z.start);
+			ProfilerAppendBinary(body, Z.end);
+		}
+	}
+
+	std::string ret = "UIPROF01";
+	ProfilerAppendBinary(ret, u32(strings.Size()));
+	for (StringView s : strings)
+	{
+		ProfilerAppendBinary(ret, u32(s.size()));
+		ret.append(s.data(), s.size());
+	}
+	ret += body;
+	return ret;
+}
+
+bool ProfilerWriteChromeTrace(StringView path)
+{
+	return WriteTextFile(path, ProfilerGetCapture().ToChromeTraceJSON());
+}
+
+bool ProfilerWriteBinary(StringView path)
+{
+	std::string data = ProfilerGetCapture().ToBinary();
+	return WriteBinaryFile(path, data.data(), data.size());
+}
+
+
+#if UI_BUILD_TESTS
+#include "Test.h"
+
+DEFINE_TEST_CATEGORY(Profiler, 510);
+
+static void TestProfilerNested(int depth)
+{
+	UI_PROFILE_ZONE_DETAIL("Nested", depth % 2 ? "odd" : "even");
+	if (depth > 1)
+		TestProfilerNested(depth - 1);
+}
+
+// these tests need to clear the recorded data, which would throw away the data of the test runner (--profile)
+static bool ProfilerTestSkipIfRecording()
+{
+	if (!ProfilerIsEnabled())
+		return false;
+	printf("- skipped (the tests are being profiled)\n");
+	return true;
+}
+
+DEFINE_TEST(Profiler, Zones)
+{
+	if (ProfilerTestSkipIfRecording())
+		return;
+	ProfilerClear();
+
+	// nothing is recorded while disabled, and the detail isn't evaluated
+	int numDetailEvals = 0;
+	auto detail = [&numDetailEvals]() { numDetailEvals++; return "detail"; };
+	{
+		UI_PROFILE_ZONE("Disabled");
+		UI_PROFILE_ZONE_DETAIL("DisabledDetail", detail());
+	}
+	ASSERT_EQUAL(true, ProfilerGetCapture().GetZoneCount() == 0);
+	ASSERT_EQUAL(true, numDetailEvals == 0);
+
+	ProfilerSetEnabled(true);
+	{
+		UI_PROFILE_ZONE("Outer");
+		TestProfilerNested(3);
+	}
+	std::thread t([]()
+	{
+		ProfilerSetThreadName("Test thread");
+		// more than one chunk
+		for (int i = 0; i < 10000; i++)
+		{
+			UI_PROFILE_ZONE("Loop");
+		}
+	});
+	t.join();
+	ProfilerSetEnabled(false);
+
+	auto cap = ProfilerGetCapture();
+	ASSERT_EQUAL(true, cap.GetZoneCount() == 10004);
+
+	const ProfilerThreadData* mainThread = nullptr;
+	const ProfilerThreadData* testThread = nullptr;
+	for (const auto& T : cap.threads)
+	{
+		if (T.name == "Test thread")
+			testThread = &T;
+		else if (T.zones.NotEmpty())
+			mainThread = &T;
+	}
+	ASSERT_EQUAL(true, mainThread && testThread);
+	ASSERT_EQUAL(true, testThread->zones.Size() == 10000);
+	ASSERT_EQUAL(true, mainThread->zones.Size() == 4);
+
+	// the inner zones end first
+	const auto& Z = mainThread->zones;
+	ASSERT_EQUAL(true, strcmp(Z[0].name, "Nested") == 0 && strcmp(Z[0].detail, "odd") == 0);
+	ASSERT_EQUAL(true, strcmp(Z[1].detail, "even") == 0);
+	ASSERT_EQUAL(true, strcmp(Z[3].name, "Outer") == 0 && Z[3].detail == nullptr);
+	for (int i = 0; i < 3; i++)
+		ASSERT_EQUAL(true, Z[i].start >= Z[i + 1].start && Z[i].end <= Z[i + 1].end);
+
+	std::string json = cap.ToChromeTraceJSON();
+	ASSERT_EQUAL(true, json.find("\"traceEvents\":[") != std::string::npos);
+	ASSERT_EQUAL(true, json.find("{\"name\":\"thread_name\",\"ph\":\"M\"") != std::string::npos);
+	ASSERT_EQUAL(true, json.find("\"args\": {\"name\":\"Test thread\"}") != std::string::npos);
+	ASSERT_EQUAL(true, json.find("\"args\": {\"detail\":\"odd\"}") != std::string::npos);
+
+	// header + strings ("Test thread", "Loop", "Nested", "odd", "even", "Outer") + threads + zones
+	std::string bin = cap.ToBinary();
+	size_t expSize = 8 + 4 + (6 * 4 + 11 + 4 + 6 + 3 + 4 + 5) + 4 + cap.threads.Size() * 12 + 10004 * 24;
+	ASSERT_EQUAL(true, bin.compare(0, 8, "UIPROF01") == 0);
+	ASSERT_EQUAL(true, bin.size() == expSize);
+
+	ProfilerClear();
+	ASSERT_EQUAL(true, ProfilerGetCapture().GetZoneCount() == 0);
+}
+
+DEFINE_TEST(Profiler, Overhead)
+{
+	constexpr int COUNT = 1000000;
+	if (ProfilerTestSkipIfRecording())
+		return;
+	ProfilerClear();
+
+	double t0 = hqtime();
+	for (int i = 0; i < COUNT; i++)
+	{
+		UI_PROFILE_ZONE("Overhead");
+	}
+	double t1 = hqtime();
+
+	ProfilerSetEnabled(true);
+	for (int i = 0; i < COUNT; i++)
+	{
+		UI_PROFILE_ZONE("Overhead");
+	}
+	ProfilerSetEnabled(false);
+	double t2 = hqtime();
+
+	ASSERT_EQUAL(true, ProfilerGetCapture().GetZoneCount() == COUNT);
+	ProfilerClear();
+
+	printf("- %d zones: disabled=%.2f ms enabled=%.2f ms\n", COUNT, (t1 - t0) * 1000, (t2 - t1) * 1000);
+}
+#endif
+
+} // ui
@@ -0,0 +1,111 @@
+
+#pragma once
+#include "Platform.h"
+#include "Array.h"
+#include "String.h"
+
+#include <atomic>
+
+
+// compiled out entirely if set to 0
+#ifndef UI_PROFILER
+#define UI_PROFILER 1
+#endif
+
+
+namespace ui {
+
+// scoped zones recorded into per-thread buffers (while the profiler is enabled)
+// - the name and the detail must stay valid until the data is cleared (literals, typeid names etc.)
+// - the detail expression of UI_PROFILE_ZONE_DETAIL is only evaluated while enabled
+// - when disabled, a zone only checks a global flag
+// - enabling/disabling is expected to happen between frames, when no zones are open
+
+extern std::atomic<bool> g_profilerEnabled;
+
+void ProfilerSetEnabled(bool enabled);
+UI_FORCEINLINE bool ProfilerIsEnabled() { return g_profilerEnabled.load(std::memory_order_relaxed); }
+// frees the recorded zones of all threads
+void ProfilerClear();
+// the name is copied, shown in the exported data
+void ProfilerSetThreadName(StringView name);
+// in nanoseconds
+u64 ProfilerGetTime();
+
+void _ProfilerAddZone(const char* name, const char* detail, u64 start, u64 end);
+
+struct ProfileZone
+{
+	const char* name;
+	const char* detail;
+	u64 start;
+
+	UI_FORCEINLINE ProfileZone(const char* nm)
+	{
+		if (ProfilerIsEnabled())
+		{
+			name = nm;
+			detail = nullptr;
+			start = ProfilerGetTime();
+		}
+		else
+			name = nullptr;
+	}
+	UI_FORCEINLINE ~ProfileZone()
+	{
+		if (name)
+			_ProfilerAddZone(name, detail, start, ProfilerGetTime());
+	}
+	UI_FORCEINLINE bool IsActive() const { return name != nullptr; }
+	UI_FORCEINLINE void SetDetail(const char* det) { detail = det; }
+
+	ProfileZone(const ProfileZone&) = delete;
+	ProfileZone& operator = (const ProfileZone&) = delete;
+};
+
+#define UI_PROFILE_CONCAT_(a, b) a##b
+#define UI_PROFILE_CONCAT(a, b) UI_PROFILE_CONCAT_(a, b)
+#if UI_PROFILER
+# define UI_PROFILE_ZONE(name) ::ui::ProfileZone UI_PROFILE_CONCAT(_uiProfileZone, __LINE__)(name)
+# define UI_PROFILE_ZONE_DETAIL(name, detail) ::ui::ProfileZone UI_PROFILE_CONCAT(_uiProfileZone, __LINE__)(name); \
+	if (UI_PROFILE_CONCAT(_uiProfileZone, __LINE__).IsActive()) UI_PROFILE_CONCAT(_uiProfileZone, __LINE__).SetDetail(detail)
+#else
+# define UI_PROFILE_ZONE(name)
+# define UI_PROFILE_ZONE_DETAIL(name, detail)
+#endif
+
+
+struct ProfilerZoneData
+{
+	const char* name;
+	const char* detail;
+	u64 start;
+	u64 end;
+};
+
+struct ProfilerThreadData
+{
+	u32 id;
+	std::string name;
+	Array<ProfilerZoneData> zones; // ordered by the end time
+};
+
+struct ProfilerCapture
+{
+	Array<ProfilerThreadData> threads;
+
+	size_t GetZoneCount() const;
+
+	// https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU (loadable in chrome://tracing, ui.perfetto.dev)
+	std::string ToChromeTraceJSON() const;
+	// "UIPROF" format - see Profiler.cpp
+	std::string ToBinary() const;
+};
+
+// copies the zones recorded so far (can be called while other threads are recording)
+ProfilerCapture ProfilerGetCapture();
+
+bool ProfilerWriteChromeTrace(StringView path);
+bool ProfilerWriteBinary(StringView path);
+
+} // ui
@@ -40,7 +40,7 @@ public:
 	void AddRef() override { _refCount++; }
 	void Release() override
 	{
-		if (--_refCount == 0)
+		if (_refCount.Decrement() == 0)
 			delete this;
 	}
 };
@@ -178,4 +178,7 @@ public:
 
 template <class T> UI_FORCEINLINE RCHandle<T> AsRCHandle(T* ptr) { return ptr; }
 
+// only holds a pointer
+template <class T> struct IsTriviallyRelocatable<RCHandle<T>> { static constexpr bool value = true; };
+
 } // ui
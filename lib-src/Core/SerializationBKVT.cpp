@@ -1,6 +1,8 @@
 
 #include "SerializationBKVT.h"
 
+#include <algorithm>
+
 
 namespace ui {
 
@@ -12,6 +14,18 @@ static To BitCast(From v)
 	return ret;
 }
 
+// part of the format, must not change
+static u32 BKVTHashKey(StringView key)
+{
+	u32 h = 2166136261u;
+	for (char c : key)
+	{
+		h ^= u8(c);
+		h *= 16777619u;
+	}
+	return h;
+}
+
 u32 BKVTLinearWriter::_AppendKey(StringView key)
 {
 	u8 len = u8(min(key.Size(), size_t(255)));
@@ -60,7 +74,13 @@ u32 BKVTLinearWriter::_AppendArray(size_t num, size_t nbytes, const void* data)
 void BKVTLinearWriter::_WriteElem(StringView key, BKVT_Type type, u32 val)
 {
 	auto& S = _stack.Last();
-	S.entries.Append({ u8(type), S.hasKeys ? _AppendKey(key) : 0, val });
+	if (S.hasKeys)
+	{
+		u32 keyHash = sortKeysByHash ? BKVTHashKey(key.substr(0, 255)) : 0;
+		S.entries.Append({ u8(type), _AppendKey(key), val, keyHash });
+	}
+	else
+		S.entries.Append({ u8(type), 0, val, 0 });
 }
 
 void BKVTLinearWriter::WriteNull(StringView key)
@@ -170,6 +190,12 @@ u32 BKVTLinearWriter::_WriteAndRemoveTopObject()
 	auto& S = _stack.Last();
 	u16 num = u16(S.entries.Size());
 
+	if (sortKeysByHash)
+	{
+		// stable to keep finding the first one of any duplicate keys
+		std::stable_sort(S.entries.begin(), S.entries.end(), [](const Entry& a, const Entry& b) { return a.keyHash < b.keyHash; });
+	}
+
 	u32 pos = _AppendMem(&num, sizeof(num));
 	for (auto& e : S.entries)
 		_AppendMem(&e.key, sizeof(e.key));
@@ -177,8 +203,14 @@ u32 BKVTLinearWriter::_WriteAndRemoveTopObject()
 		_AppendMem(&e.value, sizeof(e.value));
 	for (auto& e : S.entries)
 		_data.Append(e.type);
+	if (sortKeysByHash)
+	{
+		for (auto& e : S.entries)
+			_AppendMem(&e.keyHash, sizeof(e.keyHash));
+	}
 
 	_stack.RemoveLast();
+	_dataMem.Set(_data.Capacity());
 	return pos;
 }
 
@@ -214,6 +246,7 @@ void BKVTLinearWriter::EndArray()
 		_data.Append(e.type);
 
 	_stack.RemoveLast();
+	_dataMem.Set(_data.Capacity());
 
 	_stack.Last().entries.Last().value = pos;
 }
@@ -231,6 +264,8 @@ StringView BKVTLinearWriter::GetData(bool withPrefix)
 	{
 		// finalize
 		u32 rootpos = _WriteAndRemoveTopObject();
+		if (sortKeysByHash)
+			rootpos |= BKVT_ROOT_FLAG_SORTED_KEYS;
 		memcpy(&_data[4], &rootpos, sizeof(rootpos));
 	}
 	StringView ret = _data;
@@ -252,8 +287,14 @@ bool BKVTLinearReader::Init(StringView data, bool hasPrefix)
 		if (data.Size() < 10)
 			return false;
 	}
-	_data = data.substr(4);
-	_stack.Append({ { _ReadU32(0), BKVT_Type::Object }, 0 });
+	// the root offset is at the start of the data without the prefix
+	_data = hasPrefix ? data.substr(4) : data;
+	u32 rootpos = _ReadU32(0);
+	_keysSortedByHash = (rootpos & BKVT_ROOT_FLAG_SORTED_KEYS) != 0;
+	rootpos &= ~BKVT_ROOT_FLAG_SORTED_KEYS;
+	if (rootpos >= _data.Size())
+		return false;
+	_stack.Append({ { rootpos, BKVT_Type::Object }, 0 });
 	return true;
 }
 
@@ -304,7 +345,25 @@ BKVTLinearReader::EntryRef BKVTLinearReader::FindEntry(StringView key)
 		u32 pos = S.entry.pos;
 		u32 num = _ReadU16(pos);
 		pos += 2;
-		for (u32 i = 0; i < num; i++)
+		u32 i = 0;
+		u32 end = num;
+		if (_keysSortedByHash)
+		{
+			// binary search for the first entry with the same hash
+			u32 hpos = pos + num * 9;
+			u32 hash = BKVTHashKey(key);
+			while (i < end)
+			{
+				u32 mid = (i + end) / 2;
+				if (_ReadU32(hpos + mid * 4) < hash)
+					i = mid + 1;
+				else
+					end = mid;
+			}
+			// only compare the keys with the same hash
+			for (end = i; end < num && _ReadU32(hpos + end * 4) == hash; end++);
+		}
+		for (; i < end; i++)
 		{
 			if (_GetKeyString(_ReadU32(pos + i * 4)) == key)
 			{
@@ -850,4 +909,147 @@ bool BKVTUnserializer::OnFieldManyF32(const FieldInfo& FI, u32 count, float* arr
 	return false;
 }
 
+
+#if UI_BUILD_TESTS
+#include "Test.h"
+
+double hqtime();
+
+DEFINE_TEST_CATEGORY(BKVT, 530);
+
+DEFINE_TEST(BKVT, OriginalFormat)
+{
+	BKVTLinearWriter w;
+	w.WriteInt32("a", 5);
+	StringView data = w.GetData(true);
+
+	static const u8 expected[] =
+	{
+		'B', 'K', 'V', 'T', 7, 0, 0, 0, // prefix, root offset
+		1, 'a', 0, // key
+		1, 0, 4, 0, 0, 0, 5, 0, 0, 0, u8(BKVT_Type::S32), // object
+	};
+	ASSERT_EQUAL(true, data == StringView((const char*)expected, sizeof(expected)));
+
+	BKVTLinearReader r;
+	ASSERT_EQUAL(true, r.Init(StringView((const char*)expected, sizeof(expected)), true));
+	ASSERT_EQUAL(true, r.ReadInt32("a").GetValueOrDefault(0) == 5);
+	ASSERT_EQUAL(true, !r.ReadInt32("b").HasValue());
+}
+
+static void BKVTTestRoundTrip(bool sortKeysByHash, bool withPrefix)
+{
+	BKVTLinearWriter w;
+	w.skipDuplicateKeys = false;
+	w.sortKeysByHash = sortKeysByHash;
+	for (int i = 0; i < 50; i++)
+		w.WriteInt32(Format("key%d", i), i * 3);
+	w.WriteInt32("dup", 1);
+	w.WriteString("str", "text");
+	w.WriteInt32("dup", 2);
+	w.BeginObject("obj");
+	{
+		w.WriteFloat64("f", 1.5);
+		w.BeginArray("arr");
+		for (int i = 0; i < 3; i++)
+		{
+			w.BeginObject({});
+			w.WriteInt64("v", i + 10);
+			w.EndObject();
+		}
+		w.EndArray();
+	}
+	w.EndObject();
+	std::string data = to_string(w.GetData(withPrefix));
+
+	BKVTLinearReader r;
+	ASSERT_EQUAL(true, r.Init(data, withPrefix));
+	for (int i = 49; i >= 0; i--)
+		ASSERT_EQUAL(true, r.ReadInt32(Format("key%d", i)).GetValueOrDefault(-1) == i * 3);
+	ASSERT_EQUAL(true, !r.ReadInt32("key50").HasValue());
+	ASSERT_EQUAL(true, !r.ReadInt32("").HasValue());
+	ASSERT_EQUAL(true, r.ReadInt32("dup").GetValueOrDefault(0) == 1);
+	ASSERT_EQUAL(true, r.ReadString("str").GetValueOrDefault({}) == "text");
+
+	ASSERT_EQUAL(true, r.BeginObject("obj"));
+	{
+		ASSERT_EQUAL(true, r.ReadFloat64("f").GetValueOrDefault(0) == 1.5);
+		ASSERT_EQUAL(true, r.BeginArray("arr"));
+		ASSERT_EQUAL(true, r.GetCurrentArraySize() == 3);
+		for (int i = 0; i < 3; i++)
+		{
+			ASSERT_EQUAL(true, r.HasMoreArrayElements());
+			ASSERT_EQUAL(true, r.BeginObject({}));
+			ASSERT_EQUAL(true, r.ReadInt64("v").GetValueOrDefault(0) == i + 10);
+			r.EndObject();
+		}
+		ASSERT_EQUAL(true, !r.HasMoreArrayElements());
+		r.EndArray();
+	}
+	r.EndObject();
+}
+
+DEFINE_TEST(BKVT, RoundTrip)
+{
+	BKVTTestRoundTrip(false, true);
+	BKVTTestRoundTrip(false, false);
+}
+
+DEFINE_TEST(BKVT, RoundTripSortedKeys)
+{
+	BKVTTestRoundTrip(true, true);
+	BKVTTestRoundTrip(true, false);
+}
+
+DEFINE_TEST(BKVT, KeyLookupBenchmark)
+{
+	for (int numKeys : { 10, 100, 1000, 10000 })
+	{
+		Array<std::string> keys;
+		for (int i = 0; i < numKeys; i++)
+			keys.Append(Format("key%d", i));
+
+		// look up in a different order than written
+		Array<u32> order;
+		u32 seed = 12345;
+		for (int i = 0; i < numKeys; i++)
+			order.Append(i);
+		for (int i = numKeys - 1; i > 0; i--)
+		{
+			seed = seed * 1103515245u + 12345u;
+			std::swap(order[i], order[(seed >> 8) % u32(i + 1)]);
+		}
+
+		double times[2];
+		for (int sorted = 0; sorted < 2; sorted++)
+		{
+			BKVTLinearWriter w;
+			w.sortKeysByHash = sorted != 0;
+			for (int i = 0; i < numKeys; i++)
+				w.WriteInt32(keys[i], i);
+			std::string data = to_string(w.GetData(true));
+
+			BKVTLinearReader r;
+			ASSERT_EQUAL(true, r.Init(data, true));
+
+			int numRepeats = max(1, 100000 / numKeys);
+			if (!sorted && numKeys >= 1000)
+				numRepeats = max(1, numRepeats / 10); // linear search is slow
+			int numFound = 0;
+			double t0 = hqtime();
+			for (int n = 0; n < numRepeats; n++)
+			{
+				for (u32 i : order)
+					numFound += r.ReadInt32(keys[i]).GetValueOrDefault(-1) == int(i);
+			}
+			double t1 = hqtime();
+			ASSERT_EQUAL(true, numFound == numKeys * numRepeats);
+			times[sorted] = (t1 - t0) * 1e9 / (double(numKeys) * numRepeats);
+		}
+		printf("- %d keys: linear %.1f ns/lookup, sorted by hash %.1f ns/lookup\n", numKeys, times[0], times[1]);
+	}
+}
+
+#endif
+
 } // ui
@@ -4,6 +4,7 @@
 #include "ObjectIteration.h"
 #include "Optional.h"
 #include "HashMap.h"
+#include "MemoryAccounting.h"
 
 
 // BKVT = binary key-value tree
@@ -11,7 +12,10 @@
 // - uninteresting parts can be skipped, the format can be extended with additional types
 /*
 
-Root = u32-offset-to(Object)
+Root = u32-offset-to(Object) | flags
+
+flags (the top bit of the root offset, not set in the original format):
+	0x80000000 = the entries of each object are sorted by key hash and have the hashes stored
 
 Object =
 {
@@ -19,6 +23,7 @@ Object =
 	keys: Key[size]
 	values: Value[size]
 	types: u8[size]
+	hashes: u32[size] (only if sorted by key hash - FNV-1a of the key text, ascending)
 }
 
 Array =
@@ -50,6 +55,8 @@ Value = s32 | u32 | f32 | u32-offset-to(s64 | u64 | f64 | Array | Object | Typed
 
 namespace ui {
 
+constexpr u32 BKVT_ROOT_FLAG_SORTED_KEYS = 0x80000000;
+
 enum class BKVT_Type : u8
 {
 	Null,
@@ -90,6 +97,7 @@ struct BKVTLinearWriter
 		u8 type;
 		u32 key;
 		u32 value;
+		u32 keyHash;
 	};
 
 	struct StagingObject
@@ -120,8 +128,11 @@ struct BKVTLinearWriter
 	Array<StagingObject> _stack = { {} };
 	Array<char> _data = { 'B', 'K', 'V', 'T', 0, 0, 0, 0 };
 	HashMap<KeyStringRef, u32, KeyStringRef::Comparer> _writtenKeys;
+	MemTrackedSize _dataMem{ MemTag::Serialization }; // updated at the end of each object
 
 	bool skipDuplicateKeys = true;
+	// makes key lookup O(log N) but the data can only be read by the readers that support the flag (set before writing)
+	bool sortKeysByHash = false;
 
 	u32 _AppendKey(StringView key);
 	u32 _AppendMem(const void* mem, size_t size);
@@ -227,6 +238,7 @@ struct BKVTLinearReader
 
 	StringView _data;
 	Array<StackElement> _stack;
+	bool _keysSortedByHash = false;
 };
 
 struct BKVTSerializer : BKVTLinearWriter, IObjectIterator
@@ -28,6 +28,7 @@ dato::ValueRef DATOLinearWriter::_WriteAndRemoveTopObject()
 	auto& S = _stack.Last();
 	auto vref = _writer.WriteStringMap(S.entriesStrMap.Data(), S.entriesStrMap.Size());
 	_stack.RemoveLast();
+	_dataMem.Set(_writer._mem);
 	return vref;
 }
 
@@ -60,6 +61,7 @@ void DATOLinearWriter::EndArray()
 	auto& S0 = _stack.Last();
 	auto vref = _writer.WriteArray(S0.entriesArr.Data(), S0.entriesArr.Size());
 	_stack.RemoveLast();
+	_dataMem.Set(_writer._mem);
 
 	auto& S = _stack.Last();
 	if (S.hasKeys)
@@ -4,6 +4,7 @@
 #include "ObjectIteration.h"
 #include "Optional.h"
 #include "Array.h"
+#include "MemoryAccounting.h"
 
 #include "../../ThirdParty/dato_reader.hpp"
 #include "../../ThirdParty/dato_writer.hpp"
@@ -29,6 +30,7 @@ struct DATOLinearWriter
 
 	dato::Writer _writer;
 	Array<StagingObject> _stack = { {} };
+	MemTrackedSize _dataMem{ MemTag::Serialization }; // updated at the end of each object
 
 	DATOLinearWriter(StringView prefix = "DATO", bool aligned = true, bool sortKeys = true, bool skipDuplicateKeys = true);
 
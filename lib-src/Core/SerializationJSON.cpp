@@ -156,6 +156,7 @@ std::string& JSONLinearWriter::GetData()
 		_data += indent ? end : end + 1;
 		_inArray.RemoveLast();
 	}
+	_dataMem.Set(_data.capacity());
 	return _data;
 }
 
@@ -202,6 +203,7 @@ void JSONLinearWriter::_OnEndObject()
 	}
 	_starts[_starts.size() - 2].weight += _starts.Last().weight;
 	_starts.RemoveLast();
+	_dataMem.Set(_data.capacity());
 }
 
 
@@ -218,13 +220,21 @@ void JSONLinearReader::_Free()
 		free(_root);
 		_root = nullptr;
 	}
+	_rootMem.Set(0);
+}
+
+// json.h allocates the whole document at once
+static void* JSONAllocTracked(void* userdata, size_t size)
+{
+	static_cast<MemTrackedSize*>(userdata)->Set(size);
+	return malloc(size);
 }
 
 bool JSONLinearReader::Parse(StringView all, unsigned flags)
 {
 	_Free();
 	json_parse_result_s parseResult = {};
-	_root = json_parse_ex(all.data(), all.size(), flags, nullptr, nullptr, &parseResult);
+	_root = json_parse_ex(all.data(), all.size(), flags, JSONAllocTracked, &_rootMem, &parseResult);
 	if (!_root || parseResult.error != json_parse_error_none)
 	{
 		LogError(LOG_SERIALIZATION_JSON, "json_parse_ex failed with error=%zu (line=%zu offset=%zu row=%zu)",
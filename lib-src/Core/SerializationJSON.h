@@ -3,6 +3,7 @@
 
 #include "ObjectIteration.h"
 #include "Optional.h"
+#include "MemoryAccounting.h"
 
 
 struct json_value_s;
@@ -22,6 +23,7 @@ struct JSONLinearWriter
 	std::string _data;
 	Array<CompactScope> _starts;
 	Array<bool> _inArray;
+	MemTrackedSize _dataMem{ MemTag::Serialization }; // updated at the end of each object
 
 	// null = no indent or spacing
 	// other values = the specified string will be used for indentation ..
@@ -99,6 +101,7 @@ struct JSONLinearReader
 
 	json_value_s* _root = nullptr;
 	Array<StackElement> _stack;
+	MemTrackedSize _rootMem{ MemTag::Serialization };
 
 	~JSONLinearReader();
 	void _Free();
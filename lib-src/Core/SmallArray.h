@@ -0,0 +1,324 @@
+#pragma once
+
+#include "Array.h"
+
+
+namespace ui {
+
+// stores up to N elements inside the object, allocates only when growing past that
+// - the API is a subset of Array, converts to ArrayView
+// - once moved to the heap, the data stays there until the array is destroyed
+template <class T, size_t N>
+struct SmallArray
+{
+	static_assert(N > 0, "use Array for no inline storage");
+
+	using ValueType = T;
+
+	T* _data;
+	size_t _size = 0;
+	size_t _capacity = N;
+	alignas(T) char _inline[sizeof(T) * N];
+
+	// whole object ops
+	UI_FORCEINLINE SmallArray() : _data(_Inline()) {}
+	SmallArray(const SmallArray& o) : _data(_Inline()) { AppendRange(o); }
+	SmallArray(const std::initializer_list<T>& il) : _data(_Inline()) { AppendRange(il); }
+	SmallArray(ArrayView<T> v) : _data(_Inline()) { AppendRange(v); }
+	SmallArray(SmallArray&& o) : _data(_Inline()) { _MoveFrom(o); }
+	SmallArray& operator = (const SmallArray& o)
+	{
+		if (this != &o)
+			AssignRange(o);
+		return *this;
+	}
+	SmallArray& operator = (const std::initializer_list<T>& il)
+	{
+		AssignRange(il);
+		return *this;
+	}
+	SmallArray& operator = (SmallArray&& o)
+	{
+		if (this != &o)
+		{
+			Clear();
+			_MoveFrom(o);
+		}
+		return *this;
+	}
+
+	UI_FORCEINLINE ~SmallArray()
+	{
+		Clear();
+		if (!IsInline())
+			free(_data);
+	}
+
+	void _MoveFrom(SmallArray& o)
+	{
+		if (!o.IsInline())
+		{
+			// take over the allocation
+			if (!IsInline())
+				free(_data);
+			_data = o._data;
+			_capacity = o._capacity;
+			_size = o._size;
+			o._data = o._Inline();
+			o._capacity = N;
+			o._size = 0;
+		}
+		else
+		{
+			Reserve(o._size);
+			for (size_t i = 0; i < o._size; i++)
+				new (&_data[i]) T(Move(o._data[i]));
+			_size = o._size;
+			o.Clear();
+		}
+	}
+
+	void Clear()
+	{
+		UI_IF_MAYBE_CONSTEXPR(!std::is_trivially_destructible<T>::value)
+		{
+			for (size_t i = 0; i < _size; i++)
+				_data[i].~T();
+		}
+		_size = 0;
+	}
+
+	void AssignMany(const T* p, size_t n)
+	{
+		Clear();
+		AppendMany(p, n);
+	}
+	template <class R>
+	void AssignRange(const R& r)
+	{
+		Clear();
+		AppendRange(r);
+	}
+
+	// info
+	UI_FORCEINLINE T* _Inline() { return reinterpret_cast<T*>(_inline); }
+	UI_FORCEINLINE bool IsInline() const { return _data == reinterpret_cast<const T*>(_inline); }
+
+	UI_FORCEINLINE size_t size() const { return _size; }
+	UI_FORCEINLINE T* data() { return _data; }
+	UI_FORCEINLINE T* begin() { return _data; }
+	UI_FORCEINLINE T* end() { return _data + _size; }
+	UI_FORCEINLINE const T* data() const { return _data; }
+	UI_FORCEINLINE const T* begin() const { return _data; }
+	UI_FORCEINLINE const T* end() const { return _data + _size; }
+
+	UI_FORCEINLINE bool IsEmpty() const { return _size == 0; }
+	UI_FORCEINLINE bool NotEmpty() const { return _size != 0; }
+	UI_FORCEINLINE T* Data() { return _data; }
+	UI_FORCEINLINE const T* Data() const { return _data; }
+	UI_FORCEINLINE size_t Size() const { return _size; }
+	UI_FORCEINLINE size_t SizeInBytes() const { return _size * sizeof(T); }
+	UI_FORCEINLINE size_t Capacity() const { return _capacity; }
+	UI_FORCEINLINE ArrayView<T> View() const { return { _data, _size }; }
+
+	T& At(size_t i)
+	{
+		assert(i < _size);
+		return _data[i];
+	}
+	UI_FORCEINLINE const T& At(size_t i) const { return const_cast<SmallArray*>(this)->At(i); }
+
+	T& operator [] (size_t i)
+	{
+		assert(i < _size);
+		return _data[i];
+	}
+	UI_FORCEINLINE const T& operator [] (size_t i) const { return const_cast<SmallArray*>(this)->operator[](i); }
+
+	T& First() { assert(NotEmpty()); return *_data; }
+	const T& First() const { assert(NotEmpty()); return *_data; }
+	T& Last() { assert(NotEmpty()); return _data[_size - 1]; }
+	const T& Last() const { assert(NotEmpty()); return _data[_size - 1]; }
+
+	T& PrevWrap(size_t i)
+	{
+		assert(i < _size);
+		return _data[(i + _size - 1) % _size];
+	}
+	UI_FORCEINLINE const T& PrevWrap(size_t i) const { return const_cast<SmallArray*>(this)->PrevWrap(i); }
+	T& NextWrap(size_t i)
+	{
+		assert(i < _size);
+		return _data[(i + 1) % _size];
+	}
+	UI_FORCEINLINE const T& NextWrap(size_t i) const { return const_cast<SmallArray*>(this)->NextWrap(i); }
+
+	template <class T2>
+	size_t IndexOfT(const T2& v, size_t from = 0) const
+	{
+		for (size_t i = from; i < _size; i++)
+			if (_data[i] == v)
+				return i;
+		return SIZE_MAX;
+	}
+	UI_FORCEINLINE bool Contains(const T& what, size_t from = 0) const { return IndexOfT(what, from) != SIZE_MAX; }
+	UI_FORCEINLINE size_t IndexOf(const T& what, size_t from = 0) const { return IndexOfT(what, from); }
+
+	// simple modification
+	void _Realloc(size_t newCap)
+	{
+		assert(newCap > _capacity);
+		UI_IF_MAYBE_CONSTEXPR(IsTriviallyRelocatable<T>::value)
+		{
+			if (!IsInline())
+			{
+				_data = (T*)realloc(_data, sizeof(T) * newCap);
+				_capacity = newCap;
+				return;
+			}
+		}
+
+		auto* newData = (T*)malloc(sizeof(T) * newCap);
+
+		UI_IF_MAYBE_CONSTEXPR(IsTriviallyRelocatable<T>::value)
+		{
+			memcpy(newData, _data, _size * sizeof(T));
+		}
+		else
+		{
+			for (size_t i = 0; i < _size; i++)
+			{
+				new (&newData[i]) T(Move(_data[i]));
+				_data[i].~T();
+			}
+		}
+
+		if (!IsInline())
+			free(_data);
+		_data = newData;
+		_capacity = newCap;
+	}
+
+	UI_FORCEINLINE void Reserve(size_t newSize)
+	{
+		if (newSize > _capacity)
+			_Realloc(newSize);
+	}
+	UI_FORCEINLINE void ReserveForAppend(size_t newSize)
+	{
+		if (newSize > _capacity)
+			_Realloc(newSize + _capacity);
+	}
+	void Resize(size_t newSize)
+	{
+		Reserve(newSize);
+		while (_size < newSize)
+			new (&_data[_size++]) T();
+		while (_size > newSize)
+			_data[--_size].~T();
+	}
+	void ResizeWith(size_t newSize, const T& v)
+	{
+		Reserve(newSize);
+		while (_size < newSize)
+			new (&_data[_size++]) T(v);
+		while (_size > newSize)
+			_data[--_size].~T();
+	}
+
+	inline void Append(const T& v)
+	{
+		ReserveForAppend(_size + 1);
+		new (&_data[_size++]) T(v);
+	}
+	inline void Append(T&& v)
+	{
+		ReserveForAppend(_size + 1);
+		new (&_data[_size++]) T(Move(v));
+	}
+	void AppendMany(const T* p, size_t n)
+	{
+		size_t newSize = _size + n;
+		ReserveForAppend(newSize);
+		UI_IF_MAYBE_CONSTEXPR(std::is_trivially_copy_constructible<T>::value)
+		{
+			memcpy(&_data[_size], p, sizeof(T) * n);
+		}
+		else
+		{
+			for (size_t i = 0; i < n; i++)
+				new (&_data[_size + i]) T(p[i]);
+		}
+		_size = newSize;
+	}
+	template <class R>
+	UI_FORCEINLINE void AppendRange(const R& r)
+	{
+		AppendMany(r.begin(), r.end() - r.begin());
+	}
+
+	inline void RemoveLast()
+	{
+		assert(_size);
+		_data[--_size].~T();
+	}
+
+	// complex modification
+	inline void _HardMove(size_t to, size_t from)
+	{
+		new (&_data[to]) T(Move(_data[from]));
+		_data[from].~T();
+	}
+	inline bool UnorderedRemoveAt(size_t at)
+	{
+		assert(at < _size);
+		_data[at].~T();
+		--_size;
+		if (at < _size)
+			_HardMove(at, _size);
+		return at < _size;
+	}
+	void RemoveAt(size_t at, size_t n = 1)
+	{
+		assert(at < _size);
+		assert(at + n <= _size);
+
+		for (size_t i = 0; i < n; i++)
+			_data[at + i].~T();
+
+		_size -= n;
+		for (size_t p = at; p < _size; p++)
+			_HardMove(p, p + n);
+	}
+	void InsertAt(size_t at, const T& v)
+	{
+		assert(at <= _size);
+		T tmp(v); // v may point into the array
+		ReserveForAppend(_size + 1);
+		for (size_t p = _size; p > at; )
+		{
+			p--;
+			_HardMove(p + 1, p);
+		}
+		new (&_data[at]) T(Move(tmp));
+		_size++;
+	}
+
+	// combined shorthands
+	bool RemoveFirstOf(const T& v)
+	{
+		size_t i = IndexOf(v);
+		if (i != SIZE_MAX)
+			RemoveAt(i);
+		return i != SIZE_MAX;
+	}
+	bool UnorderedRemoveFirstOf(const T& v)
+	{
+		size_t i = IndexOf(v);
+		if (i != SIZE_MAX)
+			UnorderedRemoveAt(i);
+		return i != SIZE_MAX;
+	}
+};
+
+} // ui
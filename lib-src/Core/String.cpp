@@ -1,9 +1,19 @@
 
 #include "String.h"
 
+#include "Array.h"
+
 #define STB_SPRINTF_IMPLEMENTATION
 #include "../../ThirdParty/stb_sprintf.h"
 
+#include "SystemInfo.h"
+
+#if UI_ARCH_X86
+#  include <immintrin.h>
+#elif UI_ARCH_ARM64
+#  include <arm_neon.h>
+#endif
+
 
 namespace ui {
 
@@ -339,17 +349,14 @@ std::string FormatVA(const char* fmt, va_list args)
 }
 
 
-uint32_t UTF8Iterator::Read()
+static UI_FORCEINLINE uint32_t UTF8DecodeOne(const char* str, size_t size, size_t& pos, uint32_t errorReturnValue)
 {
-	if (pos >= str.size())
-		return END;
-
 	// ASCII
 	char c0 = str[pos++];
 	if (!(c0 & 0x80))
 		return c0;
 
-	if (pos >= str.size())
+	if (pos >= size)
 		return errorReturnValue;
 	char c1 = str[pos++];
 	if ((c1 & 0xC0) != 0x80)
@@ -358,7 +365,7 @@ uint32_t UTF8Iterator::Read()
 	if ((c0 & 0xE0) == 0xC0)
 		return ((c0 & 0x1F) << 6) | (c1 & 0x3F);
 
-	if (pos >= str.size())
+	if (pos >= size)
 		return errorReturnValue;
 	char c2 = str[pos++];
 	if ((c2 & 0xC0) != 0x80)
@@ -367,7 +374,7 @@ uint32_t UTF8Iterator::Read()
 	if ((c0 & 0xF0) == 0xE0)
 		return ((c0 & 0xF) << 12) | ((c1 & 0x3F) << 6) | (c2 & 0x3F);
 
-	if (pos >= str.size())
+	if (pos >= size)
 		return errorReturnValue;
 	char c3 = str[pos++];
 	if ((c3 & 0xC0) != 0x80)
@@ -379,4 +386,199 @@ uint32_t UTF8Iterator::Read()
 	return errorReturnValue;
 }
 
+uint32_t UTF8Iterator::Read()
+{
+	if (pos >= str.size())
+		return END;
+
+	return UTF8DecodeOne(str.data(), str.size(), pos, errorReturnValue);
+}
+
+// converts the longest run of ASCII characters at the start of `s` that fits in whole blocks of the vector size
+// returns the number of converted characters (0 = the rest is handled one by one)
+typedef size_t UTF8DecodeASCIIFunc(const char* s, size_t size, uint32_t* out, size_t maxOut);
+
+static size_t UTF8DecodeASCII_Scalar(const char* s, size_t size, uint32_t* out, size_t maxOut)
+{
+	return 0;
+}
+
+#if UI_ARCH_X86
+static size_t UTF8DecodeASCII_SSE2(const char* s, size_t size, uint32_t* out, size_t maxOut)
+{
+	size_t n = 0;
+	while (size - n >= 16 && maxOut - n >= 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(s + n));
+		if (_mm_movemask_epi8(v))
+			break;
+		__m128i zero = _mm_setzero_si128();
+		__m128i lo = _mm_unpacklo_epi8(v, zero);
+		__m128i hi = _mm_unpackhi_epi8(v, zero);
+		_mm_storeu_si128((__m128i*)(out + n), _mm_unpacklo_epi16(lo, zero));
+		_mm_storeu_si128((__m128i*)(out + n + 4), _mm_unpackhi_epi16(lo, zero));
+		_mm_storeu_si128((__m128i*)(out + n + 8), _mm_unpacklo_epi16(hi, zero));
+		_mm_storeu_si128((__m128i*)(out + n + 12), _mm_unpackhi_epi16(hi, zero));
+		n += 16;
+	}
+	return n;
+}
+
+UI_TARGET_AVX2 static size_t UTF8DecodeASCII_AVX2(const char* s, size_t size, uint32_t* out, size_t maxOut)
+{
+	size_t n = 0;
+	while (size - n >= 32 && maxOut - n >= 32)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i*)(s + n));
+		if (_mm256_movemask_epi8(v))
+			break;
+		__m128i lo = _mm256_castsi256_si128(v);
+		__m128i hi = _mm256_extracti128_si256(v, 1);
+		_mm256_storeu_si256((__m256i*)(out + n), _mm256_cvtepu8_epi32(lo));
+		_mm256_storeu_si256((__m256i*)(out + n + 8), _mm256_cvtepu8_epi32(_mm_srli_si128(lo, 8)));
+		_mm256_storeu_si256((__m256i*)(out + n + 16), _mm256_cvtepu8_epi32(hi));
+		_mm256_storeu_si256((__m256i*)(out + n + 24), _mm256_cvtepu8_epi32(_mm_srli_si128(hi, 8)));
+		n += 32;
+	}
+	return n + UTF8DecodeASCII_SSE2(s + n, size - n, out + n, maxOut - n);
+}
+
+UI_TARGET_AVX512 static size_t UTF8DecodeASCII_AVX512(const char* s, size_t size, uint32_t* out, size_t maxOut)
+{
+	size_t n = 0;
+	while (size - n >= 64 && maxOut - n >= 64)
+	{
+		__m512i v = _mm512_loadu_si512((const void*)(s + n));
+		if (_mm512_movepi8_mask(v))
+			break;
+		_mm512_storeu_si512((void*)(out + n), _mm512_cvtepu8_epi32(_mm512_castsi512_si128(v)));
+		_mm512_storeu_si512((void*)(out + n + 16), _mm512_cvtepu8_epi32(_mm512_extracti32x4_epi32(v, 1)));
+		_mm512_storeu_si512((void*)(out + n + 32), _mm512_cvtepu8_epi32(_mm512_extracti32x4_epi32(v, 2)));
+		_mm512_storeu_si512((void*)(out + n + 48), _mm512_cvtepu8_epi32(_mm512_extracti32x4_epi32(v, 3)));
+		n += 64;
+	}
+	return n + UTF8DecodeASCII_SSE2(s + n, size - n, out + n, maxOut - n);
+}
+#elif UI_ARCH_ARM64
+static size_t UTF8DecodeASCII_NEON(const char* s, size_t size, uint32_t* out, size_t maxOut)
+{
+	size_t n = 0;
+	while (size - n >= 16 && maxOut - n >= 16)
+	{
+		uint8x16_t v = vld1q_u8((const uint8_t*)(s + n));
+		if (vmaxvq_u8(v) & 0x80)
+			break;
+		uint16x8_t lo = vmovl_u8(vget_low_u8(v));
+		uint16x8_t hi = vmovl_high_u8(v);
+		vst1q_u32(out + n, vmovl_u16(vget_low_u16(lo)));
+		vst1q_u32(out + n + 4, vmovl_high_u16(lo));
+		vst1q_u32(out + n + 8, vmovl_u16(vget_low_u16(hi)));
+		vst1q_u32(out + n + 12, vmovl_high_u16(hi));
+		n += 16;
+	}
+	return n;
+}
+#endif
+
+static const CPUDispatchVariant<UTF8DecodeASCIIFunc*> g_utf8DecodeASCIIVariants[] =
+{
+#if UI_ARCH_X86
+	{ "AVX-512", CPUFeature_AVX512, UTF8DecodeASCII_AVX512 },
+	{ "AVX2", CPUFeature_AVX2, UTF8DecodeASCII_AVX2 },
+	{ "SSE2", CPUFeature_SSE2, UTF8DecodeASCII_SSE2 },
+#elif UI_ARCH_ARM64
+	{ "NEON", CPUFeature_NEON, UTF8DecodeASCII_NEON },
+#endif
+	{ "Scalar", 0, UTF8DecodeASCII_Scalar },
+};
+
+static size_t UTF8DecodeImpl(UTF8DecodeASCIIFunc* decodeASCII, StringView str, size_t& pos, uint32_t* out, size_t maxOut, uint32_t errorReturnValue)
+{
+	const char* s = str.data();
+	size_t size = str.size();
+	size_t p = pos;
+	size_t n = 0;
+	while (p < size && n < maxOut)
+	{
+		if (u8(s[p]) < 0x80 && size - p >= 16 && maxOut - n >= 16)
+		{
+			size_t num = decodeASCII(s + p, size - p, out + n, maxOut - n);
+			p += num;
+			n += num;
+			if (p >= size || n >= maxOut)
+				break;
+		}
+
+		out[n++] = UTF8DecodeOne(s, size, p, errorReturnValue);
+	}
+	pos = p;
+	return n;
+}
+
+size_t UTF8Decode(StringView str, size_t& pos, uint32_t* out, size_t maxOut, uint32_t errorReturnValue)
+{
+	static UTF8DecodeASCIIFunc* const decodeASCII = CPUDispatchSelect(g_utf8DecodeASCIIVariants);
+	return UTF8DecodeImpl(decodeASCII, str, pos, out, maxOut, errorReturnValue);
+}
+
+
+#if UI_BUILD_TESTS
+#include "Test.h"
+
+DEFINE_TEST_CATEGORY(UTF8, 55);
+
+static void CheckUTF8Decode(StringView str, size_t chunkSize, UTF8DecodeASCIIFunc* decodeASCII)
+{
+	Array<uint32_t> expected;
+	UTF8Iterator it(str);
+	for (uint32_t c; (c = it.Read()) != UTF8Iterator::END;)
+		expected.Append(c);
+
+	Array<uint32_t> decoded;
+	uint32_t buf[128];
+	size_t pos = 0;
+	while (pos < str.size())
+	{
+		size_t n = UTF8DecodeImpl(decodeASCII, str, pos, buf, chunkSize, UTF8Iterator::REPLACEMENT_CHARACTER);
+		ASSERT_EQUAL(true, n > 0);
+		decoded.AppendMany(buf, n);
+	}
+	ASSERT_EQUAL(true, pos == str.size());
+	ASSERT_EQUAL(true, decoded == expected);
+}
+
+DEFINE_TEST(UTF8, Decode)
+{
+	const char* strs[] =
+	{
+		"",
+		"a",
+		"plain ASCII text that is long enough for several blocks of 16 bytes",
+		"0123456789abcdef0123456789abcdef",
+		"\xc3\xa9t\xc3\xa9, \xe2\x82\xac and \xf0\x9f\x98\x80 between ASCII blocks of sixteen bytes",
+		"\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e",
+		"a long run of ASCII text to cover the widest vector blocks (64 bytes), followed by \xc3\xa9 and more ASCII text after it...",
+		// malformed
+		"\x80\x80 stray continuation bytes",
+		"truncated at the end \xe2\x82",
+		"invalid continuation \xc3( and \xf0\x9f\x98(",
+		"\xff\xfe invalid lead bytes in the middle of a long ASCII run",
+	};
+	// every implementation supported by this CPU
+	for (const auto& v : g_utf8DecodeASCIIVariants)
+	{
+		if ((GetCPUFeatures() & v.requiredFeatures) != v.requiredFeatures)
+		{
+			printf("- skipping %s (not supported)\n", v.name);
+			continue;
+		}
+		for (const char* str : strs)
+		{
+			for (size_t chunkSize : { 1, 3, 16, 17, 64, 128 })
+				CheckUTF8Decode(str, chunkSize, v.func);
+		}
+	}
+}
+#endif
+
 } // ui
@@ -15,7 +15,7 @@
 namespace std {
 inline size_t HashValue(const std::string& sv)
 {
-	return ui::HashManyBytesFast(sv.data(), sv.size());
+	return ui::HashBytesFull(sv.data(), sv.size());
 }
 } // std
 
@@ -241,7 +241,7 @@ StringViewSplitPair StringView::SplitLast(StringView sub) const
 
 inline size_t HashValue(StringView sv)
 {
-	return HashManyBytesFast(sv._data, sv._size);
+	return HashBytesFull(sv._data, sv._size);
 }
 
 
@@ -339,6 +339,10 @@ struct UTF8Iterator
 	uint32_t Read();
 };
 
+// bulk decoding with the same results as UTF8Iterator::Read, pure ASCII blocks are converted 16 bytes at a time
+// decodes at most maxOut codepoints, starting at pos and advancing it to the end of the last decoded sequence
+size_t UTF8Decode(StringView str, size_t& pos, uint32_t* out, size_t maxOut, uint32_t errorReturnValue = UTF8Iterator::REPLACEMENT_CHARACTER);
+
 
 template <>
 struct HashEqualityComparer<std::string>
@@ -21,11 +21,28 @@ const char* CPUArchitectureToString(CPUArchitecture arch)
 	}
 }
 
+const char* CPUFeatureToString(CPUFeature f)
+{
+	switch (f)
+	{
+	case CPUFeature_SSE2: return "SSE2";
+	case CPUFeature_SSE41: return "SSE4.1";
+	case CPUFeature_AVX: return "AVX";
+	case CPUFeature_AVX2: return "AVX2";
+	case CPUFeature_AVX512F: return "AVX-512F";
+	case CPUFeature_AVX512BW: return "AVX-512BW";
+	case CPUFeature_NEON: return "NEON";
+	default: return "Unknown";
+	}
+}
+
 void CPUInfo::Read()
 {
 	memset(vendor, 0, sizeof(vendor));
 	memset(name, 0, sizeof(name));
+	features = 0;
 
+#if UI_ARCH_X86
 	i32 cpuinfo[4];
 
 	__cpuid(cpuinfo, 0);
@@ -33,6 +50,38 @@ void CPUInfo::Read()
 	std::swap(cpuinfo[2], cpuinfo[3]);
 	memcpy(vendor, &cpuinfo[1], 12);
 
+	if (numIDs >= 1)
+	{
+		__cpuid(cpuinfo, 1);
+		u32 ecx = cpuinfo[2];
+		u32 edx = cpuinfo[3];
+		if (edx & (1 << 26))
+			features |= CPUFeature_SSE2;
+		if (ecx & (1 << 19))
+			features |= CPUFeature_SSE41;
+
+		// the OS also needs to save the extended registers on context switches
+		u64 xcr0 = 0;
+		if (ecx & (1 << 27)) // OSXSAVE
+			xcr0 = _xgetbv(0);
+		bool osYMM = (xcr0 & 0x6) == 0x6;
+		bool osZMM = (xcr0 & 0xe6) == 0xe6;
+		if (osYMM && (ecx & (1 << 28)))
+			features |= CPUFeature_AVX;
+
+		if (numIDs >= 7)
+		{
+			__cpuidex(cpuinfo, 7, 0);
+			u32 ebx = cpuinfo[1];
+			if (osYMM && (ebx & (1 << 5)))
+				features |= CPUFeature_AVX2;
+			if (osZMM && (ebx & (1 << 16)))
+				features |= CPUFeature_AVX512F;
+			if (osZMM && (ebx & (1 << 30)))
+				features |= CPUFeature_AVX512BW;
+		}
+	}
+
 	__cpuid(cpuinfo, 0x80000000);
 	u32 numExtIDs = cpuinfo[0];
 	if (numExtIDs >= 0x80000004)
@@ -44,6 +93,21 @@ void CPUInfo::Read()
 		__cpuid(cpuinfo, 0x80000004);
 		memcpy(name + 32, cpuinfo, sizeof(cpuinfo));
 	}
+#elif UI_ARCH_ARM64
+	// always available on ARM64
+	features |= CPUFeature_NEON;
+#endif
+}
+
+u32 GetCPUFeatures()
+{
+	static const u32 features = []()
+	{
+		CPUInfo ci;
+		ci.Read();
+		return ci.features;
+	}();
+	return features;
 }
 
 static CPUArchitecture FromW32Arch(WORD arch)
@@ -16,14 +16,55 @@ enum class CPUArchitecture : u8
 };
 const char* CPUArchitectureToString(CPUArchitecture arch);
 
+enum CPUFeature : u32
+{
+	CPUFeature_SSE2 = 1 << 0,
+	CPUFeature_SSE41 = 1 << 1,
+	CPUFeature_AVX = 1 << 2,
+	CPUFeature_AVX2 = 1 << 3,
+	CPUFeature_AVX512F = 1 << 4,
+	CPUFeature_AVX512BW = 1 << 5,
+	CPUFeature_NEON = 1 << 6,
+
+	CPUFeature_AVX512 = CPUFeature_AVX512F | CPUFeature_AVX512BW,
+};
+const char* CPUFeatureToString(CPUFeature f);
+
 struct CPUInfo
 {
 	char vendor[13];
 	char name[49];
+	u32 features; // CPUFeature flags (only the ones also supported by the OS)
 
 	void Read();
+	bool HasFeatures(u32 f) const { return (features & f) == f; }
+};
+
+// the features of the CPU the app is running on (detected on first use)
+u32 GetCPUFeatures();
+
+// one implementation of a kernel that needs some CPU features
+template <class F>
+struct CPUDispatchVariant
+{
+	const char* name;
+	u32 requiredFeatures;
+	F func;
 };
 
+// picks the first variant supported by the CPU
+// - variants are expected to be ordered from best to worst, with the last one having no requirements
+// - the result is meant to be stored, e.g. `static F f = CPUDispatchSelect(variants);`
+template <class F, size_t N>
+F CPUDispatchSelect(const CPUDispatchVariant<F> (&variants)[N])
+{
+	u32 features = GetCPUFeatures();
+	for (const auto& v : variants)
+		if ((v.requiredFeatures & features) == v.requiredFeatures)
+			return v.func;
+	return variants[N - 1].func;
+}
+
 struct SystemInfo
 {
 	CPUArchitecture osArch;
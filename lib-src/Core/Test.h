@@ -54,14 +54,18 @@ struct TestStorage
 		return inst;
 	}
 
-	void Run()
+	// runFunc = optional wrapper (must call T.test->RunTest())
+	void Run(void (*runFunc)(Test& T) = nullptr)
 	{
 		for (size_t i = 0; i < numTests; i++)
 		{
 			Test& T = tests[i];
 			printf("=== %s ===\n", T.catdotname);
 			double t0 = hqtime();
-			T.test->RunTest();
+			if (runFunc)
+				runFunc(T);
+			else
+				T.test->RunTest();
 			double t1 = hqtime();
 			printf("--- %s --- (completed in %.2f ms)\n", T.catdotname, (t1 - t0) * 1000);
 		}
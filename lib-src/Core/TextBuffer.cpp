@@ -0,0 +1,356 @@
+
+#include "TextBuffer.h"
+
+
+namespace ui {
+
+void TextBuffer::Assign(StringView s)
+{
+	_original.assign(s.data(), s.size());
+	_added.clear();
+	_pieces.Clear();
+	if (s.NotEmpty())
+		_pieces.Append({ false, 0, s.size() });
+	_size = s.size();
+	_UpdatePieceStarts(0);
+	_lastPiece = 0;
+
+	_lineStarts.Clear();
+	_lineStarts.Append(0);
+	for (size_t i = 0; i < s.size(); i++)
+		if (s[i] == '\n')
+			_lineStarts.Append(i + 1);
+
+	_flatValid = false;
+}
+
+char TextBuffer::At(size_t pos) const
+{
+	assert(pos < _size);
+	size_t pi = _FindPiece(pos);
+	return _PieceData(_pieces[pi])[pos - _pieceStarts[pi]];
+}
+
+uint32_t TextBuffer::ReadChar(size_t pos) const
+{
+	char bytes[4];
+	size_t n = min(_size - pos, size_t(4));
+	for (size_t i = 0; i < n; i++)
+		bytes[i] = At(pos + i);
+	UTF8Iterator it(StringView(bytes, n));
+	return it.Read();
+}
+
+size_t TextBuffer::PrevCharPos(size_t pos) const
+{
+	if (pos == 0)
+		return 0;
+	pos--;
+	while (pos > 0 && (At(pos) & 0xC0) == 0x80)
+		pos--;
+	return pos;
+}
+
+size_t TextBuffer::NextCharPos(size_t pos) const
+{
+	if (pos == _size)
+		return pos;
+	pos++;
+	while (pos < _size && (At(pos) & 0xC0) == 0x80)
+		pos++;
+	return pos;
+}
+
+void TextBuffer::Insert(size_t pos, StringView s)
+{
+	assert(pos <= _size);
+	if (s.IsEmpty())
+		return;
+
+	if (_pieces.Size() >= MAX_PIECES)
+		Assign(GetString());
+
+	// line index
+	size_t line = FindLine(pos);
+	for (size_t i = line + 1; i < _lineStarts.Size(); i++)
+		_lineStarts[i] += s.size();
+	Array<size_t> newLineStarts;
+	for (size_t i = 0; i < s.size(); i++)
+		if (s[i] == '\n')
+			newLineStarts.Append(pos + i + 1);
+	if (newLineStarts.NotEmpty())
+		_lineStarts.InsertManyAt(line + 1, newLineStarts.Data(), newLineStarts.Size());
+
+	// pieces
+	size_t pi = _SplitAt(pos);
+	if (pi > 0 &&
+		_pieces[pi - 1].added &&
+		_pieces[pi - 1].start + _pieces[pi - 1].size == _added.size())
+	{
+		// continuing the last insertion
+		_pieces[pi - 1].size += s.size();
+	}
+	else
+	{
+		_pieces.InsertAt(pi, { true, _added.size(), s.size() });
+		_pieceStarts.InsertAt(pi, pos);
+		pi++;
+	}
+	_added.append(s.data(), s.size());
+	_size += s.size();
+	for (size_t i = pi; i < _pieceStarts.Size(); i++)
+		_pieceStarts[i] += s.size();
+
+	_flatValid = false;
+}
+
+void TextBuffer::Erase(size_t pos, size_t n)
+{
+	assert(pos <= _size && n <= _size - pos);
+	if (n == 0)
+		return;
+
+	// line index
+	size_t line = FindLine(pos);
+	size_t lastLine = FindLine(pos + n);
+	if (lastLine > line)
+		_lineStarts.RemoveAt(line + 1, lastLine - line);
+	for (size_t i = line + 1; i < _lineStarts.Size(); i++)
+		_lineStarts[i] -= n;
+
+	// pieces
+	size_t pfrom = _SplitAt(pos);
+	size_t pto = _SplitAt(pos + n);
+	if (pto > pfrom)
+	{
+		_pieces.RemoveAt(pfrom, pto - pfrom);
+		_pieceStarts.RemoveAt(pfrom, pto - pfrom);
+	}
+	_size -= n;
+	for (size_t i = pfrom; i < _pieceStarts.Size(); i++)
+		_pieceStarts[i] -= n;
+
+	_flatValid = false;
+}
+
+StringView TextBuffer::GetRange(size_t pos, size_t n, std::string& tmp) const
+{
+	assert(pos <= _size && n <= _size - pos);
+	if (n == 0)
+		return {};
+
+	size_t pi = _FindPiece(pos);
+	size_t off = pos - _pieceStarts[pi];
+	if (off + n <= _pieces[pi].size)
+		return StringView(_PieceData(_pieces[pi]) + off, n);
+
+	tmp.clear();
+	tmp.reserve(n);
+	while (n)
+	{
+		const Piece& p = _pieces[pi++];
+		size_t num = min(p.size - off, n);
+		tmp.append(_PieceData(p) + off, num);
+		n -= num;
+		off = 0;
+	}
+	return tmp;
+}
+
+const std::string& TextBuffer::GetString() const
+{
+	if (!_flatValid)
+	{
+		_flat.clear();
+		_flat.reserve(_size);
+		for (const Piece& p : _pieces)
+			_flat.append(_PieceData(p), p.size);
+		_flatValid = true;
+	}
+	return _flat;
+}
+
+bool TextBuffer::Equals(StringView s) const
+{
+	if (s.size() != _size)
+		return false;
+	size_t pos = 0;
+	for (const Piece& p : _pieces)
+	{
+		if (memcmp(_PieceData(p), s.data() + pos, p.size) != 0)
+			return false;
+		pos += p.size;
+	}
+	return true;
+}
+
+size_t TextBuffer::FindLine(size_t pos) const
+{
+	// last line that starts at or before pos
+	size_t lo = 0, hi = _lineStarts.Size();
+	while (hi - lo > 1)
+	{
+		size_t mid = (lo + hi) / 2;
+		if (_lineStarts[mid] <= pos)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+size_t TextBuffer::_FindPiece(size_t pos) const
+{
+	// sequential access usually stays within the same piece
+	if (_lastPiece < _pieces.Size() &&
+		_pieceStarts[_lastPiece] <= pos &&
+		pos < _pieceStarts[_lastPiece] + _pieces[_lastPiece].size)
+		return _lastPiece;
+
+	size_t lo = 0, hi = _pieces.Size();
+	while (hi - lo > 1)
+	{
+		size_t mid = (lo + hi) / 2;
+		if (_pieceStarts[mid] <= pos)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	_lastPiece = lo;
+	return lo;
+}
+
+size_t TextBuffer::_SplitAt(size_t pos)
+{
+	if (pos == _size)
+		return _pieces.Size();
+
+	size_t pi = _FindPiece(pos);
+	size_t off = pos - _pieceStarts[pi];
+	if (off == 0)
+		return pi;
+
+	Piece p = _pieces[pi];
+	_pieces[pi].size = off;
+	_pieces.InsertAt(pi + 1, { p.added, p.start + off, p.size - off });
+	_pieceStarts.InsertAt(pi + 1, pos);
+	return pi + 1;
+}
+
+void TextBuffer::_UpdatePieceStarts(size_t from)
+{
+	_pieceStarts.Resize(_pieces.Size());
+	size_t pos = from ? _pieceStarts[from - 1] + _pieces[from - 1].size : 0;
+	for (size_t i = from; i < _pieces.Size(); i++)
+	{
+		_pieceStarts[i] = pos;
+		pos += _pieces[i].size;
+	}
+}
+
+
+#if UI_BUILD_TESTS
+#include "Test.h"
+
+DEFINE_TEST_CATEGORY(TextBuffer, 60);
+
+static void CheckTextBuffer(const TextBuffer& tb, StringView ref)
+{
+	ASSERT_EQUAL(true, tb.Size() == ref.size());
+	ASSERT_EQUAL(true, StringView(tb.GetString()) == ref);
+	ASSERT_EQUAL(true, tb.Equals(ref));
+	if (ref.NotEmpty())
+	{
+		std::string other(ref.data(), ref.size());
+		other.back() ^= 1;
+		ASSERT_EQUAL(true, !tb.Equals(other));
+		ASSERT_EQUAL(true, !tb.Equals(ref.substr(0, ref.size() - 1)));
+	}
+
+	ASSERT_EQUAL(true, tb._pieceStarts.Size() == tb._pieces.Size());
+	size_t pieceStart = 0;
+	for (size_t i = 0; i < tb._pieces.Size(); i++)
+	{
+		ASSERT_EQUAL(true, tb._pieceStarts[i] == pieceStart);
+		pieceStart += tb._pieces[i].size;
+	}
+
+	std::string tmp;
+	for (size_t i = 0; i < ref.size(); i++)
+		ASSERT_EQUAL(true, tb.At(i) == ref[i]);
+	for (size_t i = 0; i <= ref.size(); i += 3)
+		ASSERT_EQUAL(true, tb.GetRange(i, min(ref.size() - i, size_t(5)), tmp) == ref.substr(i, 5));
+
+	size_t numLines = 1;
+	for (char c : ref)
+		if (c == '\n')
+			numLines++;
+	ASSERT_EQUAL(true, tb.GetLineCount() == numLines);
+
+	size_t line = 0;
+	for (size_t i = 0; i <= ref.size(); i++)
+	{
+		ASSERT_EQUAL(true, tb.FindLine(i) == line);
+		if (i < ref.size() && ref[i] == '\n')
+		{
+			ASSERT_EQUAL(true, tb.GetLineEnd(line) == i);
+			line++;
+			ASSERT_EQUAL(true, tb.GetLineStart(line) == i + 1);
+		}
+	}
+}
+
+DEFINE_TEST(TextBuffer, Basic)
+{
+	TextBuffer tb;
+	CheckTextBuffer(tb, "");
+
+	tb.Assign("abc\ndef");
+	CheckTextBuffer(tb, "abc\ndef");
+
+	tb.Insert(7, "\nghi");
+	CheckTextBuffer(tb, "abc\ndef\nghi");
+
+	tb.Insert(2, "12\n34");
+	CheckTextBuffer(tb, "ab12\n34c\ndef\nghi");
+
+	tb.Erase(3, 6);
+	CheckTextBuffer(tb, "ab1def\nghi");
+
+	tb.Insert(0, "\n");
+	CheckTextBuffer(tb, "\nab1def\nghi");
+
+	tb.Erase(0, tb.Size());
+	CheckTextBuffer(tb, "");
+}
+
+DEFINE_TEST(TextBuffer, Random)
+{
+	TextBuffer tb;
+	std::string ref;
+	static const char* frags[] = { "a", "\n", "xyz", "12\n", "\n\n", "long fragment text" };
+	unsigned seed = 1234;
+	for (int i = 0; i < 2000; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		size_t pos = ref.empty() ? 0 : (seed >> 8) % (ref.size() + 1);
+		if ((seed >> 4) % 3 == 0 && !ref.empty())
+		{
+			size_t n = min(ref.size() - pos, size_t((seed >> 16) % 8));
+			tb.Erase(pos, n);
+			ref.erase(pos, n);
+		}
+		else
+		{
+			StringView frag = frags[(seed >> 16) % 6];
+			tb.Insert(pos, frag);
+			ref.insert(pos, frag.data(), frag.size());
+		}
+		if (i % 20 == 0)
+			CheckTextBuffer(tb, ref);
+	}
+	CheckTextBuffer(tb, ref);
+}
+#endif
+
+} // ui
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Array.h"
+#include "String.h"
+
+
+namespace ui {
+
+// piece table text storage with an incrementally maintained line index
+// - positions are in bytes, lines are separated by '\n' (not included in the line range)
+// - the original text is never modified, inserted text is appended to a separate buffer
+struct TextBuffer
+{
+	struct Piece
+	{
+		bool added;
+		size_t start;
+		size_t size;
+	};
+
+	// pieces are merged into a new original buffer when there are too many of them
+	static constexpr size_t MAX_PIECES = 4096;
+
+	std::string _original;
+	std::string _added;
+	Array<Piece> _pieces;
+	Array<size_t> _pieceStarts;
+	Array<size_t> _lineStarts;
+	size_t _size = 0;
+
+	mutable std::string _flat;
+	mutable bool _flatValid = true;
+	mutable size_t _lastPiece = 0;
+
+	TextBuffer() { _lineStarts.Append(0); }
+
+	void Assign(StringView s);
+	void Clear() { Assign({}); }
+
+	UI_FORCEINLINE size_t Size() const { return _size; }
+	UI_FORCEINLINE bool IsEmpty() const { return _size == 0; }
+
+	char At(size_t pos) const;
+	// decodes the UTF-8 character starting at pos
+	uint32_t ReadChar(size_t pos) const;
+	size_t PrevCharPos(size_t pos) const;
+	size_t NextCharPos(size_t pos) const;
+
+	void Insert(size_t pos, StringView s);
+	void Erase(size_t pos, size_t n);
+
+	// returns a view into the storage if the range is contiguous, otherwise copies it into tmp
+	StringView GetRange(size_t pos, size_t n, std::string& tmp) const;
+	// the returned string is valid until the next modification
+	const std::string& GetString() const;
+	// compares the pieces directly, without joining them
+	bool Equals(StringView s) const;
+
+	UI_FORCEINLINE size_t GetLineCount() const { return _lineStarts.Size(); }
+	UI_FORCEINLINE size_t GetLineStart(size_t line) const { return _lineStarts[line]; }
+	UI_FORCEINLINE size_t GetLineEnd(size_t line) const { return line + 1 < _lineStarts.Size() ? _lineStarts[line + 1] - 1 : _size; }
+	size_t FindLine(size_t pos) const;
+
+	UI_FORCEINLINE const char* _PieceData(const Piece& p) const { return (p.added ? _added.data() : _original.data()) + p.start; }
+	size_t _FindPiece(size_t pos) const;
+	size_t _SplitAt(size_t pos);
+	void _UpdatePieceStarts(size_t from);
+};
+
+} // ui
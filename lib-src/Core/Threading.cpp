@@ -1,12 +1,24 @@
 
 #include <queue>
+#include <deque>
+#include <functional>
 #include <mutex>
+#include <shared_mutex>
 #include <thread>
 #include <atomic>
+#include <condition_variable>
 #include <assert.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <typeinfo>
 
 #include "Threading.h"
 
+#include "Array.h"
+#include "Profiler.h"
+#include "SystemInfo.h"
+#include "WeakPtr.h"
+
 
 namespace ui {
 
@@ -57,11 +69,210 @@ AtomicInt32& AtomicInt32::operator -- ()
 	return *this;
 }
 
+int32_t AtomicInt32::Increment()
+{
+	return ++(*reinterpret_cast<std::atomic<int32_t>*>(&_mem));
+}
+
+int32_t AtomicInt32::Decrement()
+{
+	return --(*reinterpret_cast<std::atomic<int32_t>*>(&_mem));
+}
+
+
+static_assert(sizeof(std::shared_mutex) <= sizeof(void*[8]), "shared mutex does not fit");
+
+RWMutex::RWMutex()
+{
+	new (_mem) std::shared_mutex;
+}
+
+RWMutex::~RWMutex()
+{
+	reinterpret_cast<std::shared_mutex*>(_mem)->~shared_mutex();
+}
+
+void RWMutex::Lock()
+{
+	reinterpret_cast<std::shared_mutex*>(_mem)->lock();
+}
+
+void RWMutex::Unlock()
+{
+	reinterpret_cast<std::shared_mutex*>(_mem)->unlock();
+}
+
+void RWMutex::LockShared()
+{
+	reinterpret_cast<std::shared_mutex*>(_mem)->lock_shared();
+}
 
+void RWMutex::UnlockShared()
+{
+	reinterpret_cast<std::shared_mutex*>(_mem)->unlock_shared();
+}
+
+
+struct EventQueueNode
+{
+	std::atomic<EventQueueNode*> next;
+	bool clear;
+	alignas(EventQueue::ENTRY_INLINE_ALIGN) char storage[EventQueue::ENTRY_INLINE_SIZE];
+
+	EventQueue::Entry* GetEntry() { return reinterpret_cast<EventQueue::Entry*>(storage); }
+	static EventQueueNode* FromEntry(EventQueue::Entry* e)
+	{
+		return reinterpret_cast<EventQueueNode*>(reinterpret_cast<char*>(e) - offsetof(EventQueueNode, storage));
+	}
+};
+
+// free nodes are shared by all queues
+// - consumers return them in batches, producers take the whole list into their own thread's cache
+//   (only ever taking all nodes at once avoids the ABA problem of popping single nodes)
+static std::atomic<EventQueueNode*> g_freeEventQueueNodes;
+
+static void ReturnEventQueueNodes(EventQueueNode* first, EventQueueNode* last)
+{
+	EventQueueNode* head = g_freeEventQueueNodes.load(std::memory_order_relaxed);
+	do
+		last->next.store(head, std::memory_order_relaxed);
+	while (!g_freeEventQueueNodes.compare_exchange_weak(head, first, std::memory_order_release, std::memory_order_relaxed));
+}
+
+struct EventQueueNodeCache
+{
+	EventQueueNode* first = nullptr;
+
+	~EventQueueNodeCache()
+	{
+		if (!first)
+			return;
+		EventQueueNode* last = first;
+		while (EventQueueNode* next = last->next.load(std::memory_order_relaxed))
+			last = next;
+		ReturnEventQueueNodes(first, last);
+	}
+
+	EventQueueNode* Alloc()
+	{
+		if (!first)
+			first = g_freeEventQueueNodes.exchange(nullptr, std::memory_order_acquire);
+		if (!first)
+			return new EventQueueNode;
+		EventQueueNode* n = first;
+		first = n->next.load(std::memory_order_relaxed);
+		return n;
+	}
+};
+static thread_local EventQueueNodeCache g_eventQueueNodeCache;
+
+// intrusive MPSC queue (Dmitry Vyukov's algorithm) + a list of entries already taken by the consumer
 struct EventQueueImpl
 {
-	std::queue<EventQueue::Entry*> q;
-	std::mutex m;
+	std::atomic<EventQueueNode*> head;
+	EventQueueNode* tail;
+	EventQueueNode stub;
+
+	EventQueueNode* localFirst = nullptr;
+	EventQueueNode* localLast = nullptr;
+
+	std::atomic<u32> numClearsPushed{ 0 };
+	u32 numClearsSeen = 0;
+
+	EventQueueImpl()
+	{
+		stub.next.store(nullptr, std::memory_order_relaxed);
+		head.store(&stub, std::memory_order_relaxed);
+		tail = &stub;
+	}
+
+	void PushNode(EventQueueNode* n)
+	{
+		n->next.store(nullptr, std::memory_order_relaxed);
+		EventQueueNode* prev = head.exchange(n, std::memory_order_acq_rel);
+		prev->next.store(n, std::memory_order_release);
+	}
+
+	EventQueueNode* PopNode()
+	{
+		EventQueueNode* t = tail;
+		EventQueueNode* next = t->next.load(std::memory_order_acquire);
+		if (t == &stub)
+		{
+			if (!next)
+				return nullptr;
+			tail = next;
+			t = next;
+			next = next->next.load(std::memory_order_acquire);
+		}
+		if (next)
+		{
+			tail = next;
+			return t;
+		}
+		// the last node may still be getting linked by a producer
+		if (t != head.load(std::memory_order_acquire))
+			return nullptr;
+		PushNode(&stub);
+		next = t->next.load(std::memory_order_acquire);
+		if (next)
+		{
+			tail = next;
+			return t;
+		}
+		return nullptr;
+	}
+
+	static void FreeNodes(EventQueueNode* first, EventQueueNode* last)
+	{
+		for (EventQueueNode* n = first; ; n = n->next.load(std::memory_order_relaxed))
+		{
+			n->GetEntry()->~Entry();
+			if (n == last)
+				break;
+		}
+		ReturnEventQueueNodes(first, last);
+	}
+
+	// moves the entries from the shared queue to the local list, applying the clear requests
+	void Fetch()
+	{
+		while (EventQueueNode* n = PopNode())
+		{
+			n->next.store(nullptr, std::memory_order_relaxed);
+			if (n->clear)
+			{
+				numClearsSeen++;
+				if (localFirst)
+				{
+					FreeNodes(localFirst, localLast);
+					localFirst = localLast = nullptr;
+				}
+			}
+			if (localLast)
+				localLast->next.store(n, std::memory_order_relaxed);
+			else
+				localFirst = n;
+			localLast = n;
+		}
+	}
+	// entries can be run straight from the shared queue unless a clear request needs to look ahead
+	void FetchIfClearing()
+	{
+		if (numClearsPushed.load(std::memory_order_acquire) != numClearsSeen)
+			Fetch();
+	}
+	EventQueueNode* PopLocal()
+	{
+		EventQueueNode* n = localFirst;
+		if (n)
+		{
+			localFirst = n->next.load(std::memory_order_relaxed);
+			if (!localFirst)
+				localLast = nullptr;
+		}
+		return n;
+	}
 };
 
 EventQueue::EventQueue()
@@ -71,73 +282,553 @@ EventQueue::EventQueue()
 
 EventQueue::~EventQueue()
 {
+	Clear();
 	delete _impl;
 }
 
+void* EventQueue::_AllocEntry()
+{
+	return g_eventQueueNodeCache.Alloc()->storage;
+}
+
 void EventQueue::_AddToQueue(Entry* e, bool clear)
 {
-	std::lock_guard<std::mutex> g(_impl->m);
+	EventQueueNode* n = EventQueueNode::FromEntry(e);
+	n->clear = clear;
 	if (clear)
-	{
-		while (!_impl->q.empty())
-		{
-			delete _impl->q.front();
-			_impl->q.pop();
-		}
-	}
-	_impl->q.push(e);
+		_impl->numClearsPushed++;
+	_impl->PushNode(n);
 }
 
 void EventQueue::Clear()
 {
-	std::lock_guard<std::mutex> g(_impl->m);
-	while (!_impl->q.empty())
+	_impl->Fetch();
+	if (_impl->localFirst)
 	{
-		delete _impl->q.front();
-		_impl->q.pop();
+		EventQueueImpl::FreeNodes(_impl->localFirst, _impl->localLast);
+		_impl->localFirst = _impl->localLast = nullptr;
 	}
 }
 
 bool EventQueue::RunOne()
 {
-	Entry* e = nullptr;
+	_impl->FetchIfClearing();
+	EventQueueNode* n = _impl->PopLocal();
+	if (!n)
 	{
-		std::lock_guard<std::mutex> g(_impl->m);
-		if (_impl->q.empty())
+		n = _impl->PopNode();
+		if (!n)
 			return false;
-		e = _impl->q.front();
-		_impl->q.pop();
+		if (n->clear)
+			_impl->numClearsSeen++;
 	}
-	e->Run();
-	delete e;
+
+	n->GetEntry()->Run();
+	EventQueueImpl::FreeNodes(n, n);
 	return true;
 }
 
 void EventQueue::RunAllCurrent()
 {
-	_impl->m.lock();
-	if (_impl->q.empty())
+	_impl->FetchIfClearing();
+	// the last entry that is considered current
+	// (if it's the stub, everything pushed before the call has already been taken)
+	EventQueueNode* end = _impl->head.load(std::memory_order_acquire);
+
+	EventQueueNode* first = nullptr;
+	EventQueueNode* last = nullptr;
+	auto runAndDestroy = [&first, &last](EventQueueNode* n)
+	{
+		Entry* e = n->GetEntry();
+		e->Run();
+		e->~Entry();
+		if (last)
+			last->next.store(n, std::memory_order_relaxed);
+		else
+			first = n;
+		last = n;
+	};
+
+	// entries pushed while running these are left for the next call
+	while (EventQueueNode* n = _impl->PopLocal())
+		runAndDestroy(n);
+	if (end != &_impl->stub)
+	{
+		while (EventQueueNode* n = _impl->PopNode())
+		{
+			if (n->clear)
+				_impl->numClearsSeen++;
+			runAndDestroy(n);
+			if (n == end)
+				break;
+		}
+	}
+
+	if (first)
+		ReturnEventQueueNodes(first, last);
+}
+
+
+enum JobStatus
+{
+	JobStatus_Queued,
+	JobStatus_Running,
+	JobStatus_Done,
+	JobStatus_Cancelled,
+};
+
+struct JobState
+{
+	std::atomic<int32_t> refCount{ 1 };
+	std::atomic<int32_t> status{ JobStatus_Queued };
+	std::atomic<bool> cancelRequested{ false };
+	LivenessToken liveness;
+	ThreadPoolImpl* pool; // holds a reference so that handles can wait after the pool is destroyed
+	ThreadPool::Job* job;
+
+	void AddRef() { refCount++; }
+	void Release();
+	bool IsFinished() const
+	{
+		int32_t s = status.load();
+		return s == JobStatus_Done || s == JobStatus_Cancelled;
+	}
+	bool IsCancelled() const
+	{
+		return cancelRequested.load(std::memory_order_relaxed) || (liveness._data && !liveness.IsAlive());
+	}
+};
+
+struct JobQueues
+{
+	std::mutex mutex;
+	std::deque<JobState*> queues[NUM_JOB_PRIORITIES];
+};
+
+struct ThreadPoolImpl
+{
+	// one for the ThreadPool, one for each JobState
+	std::atomic<int32_t> refCount{ 1 };
+
+	Array<std::thread> threads;
+	// [0] = shared queue, [1 + i] = queues of worker i
+	Array<JobQueues*> queues;
+
+	std::atomic<size_t> numQueued{ 0 };
+	std::atomic<size_t> numRunning{ 0 };
+	std::atomic<bool> quit{ false };
+
+	std::mutex sleepMutex;
+	std::condition_variable sleepCV;
+
+	std::atomic<u32> numWaiters{ 0 };
+	std::mutex doneMutex;
+	std::condition_variable doneCV;
+
+	~ThreadPoolImpl()
+	{
+		for (JobQueues* q : queues)
+			delete q;
+	}
+	void AddRef() { refCount++; }
+	void Release()
+	{
+		if (--refCount == 0)
+			delete this;
+	}
+};
+
+void JobState::Release()
+{
+	if (--refCount == 0)
+	{
+		ThreadPoolImpl* impl = pool;
+		delete job;
+		delete this;
+		impl->Release();
+	}
+}
+
+static thread_local ThreadPoolImpl* g_currentWorkerPool;
+static thread_local size_t g_currentWorkerIndex;
+static thread_local JobState* g_currentJob;
+
+static JobState* ThreadPool_TryPop(ThreadPoolImpl* impl, size_t ownQueue)
+{
+	size_t numQueues = impl->queues.Size();
+	for (int prio = 0; prio < NUM_JOB_PRIORITIES; prio++)
+	{
+		// own queue: newest first (most likely to still be in cache)
+		if (ownQueue)
+		{
+			JobQueues* q = impl->queues[ownQueue];
+			std::lock_guard<std::mutex> g(q->mutex);
+			auto& dq = q->queues[prio];
+			if (!dq.empty())
+			{
+				JobState* js = dq.back();
+				dq.pop_back();
+				return js;
+			}
+		}
+		// the shared queue and other workers: oldest first
+		for (size_t i = 0; i < numQueues; i++)
+		{
+			size_t qi = (ownQueue + i) % numQueues;
+			if (qi == ownQueue && ownQueue)
+				continue;
+			JobQueues* q = impl->queues[qi];
+			std::lock_guard<std::mutex> g(q->mutex);
+			auto& dq = q->queues[prio];
+			if (!dq.empty())
+			{
+				JobState* js = dq.front();
+				dq.pop_front();
+				return js;
+			}
+		}
+	}
+	return nullptr;
+}
+
+static void ThreadPool_NotifyDone(ThreadPoolImpl* impl)
+{
+	if (impl->numWaiters.load())
+	{
+		std::lock_guard<std::mutex> g(impl->doneMutex);
+		impl->doneCV.notify_all();
+	}
+}
+
+static void ThreadPool_Execute(ThreadPoolImpl* impl, JobState* js)
+{
+	// counted as running before it stops being counted as queued so that WaitIdle doesn't miss it
+	impl->numRunning++;
+	impl->numQueued--;
+	int32_t expected = JobStatus_Queued;
+	// the owner is gone, drop the job
+	if (js->liveness._data && !js->liveness.IsAlive())
+		js->status.compare_exchange_strong(expected, JobStatus_Cancelled);
+	if (js->status.compare_exchange_strong(expected, JobStatus_Running))
+	{
+		JobState* prevJob = g_currentJob;
+		g_currentJob = js;
+		{
+			UI_PROFILE_ZONE_DETAIL("Job", typeid(*js->job).name());
+			js->job->Run();
+		}
+		g_currentJob = prevJob;
+		// the function may own resources that should be released before the job is considered done
+		delete js->job;
+		js->job = nullptr;
+		js->status.store(JobStatus_Done);
+	}
+	impl->numRunning--;
+	ThreadPool_NotifyDone(impl);
+	js->Release();
+}
+
+static void ThreadPool_WorkerProc(ThreadPoolImpl* impl, size_t index)
+{
+	g_currentWorkerPool = impl;
+	g_currentWorkerIndex = index;
+	char name[32];
+	snprintf(name, sizeof(name), "Worker %u", unsigned(index));
+	ProfilerSetThreadName(name);
+	while (!impl->quit.load())
+	{
+		if (JobState* js = ThreadPool_TryPop(impl, 1 + index))
+		{
+			ThreadPool_Execute(impl, js);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> ulk(impl->sleepMutex);
+		while (!impl->quit.load() && impl->numQueued.load() == 0)
+			impl->sleepCV.wait(ulk);
+	}
+}
+
+ThreadPool::ThreadPool(u32 numThreads)
+{
+	if (numThreads == 0)
+	{
+		SystemInfo si;
+		si.ReadAll();
+		// leave one core for the UI thread
+		numThreads = si.numAvailLogicalCPUCores > 1 ? si.numAvailLogicalCPUCores - 1 : 1;
+	}
+
+	_impl = new ThreadPoolImpl;
+	for (u32 i = 0; i < numThreads + 1; i++)
+		_impl->queues.Append(new JobQueues);
+	for (u32 i = 0; i < numThreads; i++)
+		_impl->threads.Append(std::thread(ThreadPool_WorkerProc, _impl, size_t(i)));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> g(_impl->sleepMutex);
+		_impl->quit.store(true);
+	}
+	_impl->sleepCV.notify_all();
+
+	for (auto& t : _impl->threads)
+		t.join();
+
+	for (JobQueues* q : _impl->queues)
+	{
+		for (auto& dq : q->queues)
+		{
+			for (JobState* js : dq)
+			{
+				int32_t expected = JobStatus_Queued;
+				js->status.compare_exchange_strong(expected, JobStatus_Cancelled);
+				js->Release();
+			}
+			dq.clear();
+		}
+	}
+	ThreadPool_NotifyDone(_impl);
+	// waiters and handles of unfinished jobs may still be using it
+	_impl->Release();
+}
+
+static ThreadPool* g_globalThreadPool;
+static std::mutex g_globalThreadPoolMutex;
+
+ThreadPool& ThreadPool::Get()
+{
+	std::lock_guard<std::mutex> g(g_globalThreadPoolMutex);
+	if (!g_globalThreadPool)
+		g_globalThreadPool = new ThreadPool;
+	return *g_globalThreadPool;
+}
+
+void ThreadPool::ShutdownGlobal()
+{
+	std::lock_guard<std::mutex> g(g_globalThreadPoolMutex);
+	delete g_globalThreadPool;
+	g_globalThreadPool = nullptr;
+}
+
+u32 ThreadPool::GetNumThreads() const
+{
+	return u32(_impl->threads.Size());
+}
+
+bool ThreadPool::IsCurrentJobCancelled()
+{
+	return g_currentJob && g_currentJob->IsCancelled();
+}
+
+JobHandle ThreadPool::GetCurrentJob()
+{
+	JobHandle h;
+	if (g_currentJob)
+	{
+		g_currentJob->AddRef();
+		h._state = g_currentJob;
+	}
+	return h;
+}
+
+JobHandle ThreadPool::_Submit(Job* job, JobPriority prio, const LivenessToken* liveness)
+{
+	JobState* js = new JobState;
+	js->pool = _impl;
+	_impl->AddRef();
+	js->job = job;
+	if (liveness)
+		js->liveness = *liveness;
+
+	JobHandle h;
+	h._state = js;
+	size_t qi = g_currentWorkerPool == _impl ? 1 + g_currentWorkerIndex : 0;
+	JobQueues* q = _impl->queues[qi];
+	{
+		// the destructor sets quit under the same lock, so nothing can be pushed after it has drained the queues
+		std::lock_guard<std::mutex> g(_impl->sleepMutex);
+		if (_impl->quit.load())
+		{
+			js->status.store(JobStatus_Cancelled);
+			return h;
+		}
+
+		js->AddRef(); // for the queue
+		_impl->numQueued++;
+		std::lock_guard<std::mutex> g2(q->mutex);
+		q->queues[int(prio)].push_back(js);
+	}
+	_impl->sleepCV.notify_one();
+	return h;
+}
+
+bool ThreadPool::RunOne()
+{
+	size_t ownQueue = g_currentWorkerPool == _impl ? 1 + g_currentWorkerIndex : 0;
+	if (JobState* js = ThreadPool_TryPop(_impl, ownQueue))
 	{
-		_impl->m.unlock();
+		ThreadPool_Execute(_impl, js);
+		return true;
+	}
+	return false;
+}
+
+void ThreadPool::WaitIdle()
+{
+	while (RunOne()) {}
+
+	_impl->numWaiters++;
+	{
+		std::unique_lock<std::mutex> ulk(_impl->doneMutex);
+		while (_impl->numQueued.load() || _impl->numRunning.load())
+			_impl->doneCV.wait(ulk);
+	}
+	_impl->numWaiters--;
+}
+
+
+JobHandle::JobHandle(const JobHandle& o) : _state(o._state)
+{
+	if (_state)
+		_state->AddRef();
+}
+
+JobHandle::~JobHandle()
+{
+	if (_state)
+		_state->Release();
+}
+
+JobHandle& JobHandle::operator = (const JobHandle& o)
+{
+	if (o._state)
+		o._state->AddRef();
+	if (_state)
+		_state->Release();
+	_state = o._state;
+	return *this;
+}
+
+JobHandle& JobHandle::operator = (JobHandle&& o)
+{
+	if (this != &o)
+	{
+		if (_state)
+			_state->Release();
+		_state = o._state;
+		o._state = nullptr;
+	}
+	return *this;
+}
+
+bool JobHandle::IsDone() const
+{
+	return !_state || _state->IsFinished();
+}
+
+bool JobHandle::IsCancelled() const
+{
+	return _state && _state->IsCancelled();
+}
+
+bool JobHandle::Cancel()
+{
+	if (!_state)
+		return true;
+	_state->cancelRequested.store(true);
+	int32_t expected = JobStatus_Queued;
+	if (_state->status.compare_exchange_strong(expected, JobStatus_Cancelled))
+		return true;
+	return expected == JobStatus_Cancelled;
+}
+
+void JobHandle::Wait()
+{
+	if (!_state)
 		return;
+	// the pool may be destroyed while waiting, but the job state keeps its data alive
+	while (!_state->IsFinished())
+	{
+		ThreadPoolImpl* impl = _state->pool;
+		size_t ownQueue = g_currentWorkerPool == impl ? 1 + g_currentWorkerIndex : 0;
+		if (JobState* js = ThreadPool_TryPop(impl, ownQueue))
+		{
+			ThreadPool_Execute(impl, js);
+			continue;
+		}
+
+		impl->numWaiters++;
+		{
+			std::unique_lock<std::mutex> ulk(impl->doneMutex);
+			while (!_state->IsFinished() && !impl->numQueued.load())
+				impl->doneCV.wait(ulk);
+		}
+		impl->numWaiters--;
 	}
+}
 
-	auto* end = _impl->q.back();
-	while (!_impl->q.empty())
+struct ParallelForState
+{
+	void (*fn)(void*, size_t, size_t);
+	void* userdata;
+	size_t count;
+	size_t grainSize;
+	size_t numRanges;
+	std::atomic<size_t> nextRange{ 0 };
+};
+
+static void ParallelFor_RunRanges(ParallelForState& s)
+{
+	for (;;)
 	{
-		auto* e = _impl->q.front();
-		_impl->q.pop();
-		_impl->m.unlock();
+		size_t i = s.nextRange.fetch_add(1, std::memory_order_relaxed);
+		if (i >= s.numRanges)
+			break;
+		size_t begin = i * s.grainSize;
+		s.fn(s.userdata, begin, min(begin + s.grainSize, s.count));
+	}
+}
 
-		e->Run();
-		delete e;
+void ThreadPool::_ParallelFor(size_t count, size_t grainSize, void (*fn)(void* userdata, size_t begin, size_t end), void* userdata)
+{
+	if (grainSize == 0)
+		grainSize = 1;
+	size_t numRanges = (count + grainSize - 1) / grainSize;
+	if (numRanges <= 1 || _impl->threads.IsEmpty())
+	{
+		if (count)
+			fn(userdata, 0, count);
+		return;
+	}
 
-		if (e == end)
-			return;
+	ParallelForState s;
+	s.fn = fn;
+	s.userdata = userdata;
+	s.count = count;
+	s.grainSize = grainSize;
+	s.numRanges = numRanges;
 
-		_impl->m.lock();
+	size_t numHelpers = min(numRanges - 1, _impl->threads.Size());
+	Array<JobHandle> helpers;
+	helpers.Reserve(numHelpers);
+	for (size_t i = 0; i < numHelpers; i++)
+		helpers.Append(Run([&s]() { ParallelFor_RunRanges(s); }, JobPriority::High));
+
+	ParallelFor_RunRanges(s);
+
+	// all ranges are taken at this point, only need to wait for the helpers that are still running one
+	// (not using Wait since it can pick up unrelated jobs, which could try to take locks held by the caller)
+	for (auto& h : helpers)
+	{
+		if (!h.Cancel())
+		{
+			while (!h.IsDone())
+				std::this_thread::yield();
+		}
 	}
-	_impl->m.unlock();
 }
 
 
@@ -146,19 +837,19 @@ struct AsyncJobQueueImpl
 	std::queue<AsyncJobQueue::Entry*> q;
 	std::mutex m;
 	std::condition_variable cv;
-	std::thread t;
-	bool quit = false;
+	ThreadPool* pool;
+	JobPriority prio;
+	// whether a job is running or queued in the pool to process the queue
+	bool scheduled = false;
+	JobHandle drainJob;
+	AtomicBool quit = false;
 };
 
-static void AsyncJobQueueProc(AsyncJobQueueImpl* wqi)
+static void AsyncJobQueueDrain(AsyncJobQueueImpl* wqi)
 {
 	std::unique_lock<std::mutex> ulk(wqi->m);
-	for (;;)
+	while (!wqi->q.empty())
 	{
-		while (!(wqi->quit || !wqi->q.empty()))
-			wqi->cv.wait(ulk);
-		if (wqi->quit && wqi->q.empty())
-			return;
 		auto* e = wqi->q.front();
 		wqi->q.pop();
 		ulk.unlock();
@@ -166,41 +857,55 @@ static void AsyncJobQueueProc(AsyncJobQueueImpl* wqi)
 		delete e;
 		ulk.lock();
 	}
+	wqi->scheduled = false;
+	wqi->cv.notify_all();
 }
 
-AsyncJobQueue::AsyncJobQueue()
+AsyncJobQueue::AsyncJobQueue(JobPriority prio, ThreadPool* pool)
 {
 	_impl = new AsyncJobQueueImpl;
-	_impl->t = std::thread(AsyncJobQueueProc, _impl);
+	_impl->pool = pool ? pool : &ThreadPool::Get();
+	_impl->prio = prio;
 }
 
 AsyncJobQueue::~AsyncJobQueue()
 {
+	JobHandle drainJob;
 	{
 		std::lock_guard<std::mutex> g(_impl->m);
-		_impl->quit = true;
+		_impl->quit.Store(true);
+		drainJob = _impl->drainJob;
+	}
+	// run the remaining jobs here if the pool hasn't started on them
+	if (drainJob.Cancel())
+		AsyncJobQueueDrain(_impl);
+	{
+		std::unique_lock<std::mutex> ulk(_impl->m);
+		while (_impl->scheduled)
+			_impl->cv.wait(ulk);
 	}
-	_impl->cv.notify_one();
-	_impl->t.join();
 	delete _impl;
 }
 
 void AsyncJobQueue::_AddToQueue(Entry* e, bool clear)
 {
+	std::lock_guard<std::mutex> g(_impl->m);
+	assert(!_impl->quit.Load());
+	if (clear)
 	{
-		std::lock_guard<std::mutex> g(_impl->m);
-		assert(!_impl->quit);
-		if (clear)
+		while (!_impl->q.empty())
 		{
-			while (!_impl->q.empty())
-			{
-				delete _impl->q.front();
-				_impl->q.pop();
-			}
+			delete _impl->q.front();
+			_impl->q.pop();
 		}
-		_impl->q.push(e);
 	}
-	_impl->cv.notify_one();
+	_impl->q.push(e);
+	if (!_impl->scheduled)
+	{
+		_impl->scheduled = true;
+		auto* impl = _impl;
+		_impl->drainJob = _impl->pool->Run([impl]() { AsyncJobQueueDrain(impl); }, _impl->prio);
+	}
 }
 
 void AsyncJobQueue::Clear()
@@ -221,7 +926,474 @@ bool AsyncJobQueue::HasItems()
 
 bool AsyncJobQueue::IsQuitting()
 {
-	return _impl->quit;
+	return _impl->quit.Load();
+}
+
+
+#if UI_BUILD_TESTS
+#include "Test.h"
+
+DEFINE_TEST_CATEGORY(Threading, 500);
+
+double hqtime();
+
+DEFINE_TEST(Threading, ThreadPoolManySmallJobs)
+{
+	ThreadPool pool(4);
+	constexpr int NUM_JOBS = 10000;
+	std::atomic<int> sum{ 0 };
+
+	double t0 = hqtime();
+	Array<JobHandle> handles;
+	for (int i = 0; i < NUM_JOBS; i++)
+		handles.Append(pool.Run([&sum, i]() { sum += i; }));
+	for (auto& h : handles)
+		h.Wait();
+	double t1 = hqtime();
+	ASSERT_EQUAL(true, sum.load() == NUM_JOBS * (NUM_JOBS - 1) / 2);
+	for (auto& h : handles)
+		ASSERT_EQUAL(true, h.IsDone() && !h.IsCancelled());
+
+	// jobs spawning jobs stay on the worker's own queue and get stolen by the others
+	sum = 0;
+	double t2 = hqtime();
+	for (int i = 0; i < 100; i++)
+	{
+		pool.Run([&pool, &sum]()
+		{
+			Array<JobHandle> sub;
+			for (int j = 0; j < 100; j++)
+				sub.Append(pool.Run([&sum]() { sum++; }));
+			for (auto& h : sub)
+				h.Wait();
+		});
+	}
+	pool.WaitIdle();
+	double t3 = hqtime();
+	ASSERT_EQUAL(true, sum.load() == 100 * 100);
+
+	// the same jobs on a single AsyncJobQueue (one at a time)
+	sum = 0;
+	double t4 = hqtime();
+	{
+		AsyncJobQueue ajq(JobPriority::Normal, &pool);
+		for (int i = 0; i < NUM_JOBS; i++)
+			ajq.Push([&sum, i]() { sum += i; });
+	}
+	double t5 = hqtime();
+	ASSERT_EQUAL(true, sum.load() == NUM_JOBS * (NUM_JOBS - 1) / 2);
+
+	printf("- %d jobs: %.3f ms, 100x100 nested jobs: %.3f ms, %d jobs in AsyncJobQueue: %.3f ms\n",
+		NUM_JOBS, (t1 - t0) * 1000, (t3 - t2) * 1000, NUM_JOBS, (t5 - t4) * 1000);
+}
+
+// keeps the only worker busy until released so that the queue can be inspected
+struct BlockWorker
+{
+	std::mutex m;
+	std::condition_variable cv;
+	bool started = false;
+	bool released = false;
+
+	void Block(ThreadPool& pool)
+	{
+		pool.Run([this]()
+		{
+			std::unique_lock<std::mutex> ulk(m);
+			started = true;
+			cv.notify_all();
+			while (!released)
+				cv.wait(ulk);
+		});
+		std::unique_lock<std::mutex> ulk(m);
+		while (!started)
+			cv.wait(ulk);
+	}
+	void Release()
+	{
+		std::lock_guard<std::mutex> g(m);
+		released = true;
+		cv.notify_all();
+	}
+};
+
+DEFINE_TEST(Threading, ThreadPoolPriority)
+{
+	ThreadPool pool(1);
+	BlockWorker bw;
+	bw.Block(pool);
+
+	std::mutex m;
+	std::string order;
+	auto add = [&m, &order](char c) { std::lock_guard<std::mutex> g(m); order.push_back(c); };
+	pool.Run([&add]() { add('l'); }, JobPriority::Low);
+	pool.Run([&add]() { add('n'); }, JobPriority::Normal);
+	pool.Run([&add]() { add('h'); }, JobPriority::High);
+	pool.Run([&add]() { add('L'); }, JobPriority::Low);
+	pool.Run([&add]() { add('H'); }, JobPriority::High);
+
+	bw.Release();
+	pool.WaitIdle();
+	ASSERT_EQUAL(true, order == "hHnlL");
+}
+
+DEFINE_TEST(Threading, ThreadPoolCancel)
+{
+	ThreadPool pool(1);
+	BlockWorker bw;
+	bw.Block(pool);
+
+	std::atomic<int> numRun{ 0 };
+	JobHandle a = pool.Run([&numRun]() { numRun++; });
+	JobHandle b = pool.Run([&numRun]() { numRun++; });
+	ASSERT_EQUAL(false, a.IsDone());
+	ASSERT_EQUAL(true, a.Cancel());
+	ASSERT_EQUAL(true, a.IsDone());
+	ASSERT_EQUAL(true, a.IsCancelled());
+
+	// a running job can observe the cancellation
+	std::atomic<bool> started{ false };
+	std::atomic<bool> sawCancel{ false };
+	JobHandle c = pool.Run([&started, &sawCancel]()
+	{
+		started = true;
+		while (!ThreadPool::IsCurrentJobCancelled()) {}
+		sawCancel = true;
+	});
+
+	bw.Release();
+	b.Wait();
+	while (!started) {}
+	ASSERT_EQUAL(false, c.Cancel());
+	c.Wait();
+	ASSERT_EQUAL(true, sawCancel.load());
+	ASSERT_EQUAL(true, numRun.load() == 1);
+
+	// waiting on a cancelled job returns immediately
+	a.Wait();
+
+	// destroying the pool cancels the queued jobs
+	JobHandle d;
+	{
+		// outlives the pool since the worker may still be unlocking its mutex
+		BlockWorker bw2;
+		ThreadPool pool2(1);
+		bw2.Block(pool2);
+		d = pool2.Run([&numRun]() { numRun++; });
+		bw2.Release();
+	}
+	ASSERT_EQUAL(true, d.IsDone());
+	ASSERT_EQUAL(true, numRun.load() == 1 || numRun.load() == 2);
+
+	// waiting from another thread while the pool is being destroyed
+	for (int i = 0; i < 20; i++)
+	{
+		JobHandle e;
+		std::thread waiter;
+		{
+			// outlives the pool since the worker may still be unlocking its mutex
+			BlockWorker bw3;
+			ThreadPool pool3(1);
+			bw3.Block(pool3);
+			e = pool3.Run([]() {});
+			waiter = std::thread([e]() mutable { e.Wait(); });
+			bw3.Release();
+		}
+		waiter.join();
+		ASSERT_EQUAL(true, e.IsDone());
+	}
+}
+
+DEFINE_TEST(Threading, ThreadPoolContinuation)
+{
+	ThreadPool pool(2);
+	EventQueue eq;
+
+	int result = 0;
+	JobHandle h = pool.RunThen([]() { return 42; }, eq, [&result](int v) { result = v; });
+	h.Wait();
+	ASSERT_EQUAL(true, result == 0);
+	eq.RunAllCurrent();
+	ASSERT_EQUAL(true, result == 42);
+
+	bool called = false;
+	pool.RunThen([]() {}, eq, [&called]() { called = true; }).Wait();
+	eq.RunAllCurrent();
+	ASSERT_EQUAL(true, called);
+
+	// cancelled before starting - no continuation
+	BlockWorker bw1, bw2;
+	bw1.Block(pool);
+	bw2.Block(pool);
+	result = 0;
+	JobHandle c = pool.RunThen([]() { return 1; }, eq, [&result](int v) { result = v; });
+	ASSERT_EQUAL(true, c.Cancel());
+	bw1.Release();
+	bw2.Release();
+	pool.WaitIdle();
+	eq.RunAllCurrent();
+	ASSERT_EQUAL(true, result == 0);
+}
+
+DEFINE_TEST(Threading, ThreadPoolLiveness)
+{
+	ThreadPool pool(1);
+	EventQueue eq;
+
+	// owner destroyed before the jobs start - none of them run
+	std::atomic<int> numRun{ 0 };
+	Array<JobHandle> handles;
+	{
+		BlockWorker bw;
+		bw.Block(pool);
+		{
+			LivenessTokenOwner owners[10];
+			for (int i = 0; i < 100; i++)
+			{
+				handles.Append(pool.RunFor(owners[i % 10].GetOrCreate(), [&numRun]() { numRun++; }));
+				handles.Append(pool.RunThenFor(owners[i % 10].GetOrCreate(), [&numRun]() { numRun++; }, eq, [&numRun]() { numRun++; }));
+			}
+		}
+		bw.Release();
+	}
+	pool.WaitIdle();
+	eq.RunAllCurrent();
+	ASSERT_EQUAL(true, numRun.load() == 0);
+	for (auto& h : handles)
+	{
+		ASSERT_EQUAL(true, h.IsDone());
+		ASSERT_EQUAL(true, h.IsCancelled());
+	}
+
+	// a running job sees the cancellation
+	{
+		std::atomic<bool> started{ false };
+		LivenessTokenOwner* owner = new LivenessTokenOwner;
+		JobHandle h = pool.RunFor(owner->GetOrCreate(), [&started]()
+		{
+			started = true;
+			while (!ThreadPool::IsCurrentJobCancelled())
+				std::this_thread::yield();
+		});
+		while (!started)
+			std::this_thread::yield();
+		ASSERT_EQUAL(false, h.IsCancelled());
+		delete owner;
+		h.Wait();
+		ASSERT_EQUAL(true, h.IsCancelled());
+	}
+
+	// owner destroyed after the job finished but before the continuation - skipped
+	{
+		int result = 0;
+		LivenessTokenOwner* owner = new LivenessTokenOwner;
+		pool.RunThenFor(owner->GetOrCreate(), []() { return 5; }, eq, [&result](int v) { result = v; }).Wait();
+		delete owner;
+		eq.RunAllCurrent();
+		ASSERT_EQUAL(true, result == 0);
+
+		LivenessTokenOwner owner2;
+		pool.RunThenFor(owner2.GetOrCreate(), []() { return 6; }, eq, [&result](int v) { result = v; }).Wait();
+		eq.RunAllCurrent();
+		ASSERT_EQUAL(true, result == 6);
+	}
+}
+
+DEFINE_TEST(Threading, ParallelFor)
+{
+	ThreadPool pool(3);
+
+	for (size_t count : { 0, 1, 7, 100, 1000 })
+	{
+		for (size_t grain : { 0, 1, 3, 64, 5000 })
+		{
+			Array<std::atomic<int>> hits;
+			hits.Resize(count);
+			for (auto& h : hits)
+				h = 0;
+			std::atomic<size_t> numRanges{ 0 };
+			pool.ParallelFor(count, grain, [&](size_t begin, size_t end)
+			{
+				ASSERT_EQUAL(true, begin < end && end <= count);
+				// ranges are always split at multiples of the grain size
+				ASSERT_EQUAL(true, begin % (grain ? grain : 1) == 0);
+				for (size_t i = begin; i < end; i++)
+					hits[i]++;
+				numRanges++;
+			});
+			for (auto& h : hits)
+				ASSERT_EQUAL(true, h.load() == 1);
+			size_t g = grain ? grain : 1;
+			ASSERT_EQUAL(true, numRanges.load() == (count + g - 1) / g);
+		}
+	}
+
+	// nested use from jobs
+	std::atomic<int> sum{ 0 };
+	Array<JobHandle> handles;
+	for (int i = 0; i < 8; i++)
+	{
+		handles.Append(pool.Run([&pool, &sum]()
+		{
+			pool.ParallelFor(100, 10, [&sum](size_t begin, size_t end) { sum += int(end - begin); });
+		}));
+	}
+	for (auto& h : handles)
+		h.Wait();
+	ASSERT_EQUAL(true, sum.load() == 800);
+}
+
+DEFINE_TEST(Threading, AsyncJobQueueOrder)
+{
+	ThreadPool pool(4);
+	Array<int> order;
+	{
+		AsyncJobQueue ajq(JobPriority::Normal, &pool);
+		for (int i = 0; i < 1000; i++)
+			ajq.Push([&order, i]() { order.Append(i); });
+	}
+	ASSERT_EQUAL(true, order.Size() == 1000);
+	for (int i = 0; i < 1000; i++)
+		ASSERT_EQUAL(true, order[i] == i);
+}
+struct EventQueueTestEntry
+{
+	static std::atomic<int> numAlive;
+
+	int* out;
+	int value;
+	char padding[200];
+
+	EventQueueTestEntry(int* o, int v) : out(o), value(v) { numAlive++; }
+	EventQueueTestEntry(EventQueueTestEntry&& o) : out(o.out), value(o.value) { numAlive++; }
+	~EventQueueTestEntry() { numAlive--; }
+	void operator () () { *out += value; }
+};
+std::atomic<int> EventQueueTestEntry::numAlive{ 0 };
+
+DEFINE_TEST(Threading, EventQueueBasic)
+{
+	int sum = 0;
+	{
+		EventQueue eq;
+		ASSERT_EQUAL(false, eq.RunOne());
+		eq.Push([&sum]() { sum += 1; });
+		eq.Push([&sum]() { sum *= 10; });
+		// bigger than ENTRY_INLINE_SIZE
+		eq.Push(EventQueueTestEntry(&sum, 5));
+		ASSERT_EQUAL(true, eq.RunOne());
+		ASSERT_EQUAL(true, sum == 1);
+		eq.RunAllCurrent();
+		ASSERT_EQUAL(true, sum == 15);
+		ASSERT_EQUAL(true, EventQueueTestEntry::numAlive.load() == 0);
+
+		// entries pushed while running are left for the next call
+		eq.Push([&sum, &eq]() { eq.Push([&sum]() { sum = 100; }); });
+		eq.RunAllCurrent();
+		ASSERT_EQUAL(true, sum == 15);
+		eq.RunAllCurrent();
+		ASSERT_EQUAL(true, sum == 100);
+
+		// clearing
+		eq.Push([&sum]() { sum = 1; });
+		eq.Push(EventQueueTestEntry(&sum, 5));
+		eq.Push([&sum]() { sum += 2; }, true);
+		ASSERT_EQUAL(true, EventQueueTestEntry::numAlive.load() == 1);
+		eq.RunAllCurrent();
+		ASSERT_EQUAL(true, sum == 102);
+		ASSERT_EQUAL(true, EventQueueTestEntry::numAlive.load() == 0);
+
+		// destroyed without running
+		eq.Push(EventQueueTestEntry(&sum, 5));
+	}
+	ASSERT_EQUAL(true, sum == 102);
+	ASSERT_EQUAL(true, EventQueueTestEntry::numAlive.load() == 0);
+}
+
+// the previous implementation, for comparison
+struct MutexEventQueue
+{
+	std::queue<std::function<void()>> q;
+	std::mutex m;
+
+	template <class F> void Push(F&& f)
+	{
+		std::lock_guard<std::mutex> g(m);
+		q.push(Move(f));
+	}
+	void RunAllCurrent()
+	{
+		std::queue<std::function<void()>> cur;
+		{
+			std::lock_guard<std::mutex> g(m);
+			std::swap(cur, q);
+		}
+		while (!cur.empty())
+		{
+			cur.front()();
+			cur.pop();
+		}
+	}
+};
+
+template <class Q>
+static double EventQueueContention(int numProducers, int numPerProducer, bool& outOrderOK)
+{
+	Q eq;
+	Array<int> lastSeen;
+	lastSeen.ResizeWith(numProducers, -1);
+	int numDone = 0;
+	bool orderOK = true;
+	std::atomic<int> numFinishedProducers{ 0 };
+
+	double t0 = hqtime();
+	Array<std::thread> producers;
+	for (int p = 0; p < numProducers; p++)
+	{
+		producers.Append(std::thread([&, p]()
+		{
+			for (int i = 0; i < numPerProducer; i++)
+			{
+				eq.Push([&lastSeen, &numDone, &orderOK, p, i]()
+				{
+					if (lastSeen[p] + 1 != i)
+						orderOK = false;
+					lastSeen[p] = i;
+					numDone++;
+				});
+			}
+			numFinishedProducers++;
+		}));
+	}
+	while (numDone < numProducers * numPerProducer)
+	{
+		eq.RunAllCurrent();
+		if (numFinishedProducers.load() < numProducers)
+			std::this_thread::yield();
+	}
+	double t1 = hqtime();
+	for (auto& t : producers)
+		t.join();
+
+	outOrderOK = orderOK && numDone == numProducers * numPerProducer;
+	return t1 - t0;
+}
+
+DEFINE_TEST(Threading, EventQueueContention)
+{
+	constexpr int NUM_PRODUCERS = 8;
+	constexpr int NUM_PER_PRODUCER = 100000;
+	bool orderOK = false;
+	// the first run fills the entry pool
+	double tNewCold = EventQueueContention<EventQueue>(NUM_PRODUCERS, NUM_PER_PRODUCER, orderOK);
+	ASSERT_EQUAL(true, orderOK);
+	double tNew = EventQueueContention<EventQueue>(NUM_PRODUCERS, NUM_PER_PRODUCER, orderOK);
+	ASSERT_EQUAL(true, orderOK);
+	double tOld = EventQueueContention<MutexEventQueue>(NUM_PRODUCERS, NUM_PER_PRODUCER, orderOK);
+	ASSERT_EQUAL(true, orderOK);
+	printf("- %d producers x %d events: lock-free=%.3f ms (cold pool: %.3f ms) mutex+std::function=%.3f ms\n",
+		NUM_PRODUCERS, NUM_PER_PRODUCER, tNew * 1000, tNewCold * 1000, tOld * 1000);
 }
+#endif
 
 } // ui
@@ -1,6 +1,9 @@
 
 #pragma once
 
+#include "Platform.h"
+
+#include <new>
 #include <type_traits>
 
 
@@ -25,6 +28,9 @@ struct AtomicInt32
 	void Store(int32_t v);
 	AtomicInt32& operator ++ ();
 	AtomicInt32& operator -- ();
+	// return the new value
+	int32_t Increment();
+	int32_t Decrement();
 
 	operator int32_t () const { return Load(); }
 	AtomicInt32& operator = (const AtomicInt32& o)
@@ -49,6 +55,41 @@ private:
 	int32_t _mem;
 };
 
+// reader-writer lock (not recursive)
+struct RWMutex
+{
+	RWMutex();
+	~RWMutex();
+	RWMutex(const RWMutex&) = delete;
+	RWMutex& operator = (const RWMutex&) = delete;
+
+	void Lock();
+	void Unlock();
+	void LockShared();
+	void UnlockShared();
+
+private:
+	void* _mem[8];
+};
+
+struct RWMutexLock
+{
+	UI_FORCEINLINE RWMutexLock(RWMutex& m) : _m(m) { m.Lock(); }
+	UI_FORCEINLINE ~RWMutexLock() { _m.Unlock(); }
+	RWMutex& _m;
+};
+
+struct RWMutexSharedLock
+{
+	UI_FORCEINLINE RWMutexSharedLock(RWMutex& m) : _m(m) { m.LockShared(); }
+	UI_FORCEINLINE ~RWMutexSharedLock() { _m.UnlockShared(); }
+	RWMutex& _m;
+};
+
+// multiple producer, single consumer queue of callbacks
+// - pushing is lock-free, the callbacks are stored in pooled fixed-size entries
+//   (bigger ones are moved to a separate heap allocation)
+// - Clear/RunOne/RunAllCurrent must only be called from the consumer thread
 struct EventQueue
 {
 	struct Entry
@@ -57,11 +98,18 @@ struct EventQueue
 		virtual void Run() = 0;
 	};
 
+	// with the link, the entries take one 64 byte cache line
+	static constexpr size_t ENTRY_INLINE_SIZE = 48;
+	static constexpr size_t ENTRY_INLINE_ALIGN = 16;
+
 	EventQueue();
 	~EventQueue();
+	// returns ENTRY_INLINE_SIZE bytes for the entry that must then be passed to _AddToQueue
+	static void* _AllocEntry();
 	void _AddToQueue(Entry* e, bool clear);
 	void Clear();
 	bool RunOne();
+	// runs the entries that were queued before the call
 	void RunAllCurrent();
 
 	template <class F> void Push(F&& f, bool clear = false)
@@ -76,12 +124,207 @@ struct EventQueue
 			}
 			F f;
 		};
-		_AddToQueue(new Func(Move(f)), clear);
+		struct HeapFunc : Entry
+		{
+			HeapFunc(F&& _f) : f(new F(Move(_f))) {}
+			~HeapFunc() { delete f; }
+			void Run() override
+			{
+				(*f)();
+			}
+			F* f;
+		};
+		UI_IF_MAYBE_CONSTEXPR(sizeof(Func) <= ENTRY_INLINE_SIZE && alignof(Func) <= ENTRY_INLINE_ALIGN)
+			_AddToQueue(new (_AllocEntry()) Func(Move(f)), clear);
+		else
+			_AddToQueue(new (_AllocEntry()) HeapFunc(Move(f)), clear);
 	}
 
 	struct EventQueueImpl* _impl;
 };
 
+struct LivenessToken;
+
+enum class JobPriority : u8
+{
+	High = 0,
+	Normal,
+	Low,
+};
+static constexpr int NUM_JOB_PRIORITIES = 3;
+
+// shared reference to a job submitted to a ThreadPool
+struct JobHandle
+{
+	struct JobState* _state = nullptr;
+
+	UI_FORCEINLINE JobHandle() {}
+	JobHandle(const JobHandle& o);
+	JobHandle(JobHandle&& o) : _state(o._state) { o._state = nullptr; }
+	~JobHandle();
+	JobHandle& operator = (const JobHandle& o);
+	JobHandle& operator = (JobHandle&& o);
+
+	UI_FORCEINLINE bool IsValid() const { return _state != nullptr; }
+	// finished running or cancelled before it started
+	bool IsDone() const;
+	// Cancel was called or the owner of the job's liveness token was destroyed
+	bool IsCancelled() const;
+	// prevents the job from starting and asks it to stop if it's running (see ThreadPool::IsCurrentJobCancelled)
+	// returns true if the job will not run
+	bool Cancel();
+	// runs other queued jobs on the calling thread while waiting
+	void Wait();
+};
+
+// work-stealing thread pool
+// - each worker has its own queues (one per priority), jobs submitted from a worker go to its own queues,
+//   jobs from other threads go to a shared queue, idle workers steal from the others
+// - higher priority jobs are picked first but the order of jobs is not guaranteed
+// - destroying the pool cancels the queued jobs and waits for the running ones
+struct ThreadPool
+{
+	struct Job
+	{
+		virtual ~Job() {}
+		virtual void Run() = 0;
+	};
+
+	// 0 = one less than the number of logical CPU cores (but at least one)
+	ThreadPool(u32 numThreads = 0);
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator = (const ThreadPool&) = delete;
+
+	// the shared pool, created on first use
+	static ThreadPool& Get();
+	static void ShutdownGlobal();
+
+	u32 GetNumThreads() const;
+	// whether the job running on the calling thread was cancelled or its target was destroyed (for long jobs to stop early)
+	static bool IsCurrentJobCancelled();
+	// the job running on the calling thread (if any)
+	static JobHandle GetCurrentJob();
+
+	// liveness (optional): the job is considered cancelled once the token is no longer alive
+	JobHandle _Submit(Job* job, JobPriority prio, const LivenessToken* liveness);
+	// runs one queued job on the calling thread, returns false if there were none
+	bool RunOne();
+	// waits until there are no queued or running jobs, runs jobs on the calling thread in the meantime
+	void WaitIdle();
+
+	template <class F> static Job* _MakeJob(F&& f)
+	{
+		struct Func : Job
+		{
+			Func(F&& _f) : f(Move(_f)) {}
+			void Run() override
+			{
+				f();
+			}
+			F f;
+		};
+		return new Func(Move(f));
+	}
+
+	template <class F> JobHandle Run(F&& f, JobPriority prio = JobPriority::Normal)
+	{
+		static_assert(std::is_rvalue_reference<F&&>::value, "not an rvalue reference");
+		return _Submit(_MakeJob(Move(f)), prio, nullptr);
+	}
+
+	// the job is tied to the lifetime of the token's owner (e.g. UIObject::GetLivenessToken()):
+	// - it's dropped if the owner is destroyed before the job starts
+	// - while it's running, IsCurrentJobCancelled returns true once the owner is destroyed
+	template <class F> JobHandle RunFor(const LivenessToken& liveness, F&& f, JobPriority prio = JobPriority::Normal)
+	{
+		static_assert(std::is_rvalue_reference<F&&>::value, "not an rvalue reference");
+		return _Submit(_MakeJob(Move(f)), prio, &liveness);
+	}
+
+	// runs `f` on a worker thread and then pushes `then` with its result (if any) to the event queue
+	// - onPushed is called after pushing (e.g. to wake up the thread that processes the queue)
+	// - `then` is skipped if the job is cancelled before it runs
+	template <class F, class C> JobHandle RunThen(F&& f, EventQueue& eq, C&& then, JobPriority prio = JobPriority::Normal, void (*onPushed)() = nullptr)
+	{
+		static_assert(std::is_rvalue_reference<F&&>::value, "not an rvalue reference");
+		static_assert(std::is_rvalue_reference<C&&>::value, "not an rvalue reference");
+		return _Submit(_MakeThenJob(Move(f), eq, Move(then), onPushed), prio, nullptr);
+	}
+
+	// RunThen + RunFor: `then` is also skipped if the owner of the token is destroyed before it runs
+	template <class F, class C> JobHandle RunThenFor(const LivenessToken& liveness, F&& f, EventQueue& eq, C&& then, JobPriority prio = JobPriority::Normal, void (*onPushed)() = nullptr)
+	{
+		static_assert(std::is_rvalue_reference<F&&>::value, "not an rvalue reference");
+		static_assert(std::is_rvalue_reference<C&&>::value, "not an rvalue reference");
+		return _Submit(_MakeThenJob(Move(f), eq, Move(then), onPushed), prio, &liveness);
+	}
+
+	// calls f(begin, end) for consecutive ranges of [0, count) on the pool threads and the calling thread, returns when all are done
+	// - the ranges depend only on count and grainSize (not on the number of threads or timing),
+	//   so the results are deterministic as long as each range only writes its own part of the output
+	// - runs everything on the calling thread if there's only one range or no worker threads
+	template <class F> void ParallelFor(size_t count, size_t grainSize, F&& f)
+	{
+		using FT = typename std::remove_reference<F>::type;
+		_ParallelFor(count, grainSize, [](void* userdata, size_t begin, size_t end)
+		{
+			(*static_cast<FT*>(userdata))(begin, end);
+		}, &f);
+	}
+	void _ParallelFor(size_t count, size_t grainSize, void (*fn)(void* userdata, size_t begin, size_t end), void* userdata);
+
+	template <class F, class C> static Job* _MakeThenJob(F&& f, EventQueue& eq, C&& then, void (*onPushed)())
+	{
+		using R = decltype(f());
+		EventQueue* peq = &eq;
+		return _MakeJob([f{ Move(f) }, peq, then{ Move(then) }, onPushed]() mutable
+		{
+			_JobThen<R>::Call(f, *peq, then);
+			if (onPushed && !IsCurrentJobCancelled())
+				onPushed();
+		});
+	}
+
+	template <class R> struct _JobThen
+	{
+		template <class F, class C> static void Call(F& f, EventQueue& eq, C& then)
+		{
+			R result = f();
+			JobHandle self = GetCurrentJob();
+			if (!self.IsCancelled())
+			{
+				eq.Push([self, then{ Move(then) }, result{ Move(result) }]() mutable
+				{
+					if (!self.IsCancelled())
+						then(Move(result));
+				});
+			}
+		}
+	};
+
+	struct ThreadPoolImpl* _impl;
+};
+
+template <> struct ThreadPool::_JobThen<void>
+{
+	template <class F, class C> static void Call(F& f, EventQueue& eq, C& then)
+	{
+		f();
+		JobHandle self = GetCurrentJob();
+		if (!self.IsCancelled())
+		{
+			eq.Push([self, then{ Move(then) }]() mutable
+			{
+				if (!self.IsCancelled())
+					then();
+			});
+		}
+	}
+};
+
+// runs jobs one at a time, in order, on the threads of a ThreadPool
+// - the destructor waits for the queued jobs to finish (long jobs can check IsQuitting)
 struct AsyncJobQueue
 {
 	struct Entry
@@ -90,7 +333,7 @@ struct AsyncJobQueue
 		virtual void Run() = 0;
 	};
 
-	AsyncJobQueue();
+	AsyncJobQueue(JobPriority prio = JobPriority::Normal, ThreadPool* pool = nullptr);
 	~AsyncJobQueue();
 	void _AddToQueue(Entry* e, bool clear);
 	void Clear();
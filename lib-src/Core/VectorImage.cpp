@@ -3,6 +3,7 @@
 
 #include "FileSystem.h"
 #include "HashMap.h"
+#include "MemoryAccounting.h"
 
 #define NANOSVG_IMPLEMENTATION
 #include "../../ThirdParty/nanosvg.h"
@@ -20,6 +21,7 @@ struct VectorImageImpl : IVectorImage
 	Size2f size = {};
 	NSVGrasterizer* rasterizer = nullptr;
 	NSVGimage* image = nullptr;
+	size_t memBytes = sizeof(VectorImageImpl);
 
 	std::string cacheKey;
 
@@ -40,9 +42,19 @@ struct VectorImageImpl : IVectorImage
 		}
 	}
 
-	VectorImageImpl()
+	VectorImageImpl(NSVGimage* img) : image(img)
 	{
+		size = { img->width, img->height };
 		rasterizer = nsvgCreateRasterizer();
+
+		// the parsed shapes (the rasterizer's buffers are not included)
+		for (auto* shape = img->shapes; shape; shape = shape->next)
+		{
+			memBytes += sizeof(*shape);
+			for (auto* path = shape->paths; path; path = path->next)
+				memBytes += sizeof(*path) + sizeof(float) * 2 * path->npts;
+		}
+		MemTrackAlloc(MemTag::VectorImages, memBytes);
 	}
 	~VectorImageImpl()
 	{
@@ -51,6 +63,7 @@ struct VectorImageImpl : IVectorImage
 
 		nsvgDeleteRasterizer(rasterizer);
 		nsvgDelete(image);
+		MemTrackFree(MemTag::VectorImages, memBytes);
 	}
 
 	// IVectorImage
@@ -113,9 +126,7 @@ VectorImageHandle VectorImageLoadFromFile(StringView path)
 	if (!svg)
 		return nullptr;
 
-	auto* impl = new VectorImageImpl;
-	impl->size = { svg->width, svg->height };
-	impl->image = svg;
+	auto* impl = new VectorImageImpl(svg);
 	VectorImageCacheWrite(impl, cacheKey);
 
 	return impl;
@@ -38,7 +38,7 @@ struct LivenessToken
 	}
 	void Release()
 	{
-		if (_data && --_data->ref <= 0)
+		if (_data && _data->ref.Decrement() <= 0)
 		{
 			delete _data;
 			_data = nullptr;
@@ -52,7 +52,7 @@ struct LivenessToken
 	void SetAlive(bool alive)
 	{
 		if (_data)
-			_data->alive = alive;
+			_data->alive.Store(alive);
 	}
 	LivenessToken& GetOrCreate()
 	{
@@ -672,23 +672,87 @@ void TableView::CalculateColumnWidths(bool includeHeader, bool firstTimeOnly)
 	size_t nr = _impl->dataSource->GetElements(All{}, ids);
 	_impl->lastRowCount = nr;
 
-	auto* cellFont = style.cellFont.GetFont();
-	for (size_t i = 0; i < nr; i++)
+	// the cell texts are collected first and measured in one batch
+	struct MeasuredCell
+	{
+		size_t row;
+		size_t col;
+	};
+	Array<MeasuredCell> cells;
+	std::string textBuf;
+	Array<size_t> textEnds;
+	auto addCell = [&](size_t row, size_t col, StringView text)
+	{
+		cells.Append({ row, col });
+		textBuf.append(text.data(), text.size());
+		textEnds.Append(textBuf.size());
+	};
+
+	size_t sampleRows = columnWidthSampleRows;
+	if (sampleRows && nr > sampleRows)
 	{
-		auto rowRef = ExtractID(ids, i, 0);
+		Array<size_t> longestSize;
+		Array<size_t> longestRow;
+		longestSize.ResizeWith(nc, 0);
+		longestRow.ResizeWith(nc, SIZE_MAX);
+
+		size_t nextSample = 0;
+		for (size_t i = 0; i < nr; i++)
+		{
+			auto rowRef = ExtractID(ids, i, 0);
+			bool isSample = i == nextSample * nr / sampleRows && nextSample < sampleRows;
+			if (isSample)
+				nextSample++;
+			for (size_t c = 0; c < nc; c++)
+			{
+				std::string text = _impl->dataSource->GetText(rowRef.id, c);
+				if (isSample)
+					addCell(i, c, text);
+				else if (text.size() > longestSize[c])
+				{
+					longestSize[c] = text.size();
+					longestRow[c] = i;
+				}
+			}
+		}
 		for (size_t c = 0; c < nc; c++)
+			if (longestRow[c] != SIZE_MAX)
+				addCell(longestRow[c], c, _impl->dataSource->GetText(ExtractID(ids, longestRow[c], 0).id, c));
+	}
+	else
+	{
+		for (size_t i = 0; i < nr; i++)
 		{
-			std::string text = _impl->dataSource->GetText(rowRef.id, c);
-			float w = GetTextWidth(cellFont, style.cellFont.size, text) + padC.x0 + padC.x1;
-			if (c == treeCol)
-				w += rowRef.depth * 20 + cellh;
-			if (_impl->dataSource->GetIcon(rowRef.id, c))
-				w += cellh;
-			if (colWidths[c] < w)
-				colWidths[c] = w;
+			auto rowRef = ExtractID(ids, i, 0);
+			for (size_t c = 0; c < nc; c++)
+				addCell(i, c, _impl->dataSource->GetText(rowRef.id, c));
 		}
 	}
 
+	Array<StringView> texts;
+	texts.Reserve(cells.Size());
+	for (size_t i = 0; i < cells.Size(); i++)
+	{
+		size_t start = i ? textEnds[i - 1] : 0;
+		texts.Append(StringView(textBuf).substr(start, textEnds[i] - start));
+	}
+	Array<float> textWidths;
+	textWidths.Resize(cells.Size());
+	GetTextWidths(style.cellFont.GetFont(), style.cellFont.size, texts, textWidths.Data(), true);
+
+	for (size_t i = 0; i < cells.Size(); i++)
+	{
+		auto rowRef = ExtractID(ids, cells[i].row, 0);
+		size_t c = cells[i].col;
+		float w = textWidths[i] + padC.x0 + padC.x1;
+		if (c == treeCol)
+			w += rowRef.depth * 20 + cellh;
+		if (_impl->dataSource->GetIcon(rowRef.id, c))
+			w += cellh;
+		if (colWidths[c] < w)
+			colWidths[c] = w;
+	}
+
 	for (size_t c = 0; c < nc; c++)
 		_impl->colEnds[c + 1] = _impl->colEnds[c] + colWidths[c];
 }
@@ -146,6 +146,9 @@ struct TableView : FrameElement
 	bool enableRowHeader = true;
 	bool enableColumnHeader = true;
 	bool expandLastColumn = false;
+	// if nonzero and there are more rows, CalculateColumnWidths only measures this many evenly spaced rows
+	// and the longest text (in bytes) of each column
+	size_t columnWidthSampleRows = 0;
 	ScrollbarV scrollbarV;
 	float yOff = 0;
 
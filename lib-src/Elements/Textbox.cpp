@@ -1,6 +1,7 @@
 
 #include "Textbox.h"
 
+#include "../Core/TextBuffer.h"
 #include "../Model/Native.h"
 #include "../Render/RenderText.h"
 
@@ -11,106 +12,248 @@ struct TextRange
 {
 	size_t start;
 	size_t end;
+};
+
+// splits one line (without line breaks) into ranges that fit the width
+// returns the number of ranges, offset is added to the returned ranges
+static u32 WrapLine(StringView s, size_t offset, Font* font, int size, float maxWidth, Array<TextRange>* outRanges)
+{
+	if (outRanges)
+		outRanges->Clear();
 
-	StringView sv(StringView text)
+	u32 count = 1;
+	TextRange cur = { 0, 0 };
+
+	size_t lastBreakPos = 0;
+	float widthToLastBreak = 0;
+	float widthSoFar = 0;
+	uint32_t prevCh = 0;
+
+	TextMeasureBegin(font, size);
+	UTF8Iterator it(s);
+	for (;;)
 	{
-		return text.substr(start, end - start);
+		uint32_t charStart = it.pos;
+		uint32_t ch = it.Read();
+		if (ch == UTF8Iterator::END)
+			break;
+		cur.end = it.pos;
+
+		// TODO full unicode?
+		if (ch == ' ' || prevCh == ' ')
+		{
+			widthToLastBreak = widthSoFar;
+			lastBreakPos = charStart;
+		}
+		float w = TextMeasureAddChar(ch);
+		if (w > maxWidth && charStart != cur.start)
+		{
+			size_t p = widthToLastBreak > 0 ? lastBreakPos : charStart;
+
+			it.pos = p;
+			if (outRanges)
+				outRanges->Append({ offset + cur.start, offset + p });
+			count++;
+			cur = { p, p };
+
+			TextMeasureReset();
+			widthToLastBreak = 0;
+			widthSoFar = 0;
+			prevCh = 0;
+			continue;
+		}
+		widthSoFar = w;
+		prevCh = ch;
 	}
-};
+	TextMeasureEnd();
+
+	if (outRanges)
+		outRanges->Append({ offset + cur.start, offset + cur.end });
+	return count;
+}
 
-struct TextLines
+// visual (wrapped) lines of a text buffer
+// - lines are only wrapped when they are accessed (e.g. painted), the others use an estimated number of visual lines
+// - the number of visual lines is cached per buffer line and only recalculated for edited lines
+struct TextWrapCache
 {
-	Array<TextRange> lines;
+	Font* font = nullptr;
+	int size = 0;
+	float maxWidth = 0;
+	bool multiline = false;
+
+	Array<u32> lineCounts; // 0 = not wrapped yet (estimated)
+	Array<size_t> visualLineStarts; // one for each buffer line + the total count
+	bool visualLineStartsValid = false;
 
-	size_t FindLine(size_t pos) const
+	size_t wrappedLine = SIZE_MAX;
+	Array<TextRange> wrappedRanges;
+	std::string tmp;
+
+	UI_FORCEINLINE size_t NumBufferLines(const TextBuffer& buf) const { return multiline ? buf.GetLineCount() : 1; }
+
+	void Invalidate()
+	{
+		lineCounts.Clear();
+		visualLineStartsValid = false;
+		wrappedLine = SIZE_MAX;
+	}
+
+	void Update(const TextBuffer& buf, Font* f, int sz, float mw, bool ml)
 	{
-		if (lines.Size() <= 1)
-			return 0;
-		for (size_t i = 0; i < lines.Size(); i++)
+		if (f != font || sz != size || mw != maxWidth || ml != multiline)
 		{
-			if (lines[i].start <= pos && pos < lines[i].end)
-				return i;
+			font = f;
+			size = sz;
+			maxWidth = mw;
+			multiline = ml;
+			Invalidate();
+		}
+		if (lineCounts.Size() != NumBufferLines(buf))
+		{
+			Invalidate();
+			lineCounts.ResizeWithZeroes(NumBufferLines(buf));
 		}
-		if (lines.Last().end == pos)
-			return lines.Size() - 1;
-		// error
-		assert(!"bad position");
-		return 0;
 	}
-	void Recalculate(StringView s, Font* font, int size, float maxWidth, bool multiline)
+
+	// call after editing the buffer with the first edited line and the number of removed/added line breaks
+	void OnEdit(size_t line, size_t removedLines, size_t addedLines)
 	{
-		if (multiline)
-			RecalculateMultiline(s, font, size, maxWidth);
-		else
-			SetOne(s);
+		visualLineStartsValid = false;
+		wrappedLine = SIZE_MAX;
+
+		if (!multiline)
+			line = removedLines = addedLines = 0;
+		if (line + removedLines >= lineCounts.Size())
+		{
+			Invalidate();
+			return;
+		}
+		if (removedLines)
+			lineCounts.RemoveAt(line + 1, removedLines);
+		if (addedLines)
+		{
+			Array<u32> zeroes;
+			zeroes.ResizeWithZeroes(addedLines);
+			lineCounts.InsertManyAt(line + 1, zeroes.Data(), addedLines);
+		}
+		lineCounts[line] = 0;
 	}
-	void SetOne(StringView s)
+
+	// assumes an average character width of half the font size
+	u32 _EstimateLineCount(const TextBuffer& buf, size_t line) const
 	{
-		lines = { TextRange{ 0, s.size() } };
+		if (!multiline)
+			return 1;
+		size_t len = buf.GetLineEnd(line) - buf.GetLineStart(line);
+		if (maxWidth <= 0)
+			return u32(max(len, size_t(1)));
+		return u32(max(ceilf(len * size * 0.5f / maxWidth), 1.0f));
 	}
-	void RecalculateMultiline(StringView s, Font* font, int size, float maxWidth)
-	{
-		lines.Clear();
-		lines.Append({ 0, 0 });
 
-		size_t lastBreakPos = 0;
-		float widthToLastBreak = 0;
-		float widthSoFar = 0;
-		uint32_t prevCh = 0;
+	u32 _GetLineCount(const TextBuffer& buf, size_t line) const
+	{
+		return lineCounts[line] ? lineCounts[line] : _EstimateLineCount(buf, line);
+	}
 
-		TextMeasureBegin(font, size);
-		UTF8Iterator it(s);
-		for (;;)
+	ArrayView<TextRange> GetWrappedLine(const TextBuffer& buf, size_t line)
+	{
+		if (wrappedLine != line)
 		{
-			uint32_t charStart = it.pos;
-			uint32_t ch = it.Read();
-			if (ch == UTF8Iterator::END)
-				break;
-			lines.Last().end = it.pos;
-			if (ch == '\n')
+			size_t start = multiline ? buf.GetLineStart(line) : 0;
+			size_t end = multiline ? buf.GetLineEnd(line) : buf.Size();
+			if (multiline)
 			{
-				lines.Append({ it.pos, it.pos });
-
-				TextMeasureReset();
-				widthToLastBreak = 0;
-				widthSoFar = 0;
+				u32 prevCount = _GetLineCount(buf, line);
+				u32 count = WrapLine(buf.GetRange(start, end - start, tmp), start, font, size, maxWidth, &wrappedRanges);
+				lineCounts[line] = count;
+				// move the following visual lines instead of recalculating all of them
+				if (visualLineStartsValid && count != prevCount)
+				{
+					for (size_t i = line + 1; i < visualLineStarts.Size(); i++)
+						visualLineStarts[i] = visualLineStarts[i] + count - prevCount;
+				}
 			}
 			else
 			{
-				// TODO full unicode?
-				if (ch == ' ' || prevCh == ' ')
-				{
-					widthToLastBreak = widthSoFar;
-					lastBreakPos = charStart;
-				}
-				float w = TextMeasureAddChar(ch);
-				if (w > maxWidth && lines.Last().end != lines.Last().start)
-				{
-					uint32_t p = widthToLastBreak > 0 ? lastBreakPos : charStart;
+				wrappedRanges.Clear();
+				wrappedRanges.Append({ start, end });
+			}
+			wrappedLine = line;
+		}
+		return wrappedRanges;
+	}
 
-					it.pos = p;
-					lines.Last().end = p;
-					lines.Append({ p, p });
+	void _UpdateVisualLineStarts(const TextBuffer& buf)
+	{
+		if (visualLineStartsValid)
+			return;
 
-					TextMeasureReset();
-					widthToLastBreak = 0;
-					widthSoFar = 0;
-				}
-				widthSoFar = w;
+		size_t num = lineCounts.Size();
+		visualLineStarts.Resize(num + 1);
+		size_t total = 0;
+		for (size_t i = 0; i < num; i++)
+		{
+			visualLineStarts[i] = total;
+			total += _GetLineCount(buf, i);
+		}
+		visualLineStarts[num] = total;
+		visualLineStartsValid = true;
+	}
+
+	// includes the estimated lines so it can change when they're wrapped
+	size_t GetVisualLineCount(const TextBuffer& buf)
+	{
+		_UpdateVisualLineStarts(buf);
+		return visualLineStarts.Last();
+	}
+
+	size_t FindVisualLine(const TextBuffer& buf, size_t pos)
+	{
+		_UpdateVisualLineStarts(buf);
+		size_t line = multiline ? buf.FindLine(pos) : 0;
+		auto ranges = GetWrappedLine(buf, line);
+		size_t sub = ranges.Size() - 1;
+		for (size_t i = 0; i + 1 < ranges.Size(); i++)
+		{
+			if (pos < ranges[i + 1].start)
+			{
+				sub = i;
+				break;
 			}
-			prevCh = ch;
 		}
-		TextMeasureEnd();
+		return visualLineStarts[line] + sub;
+	}
+
+	TextRange GetVisualLine(const TextBuffer& buf, size_t visualLine)
+	{
+		_UpdateVisualLineStarts(buf);
 
-		if (lines.Last().start == lines.Last().end && (lines.size() == 1 || !lines[lines.size() - 2].sv(s).ends_with("\n")))
-			lines.RemoveLast();
+		for (;;)
+		{
+			// last buffer line that starts at or before the visual line
+			size_t lo = 0, hi = lineCounts.Size();
+			while (hi - lo > 1)
+			{
+				size_t mid = (lo + hi) / 2;
+				if (visualLineStarts[mid] <= visualLine)
+					lo = mid;
+				else
+					hi = mid;
+			}
+			auto ranges = GetWrappedLine(buf, lo);
+			size_t sub = visualLine - visualLineStarts[lo];
+			// if the line was estimated to have more visual lines, the requested one is in one of the next lines
+			if (sub < ranges.Size() || lo + 1 >= lineCounts.Size())
+				return ranges[min(sub, ranges.Size() - 1)];
+		}
 	}
 };
 
 struct TextboxImpl
 {
-	std::string text;
-	std::string placeholder;
+	TextBuffer text;
+	TextBuffer placeholder;
 	size_t origStartCursor = 0;
 	size_t startCursor = 0;
 	size_t endCursor = 0;
@@ -119,7 +262,25 @@ struct TextboxImpl
 	bool multiline = false;
 	unsigned lastPressRepeatCount = 0;
 
-	TextLines lines;
+	TextWrapCache textWrap;
+	TextWrapCache placeholderWrap;
+	std::string tmp;
+	std::string selectionTmp;
+
+	void InsertText(size_t pos, StringView s)
+	{
+		size_t line = text.FindLine(pos);
+		size_t numLines = text.GetLineCount();
+		text.Insert(pos, s);
+		textWrap.OnEdit(line, 0, text.GetLineCount() - numLines);
+	}
+	void EraseText(size_t pos, size_t n)
+	{
+		size_t line = text.FindLine(pos);
+		size_t numLines = text.GetLineCount();
+		text.Erase(pos, n);
+		textWrap.OnEdit(line, numLines - text.GetLineCount(), 0);
+	}
 };
 
 Textbox::Textbox()
@@ -139,7 +300,8 @@ void Textbox::OnReset()
 	flags |= UIObject_IsFocusable | UIObject_DB_CaptureMouseOnLeftClick;
 	SetDefaultFrameStyle(DefaultFrameStyle::TextBox);
 
-	_impl->placeholder = {};
+	_impl->placeholder.Clear();
+	_impl->placeholderWrap.Invalidate();
 }
 
 void Textbox::OnPaint(const UIPaintContext& ctx)
@@ -149,19 +311,36 @@ void Textbox::OnPaint(const UIPaintContext& ctx)
 	auto* font = frameStyle.font.GetFont();
 	int size = frameStyle.font.size;
 
-	bool usePlaceholder = !IsFocused() && _impl->text.empty();
-	StringView text = usePlaceholder ? _impl->placeholder : _impl->text;
+	bool usePlaceholder = !IsFocused() && _impl->text.IsEmpty();
+	auto& text = usePlaceholder ? _impl->placeholder : _impl->text;
+	auto& wrap = usePlaceholder ? _impl->placeholderWrap : _impl->textWrap;
 	auto textColor = usePlaceholder ? Color4b(255, 128) : cpa.HasTextColor() ? cpa.GetTextColor() : Color4b::White(); // TODO to theme
-	_impl->lines.Recalculate(text, font, size, GetContentRect().GetWidth(), _impl->multiline);
 	{
 		auto r = GetContentRect();
-		float y = r.y0;
-		for (TextRange line : _impl->lines.lines)
+		wrap.Update(text, font, size, r.GetWidth(), _impl->multiline);
+
+		// only the lines that intersect the clip rect are painted
+		size_t numLines = wrap.GetVisualLineCount(text);
+		size_t firstLine = 0;
+		size_t endLine = 0;
+		AABB2f clip = r.Intersect(draw::GetCurrentScissorRectF());
+		if (clip.IsValid() && size > 0)
 		{
-			draw::TextLine(font, size, r.x0, y, line.sv(text).rtrim(), textColor, TextBaseline::Top, &r);
-			y += size;
+			firstLine = size_t(max(0.0f, floorf((clip.y0 - r.y0) / size)));
+			endLine = size_t(max(0.0f, ceilf((clip.y1 - r.y0) / size)));
 		}
 
+		// the painted lines are wrapped here, which can change the estimated line count
+		for (size_t line = firstLine; line < endLine && line < wrap.GetVisualLineCount(text); line++)
+		{
+			TextRange L = wrap.GetVisualLine(text, line);
+			StringView lineText = text.GetRange(L.start, L.end - L.start, _impl->tmp);
+			draw::TextLine(font, size, r.x0, r.y0 + line * size, lineText.rtrim(), textColor, TextBaseline::Top, &r);
+		}
+		endLine = min(endLine, wrap.GetVisualLineCount(text));
+		if (wrap.GetVisualLineCount(text) != numLines)
+			_OnChangeStyle();
+
 		if (IsFocused())
 		{
 			auto startCursor = _impl->startCursor;
@@ -171,16 +350,16 @@ void Textbox::OnPaint(const UIPaintContext& ctx)
 			{
 				size_t minpos = startCursor < endCursor ? startCursor : endCursor;
 				size_t maxpos = startCursor > endCursor ? startCursor : endCursor;
-				size_t minline = _impl->lines.FindLine(minpos);
-				size_t maxline = _impl->lines.FindLine(maxpos);
-				for (size_t line = minline; line <= maxline; line++)
+				size_t minline = max(wrap.FindVisualLine(text, minpos), firstLine);
+				size_t maxline = min(wrap.FindVisualLine(text, maxpos) + 1, endLine);
+				for (size_t line = minline; line < maxline; line++)
 				{
-					auto L = _impl->lines.lines[line];
+					auto L = wrap.GetVisualLine(text, line);
 					size_t minLpos = ui::max(L.start, minpos);
 					size_t maxLpos = ui::min(L.end, maxpos);
 
-					float x0 = GetTextWidth(font, size, text.substr(L.start, minLpos - L.start));
-					float x1 = GetTextWidth(font, size, text.substr(L.start, maxLpos - L.start));
+					float x0 = GetTextWidth(font, size, text.GetRange(L.start, minLpos - L.start, _impl->tmp));
+					float x1 = GetTextWidth(font, size, text.GetRange(L.start, maxLpos - L.start, _impl->tmp));
 					float y = r.y0 + line * size;
 
 					AABB2f hlrect = { r.x0 + x0, y, r.x0 + x1, y + size };
@@ -192,12 +371,12 @@ void Textbox::OnPaint(const UIPaintContext& ctx)
 
 			if (_impl->showCaretState)
 			{
-				size_t line = _impl->lines.FindLine(endCursor);
+				size_t line = wrap.FindVisualLine(text, endCursor);
 				float x = 0;
-				if (line < _impl->lines.lines.Size())
+				if (line >= firstLine && line < endLine)
 				{
-					auto L = _impl->lines.lines[line];
-					x = GetTextWidth(font, size, text.substr(L.start, endCursor - L.start));
+					auto L = wrap.GetVisualLine(text, line);
+					x = GetTextWidth(font, size, text.GetRange(L.start, endCursor - L.start, _impl->tmp));
 				}
 				float y = r.y0 + line * size;
 				if (r.Contains(Vec2f(r.x0 + x, y)))
@@ -209,31 +388,9 @@ void Textbox::OnPaint(const UIPaintContext& ctx)
 	PaintChildren(ctx, cpa);
 }
 
-static size_t PrevChar(StringView str, size_t pos)
+static int GetCharClass(const TextBuffer& str, size_t pos)
 {
-	if (pos == 0)
-		return 0;
-	pos--;
-	while (pos > 0 && (str[pos] & 0xC0) == 0x80)
-		pos--;
-	return pos;
-}
-
-static size_t NextChar(StringView str, size_t pos)
-{
-	if (pos == str.size())
-		return pos;
-	pos++;
-	while (pos < str.size() && (str[pos] & 0xC0) == 0x80)
-		pos++;
-	return pos;
-}
-
-static int GetCharClass(StringView str, size_t pos)
-{
-	UTF8Iterator it(str);
-	it.pos = pos;
-	uint32_t c = it.Read();
+	uint32_t c = str.ReadChar(pos);
 
 	// TODO full unicode
 	if (IsSpace(c)) // (ASCII)
@@ -254,16 +411,16 @@ static bool IsWordBreak(int cca, int ccb)
 	return true;
 }
 
-static size_t PrevWord(StringView str, size_t pos)
+static size_t PrevWord(const TextBuffer& str, size_t pos)
 {
 	if (pos == 0)
 		return 0;
 
-	pos = PrevChar(str, pos);
+	pos = str.PrevCharPos(pos);
 	auto pcc = GetCharClass(str, pos);
 	while (pos > 0)
 	{
-		size_t npp = PrevChar(str, pos);
+		size_t npp = str.PrevCharPos(pos);
 		auto ncc = GetCharClass(str, npp);
 		if (IsWordBreak(ncc, pcc))
 			break;
@@ -273,20 +430,20 @@ static size_t PrevWord(StringView str, size_t pos)
 	return pos;
 }
 
-static size_t NextWord(StringView str, size_t pos)
+static size_t NextWord(const TextBuffer& str, size_t pos)
 {
-	if (pos == str.size())
+	if (pos == str.Size())
 		return pos;
 
 	auto pcc = GetCharClass(str, pos);
-	pos = NextChar(str, pos);
-	while (pos < str.size())
+	pos = str.NextCharPos(pos);
+	while (pos < str.Size())
 	{
 		auto ncc = GetCharClass(str, pos);
 		if (IsWordBreak(pcc, ncc))
 			break;
 		pcc = ncc;
-		pos = NextChar(str, pos);
+		pos = str.NextCharPos(pos);
 	}
 	return pos;
 }
@@ -300,7 +457,7 @@ static void UpdateSelection(Textbox& tb, Event& e, bool start)
 	auto& endCursor = tb._impl->endCursor;
 	auto& text = tb._impl->text;
 
-	tb._impl->lines.Recalculate(text, tb.frameStyle.font.GetFont(), tb.frameStyle.font.size, tb.GetContentRect().GetWidth(), tb._impl->multiline);
+	tb._impl->textWrap.Update(text, tb.frameStyle.font.GetFont(), tb.frameStyle.font.size, tb.GetContentRect().GetWidth(), tb._impl->multiline);
 
 	if (start)
 	{
@@ -323,7 +480,7 @@ static void UpdateSelection(Textbox& tb, Event& e, bool start)
 	else
 	{
 		startCursor = 0;
-		endCursor = text.size();
+		endCursor = text.Size();
 	}
 }
 
@@ -366,7 +523,7 @@ void Textbox::OnEvent(Event& e)
 		_impl->showCaretState = true;
 		GetNativeWindow()->InvalidateAll(); // TODO localized
 		startCursor = 0;
-		endCursor = text.size();
+		endCursor = text.Size();
 		e.context->SetTimer(this, 0.5f);
 	}
 	else if (e.type == EventType::LostFocus)
@@ -395,7 +552,7 @@ void Textbox::OnEvent(Event& e)
 			}
 			else
 			{
-				endCursor = PrevChar(text, endCursor);
+				endCursor = text.PrevCharPos(endCursor);
 				if (!e.GetKeyActionModifier())
 					startCursor = endCursor;
 			}
@@ -407,7 +564,7 @@ void Textbox::OnEvent(Event& e)
 			}
 			else
 			{
-				endCursor = NextChar(text, endCursor);
+				endCursor = text.NextCharPos(endCursor);
 				if (!e.GetKeyActionModifier())
 					startCursor = endCursor;
 			}
@@ -432,7 +589,7 @@ void Textbox::OnEvent(Event& e)
 			break;
 		case KeyAction::GoToLineEnd:
 		case KeyAction::GoToEnd:
-			endCursor = text.size();
+			endCursor = text.Size();
 			if (!e.GetKeyActionModifier())
 				startCursor = endCursor;
 			break;
@@ -451,7 +608,7 @@ void Textbox::OnEvent(Event& e)
 			break;
 		case KeyAction::SelectAll:
 			startCursor = 0;
-			endCursor = text.size();
+			endCursor = text.Size();
 			break;
 		}
 
@@ -473,22 +630,22 @@ void Textbox::OnEvent(Event& e)
 					switch (e.GetKeyAction())
 					{
 					case KeyAction::DelPrevLetter:
-						to = PrevChar(text, endCursor);
-						text.erase(to, endCursor - to);
+						to = text.PrevCharPos(endCursor);
+						_impl->EraseText(to, endCursor - to);
 						startCursor = endCursor = to;
 						break;
 					case KeyAction::DelNextLetter:
-						to = NextChar(text, endCursor);
-						text.erase(endCursor, to - endCursor);
+						to = text.NextCharPos(endCursor);
+						_impl->EraseText(endCursor, to - endCursor);
 						break;
 					case KeyAction::DelPrevWord:
 						to = PrevWord(text, endCursor);
-						text.erase(to, endCursor - to);
+						_impl->EraseText(to, endCursor - to);
 						startCursor = endCursor = to;
 						break;
 					case KeyAction::DelNextWord:
 						to = NextWord(text, endCursor);
-						text.erase(endCursor, to - endCursor);
+						_impl->EraseText(endCursor, to - endCursor);
 						break;
 					}
 				}
@@ -528,14 +685,15 @@ EstSizeRange Textbox::CalcEstimatedWidth(const Size2f& containerSize, EstSizeTyp
 
 EstSizeRange Textbox::CalcEstimatedHeight(const Size2f& containerSize, EstSizeType type)
 {
-	bool usePlaceholder = !IsFocused() && _impl->text.empty();
-	StringView text = usePlaceholder ? _impl->placeholder : _impl->text;
+	bool usePlaceholder = !IsFocused() && _impl->text.IsEmpty();
+	auto& text = usePlaceholder ? _impl->placeholder : _impl->text;
+	auto& wrap = usePlaceholder ? _impl->placeholderWrap : _impl->textWrap;
 	float maxWidth = GetContentRect().GetWidth();
 	if (maxWidth <= 0)
 		maxWidth = containerSize.x - frameStyle.padding.x0 - frameStyle.padding.x1;
-	_impl->lines.Recalculate(text, frameStyle.font.GetFont(), frameStyle.font.size, maxWidth, _impl->multiline);
+	wrap.Update(text, frameStyle.font.GetFont(), frameStyle.font.size, maxWidth, _impl->multiline);
 
-	float minHeight = frameStyle.font.size * ui::max(size_t(1), _impl->lines.lines.size());
+	float minHeight = frameStyle.font.size * ui::max(size_t(1), wrap.GetVisualLineCount(text));
 
 	minHeight += frameStyle.padding.y0 + frameStyle.padding.y1;
 	return FrameElement::CalcEstimatedHeight(containerSize, type).WithSoftMin(minHeight);
@@ -561,16 +719,16 @@ StringView Textbox::GetSelectedText() const
 {
 	auto startCursor = _impl->startCursor;
 	auto endCursor = _impl->endCursor;
-	int min = startCursor < endCursor ? startCursor : endCursor;
-	int max = startCursor > endCursor ? startCursor : endCursor;
-	return StringView(_impl->text.data() + min, max - min);
+	size_t min = startCursor < endCursor ? startCursor : endCursor;
+	size_t max = startCursor > endCursor ? startCursor : endCursor;
+	return _impl->text.GetRange(min, max - min, _impl->selectionTmp);
 }
 
 void Textbox::EnterText(const char* str)
 {
 	EraseSelection();
 	size_t num = strlen(str);
-	_impl->text.insert(_impl->endCursor, str, num);
+	_impl->InsertText(_impl->endCursor, StringView(str, num));
 	_impl->startCursor = _impl->endCursor += num;
 
 	_OnChangeStyle();
@@ -586,21 +744,24 @@ void Textbox::EraseSelection()
 		auto& endCursor = _impl->endCursor;
 		int min = startCursor < endCursor ? startCursor : endCursor;
 		int max = startCursor > endCursor ? startCursor : endCursor;
-		_impl->text.erase(min, max - min);
+		_impl->EraseText(min, max - min);
 		startCursor = endCursor = min;
 	}
 }
 
 size_t Textbox::_FindCursorPos(Point2f vp)
 {
-	if (_impl->text.empty())
+	if (_impl->text.IsEmpty())
 		return 0;
 
+	auto& text = _impl->text;
+	auto& wrap = _impl->textWrap;
 	auto r = GetContentRect();
-	size_t line = vp.y < r.y0 ? 0 : min(size_t(floorf((vp.y - r.y0) / frameStyle.font.size)), _impl->lines.lines.size() - 1);
-	auto L = _impl->lines.lines[line];
+	size_t numLines = wrap.GetVisualLineCount(text);
+	size_t line = vp.y < r.y0 ? 0 : min(size_t(floorf((vp.y - r.y0) / frameStyle.font.size)), numLines - 1);
+	auto L = wrap.GetVisualLine(text, line);
 
-	auto lineText = L.sv(_impl->text);
+	auto lineText = text.GetRange(L.start, L.end - L.start, _impl->tmp);
 	if (lineText.ends_with("\n"))
 	{
 		lineText = lineText.substr(0, lineText.size() - 1);
@@ -636,7 +797,7 @@ size_t Textbox::_FindCursorPos(Point2f vp)
 
 const std::string& Textbox::GetText() const
 {
-	return _impl->text;
+	return _impl->text.GetString();
 }
 
 Textbox& Textbox::SetText(StringView s)
@@ -644,17 +805,23 @@ Textbox& Textbox::SetText(StringView s)
 	if (InUse())
 		return *this;
 	auto& text = _impl->text;
-	text <<= s;
-	if (_impl->startCursor > text.size())
-		_impl->startCursor = text.size();
-	if (_impl->endCursor > text.size())
-		_impl->endCursor = text.size();
+	// avoid resetting the line cache if the text is rebuilt unchanged
+	if (!text.Equals(s))
+	{
+		text.Assign(s);
+		_impl->textWrap.Invalidate();
+	}
+	if (_impl->startCursor > text.Size())
+		_impl->startCursor = text.Size();
+	if (_impl->endCursor > text.Size())
+		_impl->endCursor = text.Size();
 	return *this;
 }
 
 Textbox& Textbox::SetPlaceholder(StringView s)
 {
-	_impl->placeholder <<= s;
+	_impl->placeholder.Assign(s);
+	_impl->placeholderWrap.Invalidate();
 	return *this;
 }
 
@@ -21,12 +21,14 @@ struct Textbox : FrameElement
 	Textbox& SetMultiline(bool ml);
 
 	bool IsLongSelection() const;
+	// valid until the next call or edit
 	StringView GetSelectedText() const;
 	void EnterText(const char* str);
 	void EraseSelection();
 
 	size_t _FindCursorPos(Point2f vp);
 
+	// the text is stored in pieces, this joins them on the first call after an edit
 	const std::string& GetText() const;
 	Textbox& SetText(StringView s);
 	Textbox& SetPlaceholder(StringView s);
@@ -1,6 +1,7 @@
 
 #pragma once
 #include "Model/Objects.h"
+#include "Core/SmallArray.h"
 
 
 namespace ui {
@@ -17,7 +18,8 @@ struct ListLayoutElementBase : UIObject
 {
 	using Slot = SlotT;
 
-	Array<Slot> _slots;
+	// most lists only have a few children
+	SmallArray<Slot, 4> _slots;
 
 	// size cache
 	uint32_t _cacheFrameWidth = {};
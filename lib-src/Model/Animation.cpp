@@ -29,12 +29,12 @@ void AnimPlayer::StopAllAnims()
 	EndAnimation();
 }
 
-float AnimPlayer::GetVariable(const std::string& name, float def) const
+float AnimPlayer::GetVariable(Atom name, float def) const
 {
 	return _variables.GetValueOrDefault(name, def);
 }
 
-void AnimPlayer::SetVariable(const std::string& name, float value)
+void AnimPlayer::SetVariable(Atom name, float value)
 {
 	_variables.Insert(name, value);
 }
@@ -2,6 +2,7 @@
 #pragma once
 
 #include "../Core/Array.h"
+#include "../Core/Atom.h"
 #include "../Core/HashMap.h"
 #include "Native.h" // TODO
 
@@ -12,8 +13,8 @@ namespace ui {
 
 struct IAnimState
 {
-	virtual float GetVariable(const std::string& name, float def = 0) const = 0;
-	virtual void SetVariable(const std::string& name, float value) = 0;
+	virtual float GetVariable(Atom name, float def = 0) const = 0;
+	virtual void SetVariable(Atom name, float value) = 0;
 };
 
 struct Animation : RefCountedMT
@@ -29,14 +30,14 @@ struct AnimPlayer : IAnimState, protected AnimationRequester
 	void PlayAnim(const AnimPtr& anim);
 	void StopAnim(const AnimPtr& anim);
 	void StopAllAnims();
-	float GetVariable(const std::string& name, float def = 0) const;
-	void SetVariable(const std::string& name, float value);
+	float GetVariable(Atom name, float def = 0) const;
+	void SetVariable(Atom name, float value);
 
 	void OnAnimationFrame() override;
 
 	std::function<void()> onAnimUpdate;
 
-	HashMap<std::string, float> _variables;
+	HashMap<Atom, float> _variables;
 	Array<AnimPtr> _activeAnims;
 	uint32_t _prevTime;
 };
@@ -93,7 +94,7 @@ struct EasingAnimation : Animation
 
 	void _Apply(IAnimState* asrw);
 
-	std::string param;
+	Atom param;
 	float target = 0;
 	float length = 0;
 
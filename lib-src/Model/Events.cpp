@@ -6,6 +6,8 @@
 #include "Native.h"
 #include "System.h"
 
+#include "../Core/Profiler.h"
+
 
 namespace ui {
 
@@ -201,6 +203,7 @@ static void RemoveTimer(Array<TimerData>& timers, size_t& i, size_t& count)
 
 float EventSystem::ProcessTimers(float dt)
 {
+	UI_PROFILE_ZONE("Timers");
 	float minTime = FLT_MAX;
 	size_t endOfInitialTimers = pendingTimers.size();
 	for (size_t i = 0; i < endOfInitialTimers; i++)
@@ -495,6 +498,7 @@ void EventSystem::_UpdateTooltip(Point2f cursorPos)
 
 void EventSystem::OnMouseMove(Point2f cursorPos, uint8_t mod)
 {
+	UI_PROFILE_ZONE_DETAIL("Event", "MouseMove");
 	bool moved = cursorPos != prevMousePos;
 	if (moved)
 	{
@@ -581,6 +585,7 @@ static UIObject* FindSharedUIObject(UIObject* a, UIObject* b)
 
 void EventSystem::OnMouseButton(bool down, MouseButton which, Point2f cursorPos, uint8_t mod)
 {
+	UI_PROFILE_ZONE_DETAIL("Event", "MouseButton");
 	int id = int(which);
 	uint32_t t = platform::GetTimeMs();
 
@@ -709,6 +714,7 @@ void EventSystem::OnMouseButton(bool down, MouseButton which, Point2f cursorPos,
 
 void EventSystem::OnMouseScroll(Vec2f delta, u8 mod)
 {
+	UI_PROFILE_ZONE_DETAIL("Event", "MouseScroll");
 	if (hoverObj)
 	{
 		Event e(this, hoverObj, EventType::MouseScroll);
@@ -721,6 +727,7 @@ void EventSystem::OnMouseScroll(Vec2f delta, u8 mod)
 
 bool EventSystem::OnKeyInput(bool down, uint32_t vk, uint8_t pk, uint8_t mod, bool isRepeated, uint16_t numRepeats)
 {
+	UI_PROFILE_ZONE_DETAIL("Event", "KeyInput");
 	if (focusObj)
 	{
 		Event ev(this, focusObj, down ? EventType::KeyDown : EventType::KeyUp);
@@ -737,6 +744,7 @@ bool EventSystem::OnKeyInput(bool down, uint32_t vk, uint8_t pk, uint8_t mod, bo
 
 bool EventSystem::OnKeyAction(KeyAction act, uint8_t mod, uint16_t numRepeats, bool modifier)
 {
+	UI_PROFILE_ZONE_DETAIL("Event", "KeyAction");
 	Event ev(this, focusObj, EventType::KeyAction);
 	if (focusObj)
 	{
@@ -805,6 +813,7 @@ bool EventSystem::OnKeyAction(KeyAction act, uint8_t mod, uint16_t numRepeats, b
 
 void EventSystem::OnTextInput(uint32_t ch, uint8_t mod, uint16_t numRepeats)
 {
+	UI_PROFILE_ZONE_DETAIL("Event", "TextInput");
 	if (focusObj)
 	{
 		Event ev(this, focusObj, EventType::TextInput);
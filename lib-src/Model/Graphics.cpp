@@ -356,17 +356,20 @@ void HueSatPicker::_RegenerateBackground(int w)
 	float cx = w / 2.0f;
 	float cy = h / 2.0f;
 	float dmax = w / 2.0f;
-	for (int y = 0; y < h; y++)
+	ParallelForImageLines(h, w, [=](size_t y0, size_t y1)
 	{
-		for (int x = 0; x < w; x++)
+		for (int y = int(y0); y < int(y1); y++)
 		{
-			float d = sqrtf((x - cx) * (x - cx) + (y - cy) * (y - cy));
-			float alpha = clamp((d - dmax) * -1, 0.0f, 1.0f);
-			float angle = fmodf(atan2(x - cx, cy - y) / (3.14159f * 2) + 1.0f, 1.0f);
-			Color4f col = Color4f::HSV(angle, d / dmax, 1.0f, alpha);
-			px[x + y * w] = col.GetColor32();
+			for (int x = 0; x < w; x++)
+			{
+				float d = sqrtf((x - cx) * (x - cx) + (y - cy) * (y - cy));
+				float alpha = clamp((d - dmax) * -1, 0.0f, 1.0f);
+				float angle = fmodf(atan2(x - cx, cy - y) / (3.14159f * 2) + 1.0f, 1.0f);
+				Color4f col = Color4f::HSV(angle, d / dmax, 1.0f, alpha);
+				px[x + y * w] = col.GetColor32();
+			}
 		}
-	}
+	});
 
 	_bgImage = draw::ImageCreateFromCanvas(c);
 }
@@ -439,53 +442,56 @@ void ColorCompPicker2D::_RegenerateBackground(int w, int h)
 	Canvas c(w, h);
 	auto* px = c.GetPixels();
 
-	for (int y = 0; y < h; y++)
+	ParallelForImageLines(h, w, [this, px, w, h](size_t y0, size_t y1)
 	{
-		for (int x = 0; x < w; x++)
+		for (int y = int(y0); y < int(y1); y++)
 		{
-			float fx = x / float(w);
-			float fy = y / float(h);
-			if (_settings._invx)
-				fx = 1 - fx;
-			if (_settings._invy)
-				fy = 1 - fy;
-			Color4f c = _settings._baseColor;
-			switch (_settings._mode)
+			for (int x = 0; x < w; x++)
 			{
-			case CM_RGB:
-				switch (_settings._ccx)
-				{
-				case CC_Red: c.r = fx; break;
-				case CC_Green: c.g = fx; break;
-				case CC_Blue: c.b = fx; break;
-				}
-				switch (_settings._ccy)
-				{
-				case CC_Red: c.r = fy; break;
-				case CC_Green: c.g = fy; break;
-				case CC_Blue: c.b = fy; break;
-				}
-				break;
-			case CM_HSV: {
-				float h = 0, s = 1, v = 1;
-				switch (_settings._ccx)
-				{
-				case CC_Hue: h = fx; break;
-				case CC_Sat: s = fx; break;
-				case CC_Val: v = fx; break;
-				}
-				switch (_settings._ccy)
+				float fx = x / float(w);
+				float fy = y / float(h);
+				if (_settings._invx)
+					fx = 1 - fx;
+				if (_settings._invy)
+					fy = 1 - fy;
+				Color4f c = _settings._baseColor;
+				switch (_settings._mode)
 				{
-				case CC_Hue: h = fy; break;
-				case CC_Sat: s = fy; break;
-				case CC_Val: v = fy; break;
+				case CM_RGB:
+					switch (_settings._ccx)
+					{
+					case CC_Red: c.r = fx; break;
+					case CC_Green: c.g = fx; break;
+					case CC_Blue: c.b = fx; break;
+					}
+					switch (_settings._ccy)
+					{
+					case CC_Red: c.r = fy; break;
+					case CC_Green: c.g = fy; break;
+					case CC_Blue: c.b = fy; break;
+					}
+					break;
+				case CM_HSV: {
+					float h = 0, s = 1, v = 1;
+					switch (_settings._ccx)
+					{
+					case CC_Hue: h = fx; break;
+					case CC_Sat: s = fx; break;
+					case CC_Val: v = fx; break;
+					}
+					switch (_settings._ccy)
+					{
+					case CC_Hue: h = fy; break;
+					case CC_Sat: s = fy; break;
+					case CC_Val: v = fy; break;
+					}
+					c = Color4f::HSV(h, s, v, c.a);
+					break; }
 				}
-				c = Color4f::HSV(h, s, v, c.a);
-				break; }
+				px[x + y * w] = c.GetColor32();
 			}
-			px[x + y * w] = c.GetColor32();
 		}
-	}
+	});
 
 	_bgImage = draw::ImageCreateFromCanvas(c);
 	_curImgSettings = _settings;
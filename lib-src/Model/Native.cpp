@@ -23,6 +23,7 @@
 #include "../Render/RenderText.h"
 #include "../Core/WindowsUtils.h"
 #include "../Core/FileSystem.h"
+#include "../Core/Profiler.h"
 
 
 #define WINDOW_CLASS_NAME L"UIWindow"
@@ -634,6 +635,66 @@ void NativeWindowGeometry::OnSerialize(IObjectIterator& oi, const FieldInfo& FI)
 
 MulticastDelegate<NativeWindowBase*> OnWindowResized;
 MulticastDelegate<const WindowKeyEvent&> OnWindowKeyEvent;
+MulticastDelegate<NativeWindowBase*, const FrameStats&> OnFrameStats;
+
+std::string FrameStats::ToString() const
+{
+	return Format(
+		"frame %" PRIu64 ": %.2f ms (build %.2f, layout %.2f, paint %.2f)\n"
+		"built %u, laid out %u, painted %u\n"
+		"draw calls %u, vertices %u, indices %u\n"
+		"texture switches %u, atlas uploads %u\n"
+		"glyphs rasterized %u, pending %u",
+		frameID, frameTime, buildTime, layoutTime, paintTime,
+		numBuilt, numLaidOut, numPainted,
+		numDrawCalls, numVertices, numIndices,
+		numTextureSwitches, numTextureUploads,
+		numGlyphsRasterized, numGlyphsPending);
+}
+
+struct FrameStatTotals
+{
+	UICounters ui;
+	gfx::Stats gfx;
+	u64 numGlyphsRasterized;
+
+	static FrameStatTotals Get()
+	{
+		return { g_uiCounters, gfx::Stats::Get(), GetNumRasterizedGlyphs() };
+	}
+};
+// work done between frames is counted in the next frame of any window
+static FrameStatTotals g_lastFrameEndTotals;
+
+static bool ReadFrameStatsOverlayDefault()
+{
+	const char* value = getenv("UI_FRAME_STATS_OVERLAY");
+	return value && !strcmp(value, "1");
+}
+static bool g_frameStatsOverlayDefault = ReadFrameStatsOverlayDefault();
+
+static void DrawFrameStatsOverlay(const FrameStats& fs, float windowWidth)
+{
+	constexpr int FONT_SIZE = 12;
+	constexpr float LINE_HEIGHT = 14;
+	constexpr float PADDING = 4;
+
+	Font* font = GetFont(FONT_FAMILY_MONOSPACE);
+	std::string text = fs.ToString();
+
+	float width = 0;
+	int numLines = 0;
+	for (StringView rem = text; !rem.IsEmpty(); numLines++)
+	{
+		auto split = rem.SplitFirst("\n");
+		width = max(width, GetTextWidth(font, FONT_SIZE, split.before));
+		rem = split.after;
+	}
+
+	AABB2f rect = { windowWidth - width - PADDING * 2, 0, windowWidth, numLines * LINE_HEIGHT + PADDING * 2 };
+	draw::RectCol(rect, Color4b(0, 192));
+	draw::TextMultiline(font, FONT_SIZE, rect.ExtendBy(-PADDING), LINE_HEIGHT, text, Color4b::White());
+}
 
 
 static LRESULT CALLBACK WindowProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam);
@@ -897,6 +958,7 @@ struct NativeWindow_Impl
 		if (!innerUIEnabled)
 			return;
 
+		UI_PROFILE_ZONE("Redraw");
 		double t = hqtime();
 
 		gfx::BeginFrame(renderCtx);
@@ -921,10 +983,7 @@ struct NativeWindow_Impl
 			cont.ProcessBuildStack();
 		cont.ProcessLayoutStack();
 
-#if DRAW_STATS
-		double t0 = hqtime();
-		auto stats0 = gfx::Stats::Get();
-#endif
+		double tPaint0 = hqtime();
 
 		gfx::SetActiveContext(renderCtx);
 		gfx::SetViewport(0, 0, evsys.width, evsys.height);
@@ -933,13 +992,16 @@ struct NativeWindow_Impl
 
 		auto clearColor = GetCurrentTheme()->GetBackgroundColor(sid_color_clear);
 		gfx::Clear(clearColor.r, clearColor.g, clearColor.b, 255);
-		if (cont.rootBuildable)
-			cont.rootBuildable->RootPaint();
+		{
+			UI_PROFILE_ZONE("Paint");
+			if (cont.rootBuildable)
+				cont.rootBuildable->RootPaint();
 
-		system.overlays.UpdateSorted();
-		for (auto* ovr : system.overlays.sorted)
-			if (ovr->_child)
-				ovr->_child->RootPaint();
+			system.overlays.UpdateSorted();
+			for (auto* ovr : system.overlays.sorted)
+				if (ovr->_child)
+					ovr->_child->RootPaint();
+		}
 
 		if (debugDrawEnabled)
 		{
@@ -963,17 +1025,12 @@ struct NativeWindow_Impl
 		}
 #endif
 
+		if (frameStatsOverlayEnabled)
+			DrawFrameStatsOverlay(lastFrameStats, evsys.width);
+
 		draw::_::OnEndDrawFrame();
 
-#if DRAW_STATS
-		double t1 = hqtime();
-		auto stats1 = gfx::Stats::Get();
-		auto statsdiff = stats1 - stats0;
-		printf("render time: %g ms\n", (t1 - t0) * 1000);
-		printf("# SetTexture: %u\n", unsigned(statsdiff.num_SetTexture));
-		printf("# DrawTriangles: %u\n", unsigned(statsdiff.num_DrawTriangles));
-		printf("# DrawIndexedTriangles: %u\n", unsigned(statsdiff.num_DrawIndexedTriangles));
-#endif
+		double tPaint1 = hqtime();
 
 #if DEBUG_DRAW_ATLAS
 		if (int count = draw::debug::GetAtlasTextureCount())
@@ -1005,7 +1062,39 @@ struct NativeWindow_Impl
 		}
 #endif
 
-		gfx::EndFrame(renderCtx);
+		{
+			UI_PROFILE_ZONE("EndFrame");
+			gfx::EndFrame(renderCtx);
+		}
+
+		UpdateFrameStats(t, tPaint1 - tPaint0);
+	}
+
+	void UpdateFrameStats(double frameStartTime, double paintTime)
+	{
+		auto cur = FrameStatTotals::Get();
+		const auto& prev = g_lastFrameEndTotals;
+		auto gfxDiff = cur.gfx - prev.gfx;
+
+		FrameStats& fs = lastFrameStats;
+		fs.frameID++;
+		fs.frameTime = float((hqtime() - frameStartTime) * 1000);
+		fs.buildTime = float((cur.ui.buildTime - prev.ui.buildTime) * 1000);
+		fs.layoutTime = float((cur.ui.layoutTime - prev.ui.layoutTime) * 1000);
+		fs.paintTime = float(paintTime * 1000);
+		fs.numBuilt = u32(cur.ui.numBuilt - prev.ui.numBuilt);
+		fs.numLaidOut = u32(cur.ui.numLaidOut - prev.ui.numLaidOut);
+		fs.numPainted = u32(cur.ui.numPainted - prev.ui.numPainted);
+		fs.numDrawCalls = u32(gfxDiff.num_DrawTriangles + gfxDiff.num_DrawIndexedTriangles);
+		fs.numVertices = u32(gfxDiff.num_Vertices);
+		fs.numIndices = u32(gfxDiff.num_Indices);
+		fs.numTextureSwitches = u32(gfxDiff.num_SetTexture);
+		fs.numTextureUploads = u32(gfxDiff.num_TextureRectUploads);
+		fs.numGlyphsRasterized = u32(cur.numGlyphsRasterized - prev.numGlyphsRasterized);
+		fs.numGlyphsPending = u32(GetNumPendingGlyphs());
+		g_lastFrameEndTotals = cur;
+
+		OnFrameStats.Call(GetOwner(), fs);
 	}
 
 	void UpdateVisibilityState()
@@ -1093,6 +1182,8 @@ struct NativeWindow_Impl
 	u16 curScaleW = 0, curScaleH = 0;
 	Optional<gfx::ExclusiveFullscreenInfo> exclFSInfo;
 	bool debugDrawEnabled = false;
+	bool frameStatsOverlayEnabled = g_frameStatsOverlayDefault;
+	FrameStats lastFrameStats = {};
 	bool firstShow = true;
 	bool invalidated = false;
 	uint8_t sysMoveSizeState = MSST_None;
@@ -1452,6 +1543,24 @@ void NativeWindowBase::SetDebugDrawEnabled(bool enabled)
 	_impl->debugDrawEnabled = enabled;
 }
 
+FrameStats NativeWindowBase::GetLastFrameStats()
+{
+	return _impl->lastFrameStats;
+}
+
+bool NativeWindowBase::IsFrameStatsOverlayEnabled()
+{
+	return _impl->frameStatsOverlayEnabled;
+}
+
+void NativeWindowBase::SetFrameStatsOverlayEnabled(bool enabled)
+{
+	if (_impl->frameStatsOverlayEnabled == enabled)
+		return;
+	_impl->frameStatsOverlayEnabled = enabled;
+	_impl->GetOwner()->InvalidateAll();
+}
+
 void NativeWindowBase::RebuildRoot()
 {
 	// don't rebuild if the first build hasn't happened yet
@@ -1887,6 +1996,10 @@ Application::~Application()
 	//system.container.Free();
 	UnloadDefaultCursors();
 
+	// workers may still be pushing events
+	StopGlyphRasterizationJobs();
+	ThreadPool::ShutdownGlobal();
+
 	delete g_windowRepaintList;
 	g_windowRepaintList = nullptr;
 	delete g_curWindowRepaintList;
@@ -1943,7 +2056,10 @@ int Application::Run()
 			DispatchMessageW(&msg);
 			g_mayCallWndProc = false;
 
-			g_mainEventQueue->RunAllCurrent();
+			{
+				UI_PROFILE_ZONE("EventQueue");
+				g_mainEventQueue->RunAllCurrent();
+			}
 
 			if (g_appQuit)
 				return g_appExitCode;
@@ -2000,6 +2116,7 @@ void Application::ProcessSystemMessagesNonBlocking()
 
 void Application::ProcessMainEventQueue()
 {
+	UI_PROFILE_ZONE("EventQueue");
 	g_mainEventQueue->RunAllCurrent();
 }
 
@@ -2012,6 +2129,12 @@ void Application::RedrawAllWindows()
 	}
 }
 
+void Application::InvalidateAllWindows()
+{
+	for (auto* win : *g_allWindows)
+		win->GetOwner()->InvalidateAll();
+}
+
 static void AdjustMouseCapture(HWND hWnd, WPARAM wParam)
 {
 	auto w = LOWORD(wParam);
@@ -2506,7 +2629,34 @@ namespace ui {
 } // ui
 int main(int argc, char* argv[])
 {
-	ui::TestStorage::Get().Run();
+	// --profile <file.json> / --profile-bin <file> = record the tests and write a Chrome trace / UIPROF file
+	const char* profileJSONPath = nullptr;
+	const char* profileBinPath = nullptr;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (!strcmp(argv[i], "--profile"))
+			profileJSONPath = argv[++i];
+		else if (!strcmp(argv[i], "--profile-bin"))
+			profileBinPath = argv[++i];
+	}
+
+	if (profileJSONPath || profileBinPath)
+	{
+		ui::ProfilerSetThreadName("Main");
+		ui::ProfilerSetEnabled(true);
+		ui::TestStorage::Get().Run([](ui::TestStorage::Test& T)
+		{
+			UI_PROFILE_ZONE_DETAIL("Test", T.catdotname);
+			T.test->RunTest();
+		});
+		ui::ProfilerSetEnabled(false);
+		if (profileJSONPath && !ui::ProfilerWriteChromeTrace(profileJSONPath))
+			printf("failed to write the profile to %s\n", profileJSONPath);
+		if (profileBinPath && !ui::ProfilerWriteBinary(profileBinPath))
+			printf("failed to write the profile to %s\n", profileBinPath);
+	}
+	else
+		ui::TestStorage::Get().Run();
 	puts("Tests finished!");
 }
 #else
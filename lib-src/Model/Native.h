@@ -89,6 +89,32 @@ struct WindowKeyEvent
 };
 extern MulticastDelegate<const WindowKeyEvent&> OnWindowKeyEvent;
 
+// counts the work done since the previous redraw of any window, times are measured within the redraw
+struct FrameStats
+{
+	u64 frameID; // per window
+
+	// CPU time (ms)
+	float frameTime; // the whole redraw, including presenting
+	float buildTime;
+	float layoutTime;
+	float paintTime; // painting the objects and submitting the draw calls
+
+	u32 numBuilt; // Buildable::Build calls
+	u32 numLaidOut; // UIObject::OnLayout calls
+	u32 numPainted; // objects that weren't culled
+	u32 numDrawCalls;
+	u32 numVertices;
+	u32 numIndices;
+	u32 numTextureSwitches;
+	u32 numTextureUploads; // atlas rects
+	u32 numGlyphsRasterized;
+	u32 numGlyphsPending; // at the end of the frame
+
+	std::string ToString() const;
+};
+extern MulticastDelegate<NativeWindowBase*, const FrameStats&> OnFrameStats;
+
 
 enum class WindowState : uint8_t
 {
@@ -199,6 +225,12 @@ struct NativeWindowBase
 	bool IsDebugDrawEnabled();
 	void SetDebugDrawEnabled(bool enabled);
 
+	FrameStats GetLastFrameStats();
+	// draws the stats of the previous frame in the top right corner
+	// (enabled for all windows by default if the UI_FRAME_STATS_OVERLAY environment variable is set to 1)
+	bool IsFrameStatsOverlayEnabled();
+	void SetFrameStatsOverlayEnabled(bool enabled);
+
 	void RebuildRoot();
 	void InvalidateAll();
 
@@ -363,6 +395,14 @@ public:
 		_GetEventQueue().Push(Move(fw));
 		_SignalEvent();
 	}
+	// runs `job` on the global thread pool, then `then` with its result on the UI thread
+	// - nothing runs if the object is destroyed before the job starts or before `then` is reached
+	// - the job can check ThreadPool::IsCurrentJobCancelled() to stop early when the object is destroyed
+	template <class F, class C>
+	static JobHandle RunJob(UIObject* obj, F&& job, C&& then, JobPriority prio = JobPriority::Normal)
+	{
+		return ThreadPool::Get().RunThenFor(obj->GetLivenessToken(), Move(job), _GetEventQueue(), Move(then), prio, &_SignalEvent);
+	}
 	static EventQueue& _GetEventQueue();
 	static void _SignalEvent();
 
@@ -382,6 +422,7 @@ public:
 	static void ProcessSystemMessagesNonBlocking();
 	static void ProcessMainEventQueue();
 	static void RedrawAllWindows();
+	static void InvalidateAllWindows();
 
 #if 0
 	template <class T> NativeWindow* BuildWithWindow()
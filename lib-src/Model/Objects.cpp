@@ -1,10 +1,12 @@
 
 #include "../Core/HashMap.h"
 #include "Objects.h"
+#include "Layout.h"
 #include "Native.h"
 #include "System.h"
 #include "Theme.h"
 
+#include "../Core/MemoryAccounting.h"
 #include "../Render/RenderText.h"
 
 
@@ -80,11 +82,36 @@ UIObject::~UIObject()
 	assert(!_livenessToken.IsAlive());
 }
 
+void* UIObject::operator new(size_t size)
+{
+	MemTrackAlloc(MemTag::UIObjects, size);
+	return ::operator new(size);
+}
+
+void UIObject::operator delete(void* ptr, size_t size)
+{
+	MemTrackFree(MemTag::UIObjects, size);
+	::operator delete(ptr);
+}
+
+void UIObject::_InvalidateInheritedFontSettings()
+{
+	// a child can only have a cached value if its parent has one, so the cleared subtrees can be skipped
+	if (!_inheritedFontSettingsTheme)
+		return;
+	_inheritedFontSettingsTheme = nullptr;
+	UIObjectIterator it(this);
+	while (UIObject* ch = it.GetNext())
+		ch->_InvalidateInheritedFontSettings();
+}
+
 void UIObject::_DetachFromTree()
 {
 	if (!(flags & UIObject_IsInTree))
 		return;
 
+	_InvalidateInheritedFontSettings();
+
 	if (flags & UIObject_NeedsTreeUpdates)
 		OnExitTree();
 
@@ -116,6 +143,9 @@ void UIObject::PO_ResetConfiguration()
 	flags = UIObject_DB__Defaults | (origFlags & KEEP_MASK);
 
 	_InitReset();
+
+	if ((origFlags ^ flags) & UIObject_SetsChildTextStyle)
+		_InvalidateInheritedFontSettings();
 }
 
 void UIObject::PO_BeforeDelete()
@@ -159,6 +189,7 @@ void UIObject::_AttachToFrameContents(FrameContents* owner)
 		OnEnterTree();
 
 	flags |= UIObject_IsInTree;
+	_InvalidateInheritedFontSettings();
 
 	_OnChangeStyle();
 }
@@ -378,6 +409,7 @@ void UIObject::Paint(const UIPaintContext& ctx)
 	if (!((flags & UIObject_DisableCulling) || draw::GetCurrentScissorRectF().Overlaps(GetFinalRect())))
 		return;
 
+	g_uiCounters.numPainted++;
 	OnPaint(ctx);
 }
 
@@ -416,6 +448,7 @@ void UIObject::PerformLayout(const UIRect& rect, LayoutInfo info)
 	_rcvdLayoutInfo = info;
 	if (_NeedsLayout())
 	{
+		g_uiCounters.numLaidOut++;
 		OnLayout(rect, info);
 		OnLayoutChanged();
 	}
@@ -478,6 +511,7 @@ void UIObject::DetachParent()
 	parent->RemoveChildImpl(this);
 
 	parent = nullptr;
+	_InvalidateInheritedFontSettings();
 }
 
 
@@ -662,13 +696,32 @@ float UIObject::ResolveUnits(Coord coord, float ref)
 
 const FontSettings* UIObject::_FindClosestParentFontSettings() const
 {
-	for (auto* p = parent; p; p = p->parent)
+	auto* theme = GetCurrentTheme();
+	if (_inheritedFontSettingsTheme == theme)
+		return _inheritedFontSettings;
+
+	// the parent's cached value is reused so each object is resolved only once per invalidation
+	// (and always resolved first, so that clearing the parent's value also reaches this one)
+	const FontSettings* fs = nullptr;
+	if (parent)
 	{
-		if (p->flags & UIObject_SetsChildTextStyle)
-			if (auto* fs = p->_GetFontSettings())
-				return fs;
+		fs = parent->_FindClosestParentFontSettings();
+		if (parent->flags & UIObject_SetsChildTextStyle)
+		{
+			if (auto* pfs = parent->_GetFontSettings())
+				fs = pfs;
+		}
 	}
-	return GetCurrentTheme()->FindStructByName<FontSettings>("");
+	else
+		fs = theme->FindStructByName<FontSettings>("");
+
+	// the objects outside the tree are not invalidated when they're moved
+	if (flags & UIObject_IsInTree)
+	{
+		_inheritedFontSettings = fs;
+		_inheritedFontSettingsTheme = theme;
+	}
+	return fs;
 }
 
 const FontSettings* UIObject::_GetFontSettings() const
@@ -946,27 +999,34 @@ void OverlayElement::_DetachFromFrameContents()
 }
 
 
-void TextElement::_UpdateCache()
+void TextElement::_UpdateCache(Font* font, int size)
 {
+	if (_cachedLines && _wrap.IsBuiltFor(font, size))
+		return;
+
 	if (multiline)
 	{
-		_lines.Clear();
+		_wrap.Begin(font, size);
 		StringView it = text;
 		it = it.trim();
 		while (it.NotEmpty())
 		{
 			StringView line = it.UntilFirst("\n").trim();
-			_lines.Append(line);
+			size_t start = line.data() - text.data();
+			_wrap.AddLine(text, start, start + line.size());
 			it = it.AfterFirst("\n");
 		}
-		if (_lines.NotEmpty() && _lines.Last().IsEmpty())
-			_lines.RemoveLast();
+		_textWidth = _wrap.GetUnwrappedWidth();
 	}
 	else
 	{
 		// do not allocate for single line text
-		_lines.Clear();
+		_wrap.font = font;
+		_wrap.size = size;
+		_wrap.scale = GetTextResolutionScale();
+		_textWidth = GetTextWidth(font, size, text);
 	}
+	_linesWidth = -1;
 	_cachedLines = true;
 }
 
@@ -977,23 +1037,29 @@ void TextElement::OnReset()
 	text = {};
 	multiline = false;
 	_cachedLines = false;
+	_linesWidth = -1;
 	_lines.Clear();
 }
 
 void TextElement::OnPaint(const UIPaintContext& ctx)
 {
-	if (!_cachedLines)
-		_UpdateCache();
 	auto* fs = _FindClosestParentFontSettings();
 	auto* font = fs->GetFont();
+	_UpdateCache(font, fs->size);
 
 	auto r = GetFinalRect();
 	if (multiline)
 	{
+		if (_linesWidth != r.GetWidth())
+		{
+			_wrap.GetLines(r.GetWidth(), _lines);
+			_linesWidth = r.GetWidth();
+		}
 		float y = roundf(r.GetCenterY() - (_lines.Size() - 1) * fs->size * 0.5f);
 		for (size_t i = 0; i < _lines.Size(); i++)
 		{
-			draw::TextLine(font, fs->size, r.x0, y, _lines[i], ctx.textColor, TextBaseline::Middle, &r);
+			StringView line = StringView(text).substr(_lines[i].start, _lines[i].end - _lines[i].start);
+			draw::TextLine(font, fs->size, r.x0, y, line, ctx.textColor, TextBaseline::Middle, &r);
 			y += fs->size;
 		}
 	}
@@ -1005,31 +1071,19 @@ void TextElement::OnPaint(const UIPaintContext& ctx)
 
 EstSizeRange TextElement::CalcEstimatedWidth(const Size2f& containerSize, EstSizeType type)
 {
-	if (!_cachedLines)
-		_UpdateCache();
 	auto* fs = _FindClosestParentFontSettings();
-	if (multiline)
-	{
-		float maxw = 0;
-		for (StringView line : _lines)
-			maxw = max(maxw, GetTextWidth(fs->GetFont(), fs->size, line));
-		return EstSizeRange::SoftExact(ceilf(maxw));
-	}
-	else
-	{
-		float w = ceilf(GetTextWidth(fs->GetFont(), fs->size, text));
-		return EstSizeRange::SoftExact(w);
-	}
+	_UpdateCache(fs->GetFont(), fs->size);
+	return EstSizeRange::SoftExact(ceilf(_textWidth));
 }
 
 EstSizeRange TextElement::CalcEstimatedHeight(const Size2f& containerSize, EstSizeType type)
 {
-	if (!_cachedLines)
-		_UpdateCache();
 	auto* fs = _FindClosestParentFontSettings();
+	_UpdateCache(fs->GetFont(), fs->size);
 	if (multiline)
 	{
-		return EstSizeRange::Exact(fs->size * _lines.Size());
+		// wrapped to the available width
+		return EstSizeRange::Exact(fs->size * _wrap.GetLineCount(containerSize.x > 0 ? containerSize.x : -1));
 	}
 	else
 	{
@@ -1279,4 +1333,65 @@ void modAddTooltip::Apply(UIObject* obj) const
 	};
 }
 
+
+#if UI_BUILD_TESTS && UI_MEMORY_ACCOUNTING
+#include "../Core/Test.h"
+
+DEFINE_TEST_CATEGORY(UIObject, 2000);
+
+DEFINE_TEST(UIObject, MemoryAccountingBuildTeardown)
+{
+	static constexpr int NUM_ROWS = 200;
+	static constexpr int NUM_ITEMS = 25;
+	static int numRows = NUM_ROWS;
+
+	auto base = MemGetStats(MemTag::UIObjects);
+	MemTagStats built, rebuilt;
+	{
+		FrameContents fc;
+		auto* root = CreateUIObject<BuildCallback>();
+		root->buildFunc = []()
+		{
+			Push<StackTopDownLayoutElement>();
+			for (int i = 0; i < numRows; i++)
+			{
+				// each row is a separate buildable
+				auto& row = Make<BuildCallback>();
+				row.buildFunc = []()
+				{
+					Push<StackTopDownLayoutElement>();
+					for (int j = 0; j < NUM_ITEMS; j++)
+						Make<SizeConstraintElement>().SetMinWidth(float(j));
+					Pop();
+				};
+			}
+			Pop();
+		};
+		fc.BuildRoot(root, true);
+		built = MemGetStats(MemTag::UIObjects);
+
+		// rebuilding with fewer rows frees the unused objects
+		numRows = NUM_ROWS / 2;
+		fc.container.QueueForRebuild(root);
+		fc.container.ProcessBuildStack();
+		rebuilt = MemGetStats(MemTag::UIObjects);
+		numRows = NUM_ROWS;
+	}
+	auto after = MemGetStats(MemTag::UIObjects);
+
+	// root + stack + rows * (buildable + stack + items)
+	u64 numObjects = 2 + NUM_ROWS * (2 + NUM_ITEMS);
+	ASSERT_EQUAL(true, built.numAllocs == base.numAllocs + numObjects);
+	ASSERT_EQUAL(true, built.numBytes > base.numBytes + numObjects * sizeof(UIObject));
+	ASSERT_EQUAL(true, built.peakBytes >= built.numBytes);
+	ASSERT_EQUAL(true, rebuilt.numAllocs == base.numAllocs + 2 + (NUM_ROWS / 2) * (2 + NUM_ITEMS));
+
+	ASSERT_EQUAL(true, after.numAllocs == base.numAllocs);
+	ASSERT_EQUAL(true, after.numBytes == base.numBytes);
+	ASSERT_EQUAL(true, after.totalAllocs == base.totalAllocs + numObjects);
+	ASSERT_EQUAL(true, after.peakBytes >= built.numBytes);
+}
+
+#endif
+
 } // ui
@@ -15,6 +15,7 @@
 #include "../Core/Font.h"
 
 #include "../Render/Render.h"
+#include "../Render/RenderText.h"
 
 #include "Events.h"
 #include "Painting.h"
@@ -279,6 +280,11 @@ struct UIObject : IPersistentObject
 	UIObject(const UIObject&) = delete;
 	virtual ~UIObject();
 
+	// heap-allocated objects are counted in the memory accounting (MemTag::UIObjects)
+	static void* operator new(size_t size);
+	static void* operator new(size_t, void* ptr) { return ptr; }
+	static void operator delete(void* ptr, size_t size);
+
 	void PO_ResetConfiguration() override; // IPersistentObject
 	void PO_BeforeDelete() override; // IPersistentObject
 	void _InitReset();
@@ -382,8 +388,11 @@ struct UIObject : IPersistentObject
 	UI_FORCEINLINE UIRect GetFinalRect() const { return _finalRect; }
 
 	UI_FORCEINLINE const FontSettings* FindFontSettings(const FontSettings* first) const { return first ? first : _FindClosestParentFontSettings(); }
+	// the result is cached (while in the tree) until the object is moved, its parent's SetsChildTextStyle flag or the current theme change
 	const FontSettings* _FindClosestParentFontSettings() const;
 	virtual const FontSettings* _GetFontSettings() const;
+	// clears the cached inherited font settings of this object and its children
+	void _InvalidateInheritedFontSettings();
 
 	ui::NativeWindowBase* GetNativeWindow() const;
 	LivenessToken GetLivenessToken() { return _livenessToken.GetOrCreate(); }
@@ -404,6 +413,9 @@ struct UIObject : IPersistentObject
 	// total size: 24p7 (52/80)
 
 	LayoutInfo _rcvdLayoutInfo = {};
+
+	mutable const ThemeData* _inheritedFontSettingsTheme = nullptr; // null if not cached
+	mutable const FontSettings* _inheritedFontSettings = nullptr;
 };
 
 struct UIObjectIterator
@@ -544,9 +556,13 @@ struct TextElement : UIObjectNoChildren
 	std::string text;
 	bool multiline = false;
 
+	// measured once per text/font, the lines are only split again when the width changes
 	bool _cachedLines = false;
-	Array<StringView> _lines;
-	void _UpdateCache();
+	float _textWidth = 0;
+	draw::TextWrapInfo _wrap;
+	float _linesWidth = -1;
+	Array<draw::CharRange> _lines;
+	void _UpdateCache(Font* font, int size);
 	void InvalidateStyle() { _cachedLines = false; }
 
 	void OnReset() override;
@@ -602,7 +618,7 @@ constexpr auto ANY_ITEM = uintptr_t(-1);
 // a way to call operator new if it exists
 namespace _ {
 template<class T, class = void> struct has_operator_new : std::false_type {};
-template<class T> struct has_operator_new<T, decltype(T::operator new)> : std::true_type {};
+template<class T> struct has_operator_new<T, decltype((void)T::operator new(sizeof(T)))> : std::true_type {};
 
 template <class T> UI_FORCEINLINE void* CallNew_DefSize(std::false_type) { return operator new(sizeof(T)); }
 template <class T> UI_FORCEINLINE void* CallNew_DefSize(std::true_type) { return T::operator new(sizeof(T)); }
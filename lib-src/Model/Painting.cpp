@@ -5,6 +5,8 @@
 #include "Native.h"
 #include "Objects.h"
 
+#include "../Core/MemoryAccounting.h"
+
 
 namespace ui {
 
@@ -330,7 +332,7 @@ ContentPaintAdvice ImageSetPainter::Paint(const PaintInfo& info)
 }
 
 
-BoxShadowPainter::CacheValue* BoxShadowPainter::GetOrCreate(Size2f size)
+BoxShadowPainter::CacheValue BoxShadowPainter::GetOrCreate(Size2f size)
 {
 	SimpleMaskBlurGen::Input config = {};
 	config.boxSizeX = u32(size.x);
@@ -342,32 +344,30 @@ BoxShadowPainter::CacheValue* BoxShadowPainter::GetOrCreate(Size2f size)
 	config.cornerRB = cornerRB;
 	config = config.Canonicalized();
 
-	CacheValue* ptr = cache.GetValuePtr(config);
-	if (!ptr)
+	return cache.GetOrCreate(config, [&config]()
 	{
 		// TODO cache/share generated images?
+		MemTagScope memScope(MemTag::BoxShadows);
 		CacheValue val;
 		Canvas canvas;
 		SimpleMaskBlurGen::Generate(config, val.output, canvas);
 		val.image = draw::ImageCreateFromCanvas(canvas);
-
-		ptr = &cache.Insert(config, val)->value;
-	}
-	return ptr;
+		return val;
+	});
 }
 
 ContentPaintAdvice BoxShadowPainter::Paint(const PaintInfo& info)
 {
-	auto* ptr = GetOrCreate(info.rect.GetSize());
+	auto cv = GetOrCreate(info.rect.GetSize());
 	auto rect = info.rect.MoveBy(offset.x, offset.y);
 	draw::RectColTex9Slice
 	(
-		rect.ExtendBy(ptr->output.outerOffset),
-		rect.ShrinkBy(ptr->output.innerOffset),
+		rect.ExtendBy(cv.output.outerOffset),
+		rect.ShrinkBy(cv.output.innerOffset),
 		color,
-		ptr->image,
-		ptr->output.outerUV,
-		ptr->output.innerUV
+		cv.image,
+		cv.output.outerUV,
+		cv.output.innerUV
 	);
 	return {};
 }
@@ -1,7 +1,7 @@
 
 #pragma once
 
-#include "../Core/HashMap.h"
+#include "../Core/ConcurrentHashMap.h"
 #include "../Core/Math.h"
 #include "../Core/String.h"
 #include "../Core/Image.h"
@@ -284,9 +284,9 @@ struct BoxShadowPainter : IPainter
 	Vec2f offset;
 	int blurSize = 0;
 	int cornerLT = 0, cornerRT = 0, cornerLB = 0, cornerRB = 0;
-	HashMap<SimpleMaskBlurGen::Input, CacheValue> cache;
+	ConcurrentHashMap<SimpleMaskBlurGen::Input, CacheValue> cache;
 
-	CacheValue* GetOrCreate(Size2f size);
+	CacheValue GetOrCreate(Size2f size);
 
 	ContentPaintAdvice Paint(const PaintInfo&) override;
 };
@@ -2,6 +2,7 @@
 #include "System.h"
 
 #include "../Core/Logging.h"
+#include "../Core/Profiler.h"
 
 #include <algorithm>
 
@@ -17,6 +18,7 @@ UIContainer* g_curContainer;
 using namespace _;
 
 LogCategory LOG_UISYS("UISys");
+UICounters g_uiCounters;
 
 
 #if 0
@@ -125,6 +127,8 @@ bool imSetEnabled(bool);
 
 void UIContainer::ProcessSingleBuildable(Buildable* curB)
 {
+	UI_PROFILE_ZONE_DETAIL("Buildable::Build", typeid(*curB).name());
+	g_uiCounters.numBuilt++;
 	bool oldEnabled = imm::imSetEnabled(!(curB->flags & UIObject_IsDisabled));
 
 	objectStackSize = 0;
@@ -216,6 +220,7 @@ void UIContainer::ProcessBuildStack()
 	//   - there are no infinite loops caused by persistent rebuilding of any buildable
 	//   - all child buildables can still be built (unlike with blanket at-work queueing redirections)
 
+	UI_PROFILE_ZONE("Build");
 	LogDebug(LOG_UISYS, " ---- processing node BUILD stack ----");
 	//_lastBuildFrameID++;
 	double t = hqtime();
@@ -249,7 +254,9 @@ void UIContainer::ProcessBuildStack()
 
 	pendingDeactivationSet.Flush();
 
-	LogDebug(LOG_UISYS, "build %" PRIu64 " time: %.3f ms", _lastBuildFrameID, (hqtime() - t) * 1000);
+	t = hqtime() - t;
+	g_uiCounters.buildTime += t;
+	LogDebug(LOG_UISYS, "build %" PRIu64 " time: %.3f ms", _lastBuildFrameID, t * 1000);
 	_lastBuildFrameID++;
 }
 
@@ -262,6 +269,7 @@ void UIContainer::ProcessLayoutStack()
 	else
 		return;
 
+	UI_PROFILE_ZONE("Layout");
 	TmpEdit<decltype(g_curSystem)> tmp(g_curSystem, owner);
 
 	// TODO check if the styles are actually different and if not, remove element from the stack
@@ -296,6 +304,7 @@ void UIContainer::ProcessLayoutStack()
 		obj->RedoLayout();
 
 		double t1 = hqtime();
+		g_uiCounters.layoutTime += t1 - t0;
 		LogDebug(LOG_UISYS, "relayout %s @ %p took %.3f ms", typeid(*obj).name(), obj, (t1 - t0) * 1000);
 	}
 	layoutStack.Clear();
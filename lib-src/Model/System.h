@@ -17,6 +17,17 @@ namespace ui {
 
 extern LogCategory LOG_UISYS;
 
+// totals since startup (updated on the main thread), per-frame values are in FrameStats
+struct UICounters
+{
+	u64 numBuilt = 0;
+	u64 numLaidOut = 0;
+	u64 numPainted = 0;
+	double buildTime = 0; // seconds
+	double layoutTime = 0;
+};
+extern UICounters g_uiCounters;
+
 struct UIObjectDirtyStack
 {
 	UIObjectDirtyStack(uint32_t f) : flag(f) {}
@@ -2,6 +2,7 @@
 #include "Theme.h"
 
 #include "../Core/Logging.h"
+#include "../Core/MemoryAccounting.h"
 #include "../Core/SerializationJSON.h"
 #include "../Core/FileSystem.h"
 
@@ -21,6 +22,7 @@ size_t IThemeStructLoader::AllocID()
 struct ThemeFile : RefCountedST
 {
 	BufferHandle text;
+	MemTrackedSize textMem{ MemTag::Theme };
 	JSONUnserializerObjectIterator unserializer;
 };
 using ThemeFileHandle = RCHandle<ThemeFile>;
@@ -420,6 +422,8 @@ struct ThemeLoaderData : IThemeLoader
 
 void ThemeData::LoadTheme(StringView folder)
 {
+	// includes the images loaded by the theme and the parsed files (kept for the custom structs)
+	MemTagScope memScope(MemTag::Theme);
 	ThemeLoaderData tld;
 
 	auto dih = FSCreateDirectoryIterator(folder);
@@ -436,6 +440,7 @@ void ThemeData::LoadTheme(StringView folder)
 				continue;
 
 			tf->text = frr.data;
+			tf->textMem.Set(tf->text->Size());
 
 			if (tf->unserializer.Parse(tf->text->GetStringView(), JPF_AllowAll))
 			{
@@ -4,8 +4,10 @@
 #include "RHI.h"
 
 #include "../Core/FileSystem.h"
-#include "../Core/HashMap.h"
+#include "../Core/ConcurrentHashMap.h"
 #include "../Core/Logging.h"
+#include "../Core/MemoryAccounting.h"
+#include "../Core/Profiler.h"
 
 #define STB_RECT_PACK_IMPLEMENTATION
 #include "../../ThirdParty/stb_rect_pack.h"
@@ -49,10 +51,16 @@ struct TexturePage
 		stbrp_init_target(&rectPackContext, TEXTURE_PAGE_WIDTH, TEXTURE_PAGE_HEIGHT, rectPackNodes, MAX_TEXTURE_PAGE_NODES);
 		rhiTex = gfx::CreateTextureRGBA8(nullptr, TEXTURE_PAGE_WIDTH, TEXTURE_PAGE_HEIGHT, 0);
 		gfx::SetTextureDebugName(rhiTex, "ui:atlas-page");
+		MemTrackAlloc(MemTag::TextureAtlas, GetMemorySize());
 	}
 	~TexturePage()
 	{
 		gfx::DestroyTexture(rhiTex);
+		MemTrackFree(MemTag::TextureAtlas, GetMemorySize());
+	}
+	static constexpr size_t GetMemorySize()
+	{
+		return sizeof(TexturePage) + TEXTURE_PAGE_WIDTH * TEXTURE_PAGE_HEIGHT * 4;
 	}
 
 	gfx::Texture2D* rhiTex = nullptr;
@@ -103,6 +111,8 @@ struct TextureStorage
 		if (!numPendingAllocs)
 			return;
 
+		UI_PROFILE_ZONE_DETAIL("TextureUpload", "atlas");
+
 		stbrp_rect rectsToPack[MAX_TEXTURE_PAGE_NODES] = {};
 		for (int i = 0; i < numPendingAllocs; i++)
 		{
@@ -252,7 +262,7 @@ gfx::Texture2D* GetAtlasTexture(int n, int size[2])
 } // debug
 
 
-static HashMap<StringView, IImage*> g_loadedImages;
+static ConcurrentHashMap<StringView, IImage*> g_loadedImages;
 
 struct ImageImpl : IImage
 {
@@ -265,6 +275,10 @@ struct ImageImpl : IImage
 
 	std::string cacheKey;
 
+	// including the atlas staging data and the estimated size of the exclusive texture
+	MemTag memTag = MemGetScopeTag(MemTag::Images);
+	size_t memBytes = sizeof(ImageImpl);
+
 	static ImageImpl* NewFromAPIHandle(int w, int h, uintptr_t handle)
 	{
 		auto* I = new ImageImpl;
@@ -274,6 +288,7 @@ struct ImageImpl : IImage
 	}
 	ImageImpl()
 	{
+		MemTrackAlloc(memTag, memBytes);
 	}
 	ImageImpl(int w, int h, int pitch, const void* d, bool a8, TexFlags flg) :
 		size(w, h), flags(flg)
@@ -320,19 +335,24 @@ struct ImageImpl : IImage
 
 			n->srcData = data;
 			atlasNode = n;
+			memBytes += size_t(dstw) * size_t(dsth) * 4;
 		}
 		else
 		{
+			UI_PROFILE_ZONE_DETAIL("TextureUpload", "image");
 			rhiTex = a8
 				? gfx::CreateTextureA8(d, w, h, uint8_t(flg))
 				: gfx::CreateTextureRGBA8(d, w, h, uint8_t(flg));
 			gfx::SetTextureDebugName(rhiTex, "ui:image");
+			memBytes += size_t(w) * size_t(h) * (a8 ? 1 : 4);
 		}
+		MemTrackAlloc(memTag, memBytes);
 	}
 	~ImageImpl()
 	{
 		gfx::DestroyTexture(rhiTex);
 		delete[] data;
+		MemTrackFree(memTag, memBytes);
 
 		if (!cacheKey.empty())
 		{
@@ -411,7 +431,8 @@ void ImageCacheWrite(IImage* image, StringView key)
 	impl->cacheKey <<= key;
 	if (impl->rhiTex)
 		gfx::SetTextureDebugName(impl->rhiTex, key);
-	g_loadedImages[impl->cacheKey] = image;
+	// also replaces the key since it points to the string of the previous image
+	g_loadedImages.Insert(impl->cacheKey, image);
 }
 
 bool ImageCacheRemove(StringView key)
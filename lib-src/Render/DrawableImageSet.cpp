@@ -4,6 +4,7 @@
 #include "Render.h"
 
 #include "../Core/HashMap.h"
+#include "../Core/MemoryAccounting.h"
 
 
 namespace ui {
@@ -110,6 +111,7 @@ RCHandle<ImageSet::BitmapImageEntry> ImageSet::VectorImageEntry::RequestImage(Si
 		if (r->image->GetSize().y == size.y) // currently requesting by y-size
 			return r;
 
+	MemTagScope memScope(MemTag::VectorImages);
 	auto* E = new BitmapImageEntry;
 	E->image = ImageCreateFromCanvas(image->GetImageWithHeight(size.y));
 	E->image->SetExclDebugName(image->GetCacheKey());
@@ -14,6 +14,9 @@ Stats Stats::operator - (const Stats& o) const
 	r.num_SetTexture = num_SetTexture - o.num_SetTexture;
 	r.num_DrawTriangles = num_DrawTriangles - o.num_DrawTriangles;
 	r.num_DrawIndexedTriangles = num_DrawIndexedTriangles - o.num_DrawIndexedTriangles;
+	r.num_Vertices = num_Vertices - o.num_Vertices;
+	r.num_Indices = num_Indices - o.num_Indices;
+	r.num_TextureRectUploads = num_TextureRectUploads - o.num_TextureRectUploads;
 	return r;
 }
 
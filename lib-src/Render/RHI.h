@@ -17,6 +17,9 @@ struct Stats
 	uint64_t num_SetTexture;
 	uint64_t num_DrawTriangles;
 	uint64_t num_DrawIndexedTriangles;
+	uint64_t num_Vertices;
+	uint64_t num_Indices;
+	uint64_t num_TextureRectUploads; // CopyToMappedTextureRect calls
 
 	Stats operator - (const Stats& o) const;
 
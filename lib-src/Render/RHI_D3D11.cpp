@@ -1147,6 +1147,7 @@ MapData MapTexture(Texture2D* tex)
 
 void CopyToMappedTextureRect(Texture2D* tex, const MapData& md, uint16_t x, uint16_t y, uint16_t w, uint16_t h, const void* data, bool a8)
 {
+	g_stats.num_TextureRectUploads++;
 	size_t bpp = a8 ? 1 : 4;
 #if D3D_USE_STAGING_TEXTURE
 	for (uint16_t curY = 0; curY < h; curY++)
@@ -1186,6 +1187,7 @@ void UnmapTexture(Texture2D* tex)
 
 void SetTexture(Texture2D* tex)
 {
+	g_stats.num_SetTexture++;
 	g_curTex = tex;
 	if (!tex)
 		tex = g_defTex;
@@ -1196,6 +1198,7 @@ void SetTexture(Texture2D* tex)
 void DrawTriangles(Vertex* verts, size_t num_verts)
 {
 	g_stats.num_DrawTriangles++;
+	g_stats.num_Vertices += num_verts;
 
 	g_tmpVB->Write(verts, sizeof(*verts) * num_verts);
 	UINT stride = sizeof(*verts);
@@ -1208,6 +1211,8 @@ void DrawTriangles(Vertex* verts, size_t num_verts)
 void DrawIndexedTriangles(Vertex* verts, size_t num_verts, uint16_t* indices, size_t num_indices)
 {
 	g_stats.num_DrawIndexedTriangles++;
+	g_stats.num_Vertices += num_verts;
+	g_stats.num_Indices += num_indices;
 
 	g_tmpVB->Write(verts, sizeof(*verts) * num_verts);
 	UINT stride = sizeof(*verts);
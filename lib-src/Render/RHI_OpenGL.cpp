@@ -344,6 +344,7 @@ MapData MapTexture(Texture2D* tex)
 
 void CopyToMappedTextureRect(Texture2D* tex, const MapData& md, uint16_t x, uint16_t y, uint16_t w, uint16_t h, const void* data, bool a8)
 {
+	g_stats.num_TextureRectUploads++;
 	GLCHK(glBindTexture(GL_TEXTURE_2D, (GLuint)tex));
 	GLCHK(glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, a8 ? GL_ALPHA : GL_RGBA, GL_UNSIGNED_BYTE, data));
 }
@@ -366,15 +367,18 @@ void SetTexture(Texture2D* tex)
 void DrawTriangles(Vertex* verts, size_t num_verts)
 {
 	g_stats.num_DrawTriangles++;
+	g_stats.num_Vertices += num_verts;
 	GLCHK(glVertexPointer(2, GL_FLOAT, sizeof(Vertex), &verts[0].x));
 	GLCHK(glTexCoordPointer(2, GL_FLOAT, sizeof(Vertex), &verts[0].u));
 	GLCHK(glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Vertex), &verts[0].col));
 	GLCHK(glDrawArrays(GL_TRIANGLES, 0, num_verts));
 }
 
-void DrawIndexedTriangles(Vertex* verts, size_t /*num_verts*/, uint16_t* indices, size_t num_indices)
+void DrawIndexedTriangles(Vertex* verts, size_t num_verts, uint16_t* indices, size_t num_indices)
 {
 	g_stats.num_DrawIndexedTriangles++;
+	g_stats.num_Vertices += num_verts;
+	g_stats.num_Indices += num_indices;
 	GLCHK(glVertexPointer(2, GL_FLOAT, sizeof(Vertex), &verts[0].x));
 	GLCHK(glTexCoordPointer(2, GL_FLOAT, sizeof(Vertex), &verts[0].u));
 	GLCHK(glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Vertex), &verts[0].col));
@@ -6,6 +6,7 @@
 #include "../Core/Array.h"
 #include "../Core/FileSystem.h"
 #include "../Core/HashMap.h"
+#include "../Core/SmallArray.h"
 
 
 namespace ui {
@@ -286,7 +287,7 @@ void LineCol(const ArrayView<Point2f>& points, float w, Color4b col, bool closed
 	else
 		t_prev = (points[1] - points[0]).Normalized().Perp();
 
-	Array<gfx::Vertex> verts;
+	SmallArray<gfx::Vertex, 64> verts;
 	verts.Reserve(size * 2);
 	for (size_t i = 0; i < size; i++)
 	{
@@ -307,7 +308,7 @@ void LineCol(const ArrayView<Point2f>& points, float w, Color4b col, bool closed
 		t_prev = t_next;
 	}
 
-	Array<uint16_t> indices;
+	SmallArray<uint16_t, 192> indices;
 	indices.Reserve((size - 1) * 6);
 	for (size_t i = 0; i + (closed ? 0 : 1) < size; i++)
 	{
@@ -343,7 +344,7 @@ void AALineCol(const ArrayView<Point2f>& points, float w, Color4b col, bool clos
 
 	size_t ncols = w <= 1 ? 3 : 4;
 
-	Array<gfx::Vertex> verts;
+	SmallArray<gfx::Vertex, 128> verts;
 	verts.Resize(size * ncols);
 	auto* vdest = verts.Data();
 	for (size_t i = 0; i < size; i++)
@@ -379,7 +380,7 @@ void AALineCol(const ArrayView<Point2f>& points, float w, Color4b col, bool clos
 		t_prev = t_next;
 	}
 
-	Array<uint16_t> indices;
+	SmallArray<uint16_t, 512> indices;
 	indices.Resize((closed ? size : size - 1) * (ncols - 1) * 6);
 	uint16_t* idest = indices.Data();
 	for (size_t i = 0; i + (closed ? 0 : 1) < size; i++)
@@ -453,7 +454,8 @@ static bool PointInTriangle(Vec2f pt, Vec2f v1, Vec2f v2, Vec2f v3)
 	return !(has_neg && has_pos);
 }
 
-static void Triangulate(Array<u16>& outIndices, const ArrayView<Point2f>& points)
+template <class IA>
+static void Triangulate(IA& outIndices, const ArrayView<Point2f>& points)
 {
 	if (IsConvexPolygon(points))
 	{
@@ -468,7 +470,7 @@ static void Triangulate(Array<u16>& outIndices, const ArrayView<Point2f>& points
 
 	float area2 = PolyArea2(points);
 	float areasign = sign(area2);
-	Array<u16> idcs;
+	SmallArray<u16, 64> idcs;
 	idcs.Resize(points.Size());
 	for (size_t i = 0; i < points.Size(); i++)
 		idcs[i] = u16(i);
@@ -533,10 +535,10 @@ void PolyCol(const ArrayView<Point2f>& points, Color4b col, bool midpixel)
 	if (points.Size() < 3)
 		return;
 
-	Array<gfx::Vertex> verts;
+	SmallArray<gfx::Vertex, 64> verts;
 	verts.Reserve(points.Size());
 
-	Array<u16> indices;
+	SmallArray<u16, 192> indices;
 	indices.Reserve((points.Size() - 2) * 3);
 
 	for (Vec2f p : points)
@@ -558,10 +560,10 @@ void AAPolyCol(const ArrayView<Point2f>& points, Color4b col, bool midpixel)
 	if (sz < 3)
 		return;
 
-	Array<gfx::Vertex> verts;
+	SmallArray<gfx::Vertex, 128> verts;
 	verts.Resize(sz * 2);
 
-	Array<u16> indices;
+	SmallArray<u16, 512> indices;
 	indices.Reserve((sz - 2) * 3 + sz * 6);
 
 	Color4b colA0 = col;
@@ -614,7 +616,7 @@ void AAPolyCol(const ArrayView<Point2f>& points, Color4b col, bool midpixel)
 
 struct CircleList
 {
-	Array<Point2f> points;
+	SmallArray<Point2f, 64> points;
 
 	CircleList(Point2f center, float radius)
 	{
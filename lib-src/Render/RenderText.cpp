@@ -68,30 +68,31 @@ AABB2f TextLineGenerateQuads(
 
 	size_t startRetQuad = retQuads.Size();
 	u32 prevChar = 0;
-	UTF8Iterator it(text);
-	for (;;)
+	uint32_t codepoints[128];
+	size_t pos = 0;
+	while (size_t num = UTF8Decode(text, pos, codepoints, 128))
 	{
-		uint32_t ch = it.Read();
-		if (ch == UTF8Iterator::END)
-			break;
-
-		float kern = font->FindKerning(sctx.size, prevChar, ch);
-		//if (::GetTickCount() % 1000 < 300) kern = 0;
-		prevChar = ch;
+		for (size_t i = 0; i < num; i++)
+		{
+			uint32_t ch = codepoints[i];
+			float kern = font->FindKerning(sctx.size, prevChar, ch);
+			//if (::GetTickCount() % 1000 < 300) kern = 0;
+			prevChar = ch;
 
-		auto gv = font->FindGlyph(sctx, ch, true);
+			auto gv = font->FindGlyphAsync(sctx, ch);
 
-		float x0 = roundf(gv.xoff + kern) * invScale + x;
-		float y0 = gv.yoff * invScale + y;
-		float qx1 = x0 + gv.w * invScale;
+			float x0 = roundf(gv.xoff + kern) * invScale + x;
+			float y0 = gv.yoff * invScale + y;
+			float qx1 = x0 + gv.w * invScale;
 
-		AABB2f posbox = { x0, y0, qx1, y0 + gv.h * invScale };
+			AABB2f posbox = { x0, y0, qx1, y0 + gv.h * invScale };
 
-		retQuads.Append({ posbox, gv.img });
-		//RectCol(posbox, { 255, 0, 0, 127 });
+			retQuads.Append({ posbox, gv.img });
+			//RectCol(posbox, { 255, 0, 0, 127 });
 
-		x += roundf(gv.xadv + kern) * invScale;
-		x1 = max(x1, qx1);
+			x += roundf(gv.xadv + kern) * invScale;
+			x1 = max(x1, qx1);
+		}
 	}
 
 	// move quads according to alignment
@@ -111,11 +112,118 @@ AABB2f TextLineGenerateQuads(
 	return { x0, y0, x1, y1 };
 }
 
-struct CharRange
+void TextWrapInfo::Begin(Font* f, float s)
+{
+	font = f;
+	size = s;
+	scale = GetTextResolutionScale();
+	chars.Clear();
+	lines.Clear();
+	maxLineWidth = 0;
+}
+
+void TextWrapInfo::AddLine(StringView text, size_t start, size_t end)
+{
+	Line line = { u32(chars.Size()), 0, u32(start), u32(end) };
+	if (size > 0)
+	{
+		float invScale = 1.0f / scale;
+		auto& sctx = font->GetSizeContext(int(roundf(size * scale)));
+
+		float x = 0;
+		u32 prevCh = 0;
+		u32 lastBreak = line.firstChar;
+		UTF8Iterator it(text.substr(0, end));
+		it.pos = start;
+		for (;;)
+		{
+			size_t charStart = it.pos;
+			uint32_t ch = it.Read();
+			if (ch == UTF8Iterator::END)
+				break;
+
+			// TODO full unicode?
+			if (ch == ' ' || prevCh == ' ')
+				lastBreak = u32(chars.Size());
+
+			float kern = font->FindKerning(sctx.size, prevCh, ch);
+			x += int(roundf((font->FindGlyph(sctx, ch, false).xadv + kern) * invScale));
+			chars.Append({ u32(charStart), lastBreak, x });
+			prevCh = ch;
+		}
+		maxLineWidth = max(maxLineWidth, x);
+	}
+	line.endChar = u32(chars.Size());
+	lines.Append(line);
+}
+
+void TextWrapInfo::Build(Font* f, float s, StringView text)
+{
+	Begin(f, s);
+	size_t start = 0;
+	for (size_t i = 0; i < text.size(); i++)
+	{
+		if (text[i] == '\n')
+		{
+			AddLine(text, start, i);
+			start = i + 1;
+		}
+	}
+	if (start < text.size())
+		AddLine(text, start, text.size());
+}
+
+// calls fn(hardLine, firstChar, endChar) for each wrapped line
+template <class F> static void ForEachWrappedLine(const TextWrapInfo& wrap, float maxWidth, F&& fn)
+{
+	auto* chars = wrap.chars.Data();
+	for (const auto& L : wrap.lines)
+	{
+		u32 s = L.firstChar;
+		for (;;)
+		{
+			float base = s > L.firstChar ? chars[s - 1].x : 0;
+			if (maxWidth < 0 || L.endChar - s <= 1 || chars[L.endChar - 1].x - base <= maxWidth)
+			{
+				fn(L, s, L.endChar);
+				break;
+			}
+
+			// find the first overflowing character (the first one is always kept)
+			u32 lo = s + 1, hi = L.endChar - 1;
+			while (lo < hi)
+			{
+				u32 mid = (lo + hi) / 2;
+				if (chars[mid].x - base > maxWidth)
+					hi = mid;
+				else
+					lo = mid + 1;
+			}
+			u32 b = chars[lo].breakIdx > s ? chars[lo].breakIdx : lo;
+			fn(L, s, b);
+			s = b;
+		}
+	}
+}
+
+size_t TextWrapInfo::GetLineCount(float maxWidth) const
 {
-	size_t start;
-	size_t end;
-};
+	size_t count = 0;
+	ForEachWrappedLine(*this, maxWidth, [&count](const Line&, u32, u32) { count++; });
+	return count;
+}
+
+void TextWrapInfo::GetLines(float maxWidth, Array<CharRange>& outLines) const
+{
+	outLines.Clear();
+	ForEachWrappedLine(*this, maxWidth, [this, &outLines](const Line& L, u32 first, u32 end)
+	{
+		size_t start = first < L.endChar ? chars[first].pos : L.start;
+		outLines.Append({ start, end < L.endChar ? chars[end].pos : L.end });
+	});
+}
+
+static TextWrapInfo g_tmpWrapInfo;
 
 AABB2f TextMultilineGenerateQuadsUntransformed(
 	Array<ImageQuad>& retQuads,
@@ -129,169 +237,84 @@ AABB2f TextMultilineGenerateQuadsUntransformed(
 	if (size <= 0)
 		return {};
 
-	float scale = GetTextResolutionScale();
+	g_tmpWrapInfo.Build(font, size, text);
+	return TextMultilineGenerateQuadsUntransformed(retQuads, g_tmpWrapInfo, maxWidth, lineHeight, text, halign);
+}
+
+AABB2f TextMultilineGenerateQuadsUntransformed(
+	Array<ImageQuad>& retQuads,
+	const TextWrapInfo& wrap,
+	float maxWidth,
+	float lineHeight,
+	StringView text,
+	TextHAlign halign)
+{
+	if (wrap.size <= 0)
+		return {};
+
+	Font* font = wrap.font;
+	float scale = wrap.scale;
 	float invScale = 1.0f / scale;
-	auto& sctx = font->GetSizeContext(int(roundf(size * scale)));
+	auto& sctx = font->GetSizeContext(int(roundf(wrap.size * scale)));
 
 	bool pointAlignX = maxWidth < 0;
-	if (pointAlignX)
-		maxWidth = 0;
-
-	maxWidth = roundf(maxWidth * scale) * invScale;
+	if (!pointAlignX)
+		maxWidth = roundf(maxWidth * scale) * invScale;
 	lineHeight = roundf(lineHeight * scale) * invScale;
 
 	float y = 0;
-	float yo = roundf(BaselineToYOff(sctx, TextBaseline::Top) + (lineHeight - size) / 2 * scale) * invScale;
-	float ya = roundf((y + yo) * scale) * invScale;
-
-	//descLines.Clear();
-	//descLines.Append({ 0, 0 });
-	CharRange lastLine = { 0, 0 };
-	size_t lastQuadOff = 0;
-
-	size_t lastBreakPos = 0;
-	size_t lastBreakQuadOff = 0;
-	float widthToLastBreak = 0;
-	float widthSoFar = 0;
-	float maxMeasuredWidth = 0;
-	u32 prevCh = 0;
-
-	ui::UTF8Iterator it(text);
-	auto CommitLine = [&]()
-	{
-		maxMeasuredWidth = max(maxMeasuredWidth, widthSoFar);
-		// align the last line
-		if (halign != TextHAlign::Left)
-		{
-			float diff = maxWidth - widthSoFar;
-			float off = roundf(diff * (float(halign) * 0.5f) * scale) * invScale;
-			for (size_t i = lastQuadOff; i < retQuads.Size(); i++)
-			{
-				retQuads[i].box.x0 += off;
-				retQuads[i].box.x1 += off;
-			}
-		}
-	};
-	for (;;)
-	{
-		uint32_t charStart = it.pos;
-		uint32_t ch = it.Read();
-		if (ch == ui::UTF8Iterator::END)
-			break;
-		//descLines.Last().end = it.pos;
-		lastLine.end = it.pos;
-		if (ch == '\n')
-		{
-			//descLines.Append({ it.pos, it.pos });
-			CommitLine();
-			lastLine = { it.pos, it.pos };
-			lastQuadOff = retQuads.Size();
-			lastBreakQuadOff = lastQuadOff;
-
-			widthToLastBreak = 0;
-			widthSoFar = 0;
+	float yo = roundf(BaselineToYOff(sctx, TextBaseline::Top) + (lineHeight - wrap.size) / 2 * scale) * invScale;
+	float minX = FLT_MAX;
+	float maxX = -FLT_MAX;
 
-			y += lineHeight;
-			ya = roundf((y + yo) * scale) * invScale;
-		}
-		else
+	auto* chars = wrap.chars.Data();
+	ForEachWrappedLine(wrap, maxWidth, [&](const TextWrapInfo::Line& L, u32 first, u32 end)
+	{
+		float base = first > L.firstChar ? chars[first - 1].x : 0;
+
+		// trailing spaces are not included in the alignment
+		u32 lastVis = end;
+		while (lastVis > first && text[chars[lastVis - 1].pos] == ' ')
+			lastVis--;
+		float lineW = lastVis > first ? chars[lastVis - 1].x - base : 0;
+
+		float off = 0;
+		if (pointAlignX)
+			off = roundf(-lineW * (float(halign) * 0.5f) * scale) * invScale;
+		else if (halign != TextHAlign::Left)
+			off = roundf((maxWidth - lineW) * (float(halign) * 0.5f) * scale) * invScale;
+		minX = min(minX, off);
+		maxX = max(maxX, off + lineW);
+
+		float ya = roundf((y + yo) * scale) * invScale;
+		u32 prevCh = 0;
+		UTF8Iterator it(text);
+		for (u32 i = first; i < end; i++)
 		{
-			// TODO full unicode?
-			if (ch == ' ' || prevCh == ' ')
-			{
-				widthToLastBreak = widthSoFar;
-				lastBreakPos = charStart;
-				lastBreakQuadOff = retQuads.Size();
-			}
+			it.pos = chars[i].pos;
+			uint32_t ch = it.Read();
 
 			float kern = font->FindKerning(sctx.size, prevCh, ch);
-			auto gv = font->FindGlyph(sctx, ch, true);
-			float w = widthSoFar + int(roundf((gv.xadv + kern) * invScale));
+			prevCh = ch;
+			auto gv = font->FindGlyphAsync(sctx, ch);
 
-			float x0 = roundf(gv.xoff + kern) * invScale + widthSoFar;
+			float x0 = roundf(gv.xoff + kern) * invScale + (i > first ? chars[i - 1].x - base : 0) + off;
 			float y0 = gv.yoff * invScale + ya;
 
-			AABB2f posbox = { x0, y0, x0 + gv.w * invScale, y0 + gv.h * invScale };
-
 			if (gv.w && gv.h)
-				retQuads.Append({ posbox, gv.img });
-
-			widthSoFar = w;
-			if (w > maxWidth && lastQuadOff + 1 < retQuads.Size())
-			{
-				size_t breakQuad;
-				size_t breakChar;
-				// the last section overflowed
-				if (lastBreakQuadOff > lastQuadOff)
-				{
-					breakQuad = lastBreakQuadOff;
-					breakChar = lastBreakPos;
-				}
-				else // the last character overflowed
-				{
-					breakQuad = retQuads.Size() - 1;
-					breakChar = charStart;
-				}
-				if (lastQuadOff < breakQuad)
-				{
-					float lineW = retQuads[breakQuad - 1].box.x1;
-					maxMeasuredWidth = max(maxMeasuredWidth, lineW);
-					// align the last line
-					if (halign != TextHAlign::Left)
-					{
-						float diff = maxWidth - lineW;
-						float off = roundf(diff * (float(halign) * 0.5f) * scale) * invScale;
-						for (size_t i = lastQuadOff; i < breakQuad; i++)
-						{
-							retQuads[i].box.x0 += off;
-							retQuads[i].box.x1 += off;
-						}
-					}
-				}
-				float oldX = 0;
-				if (breakQuad < retQuads.Size())
-				{
-					oldX = retQuads[breakQuad].box.x0;
-					for (size_t i = breakQuad; i < retQuads.Size(); i++)
-					{
-						auto& quad = retQuads[i];
-						quad.box.x0 -= oldX;
-						quad.box.x1 -= oldX;
-						quad.box.y0 += lineHeight;
-						quad.box.y1 += lineHeight;
-					}
-					widthSoFar -= oldX;
-					widthToLastBreak = max(0.f, widthToLastBreak - oldX);
-				}
-				else
-				{
-					widthSoFar = 0;
-					widthToLastBreak = 0;
-				}
-				y += lineHeight;
-				ya = roundf((y + yo) * scale) * invScale;
-				lastQuadOff = breakQuad;
-				lastBreakQuadOff = breakQuad;
-				lastLine.start = breakChar;
-			}
+				retQuads.Append({ { x0, y0, x0 + gv.w * invScale, y0 + gv.h * invScale }, gv.img });
 		}
-		prevCh = ch;
-	}
 
-	//if (descLines.Last().start == descLines.Last().end && (descLines.Size() == 1 || !descLines[descLines.Size() - 2].sv(s).ends_with("\n")))
-	//	descLines.RemoveLast();
-	if (lastLine.start != lastLine.end)
-	{
-		CommitLine();
 		y += lineHeight;
-	}
+	});
 
 	AABB2f ret;
 	ret.y0 = 0;
-	ret.y1 = y;// + lineHeight;
+	ret.y1 = y;
 	if (pointAlignX)
 	{
-		// TODO measure the width of all the lines
+		ret.x0 = minX <= maxX ? minX : 0;
+		ret.x1 = minX <= maxX ? maxX : 0;
 	}
 	else
 	{
@@ -310,6 +333,10 @@ void ImageQuadsColOffset(ArrayView<ImageQuad> quads, Vec2f offset, Color4b color
 {
 	for (auto& quad : quads)
 	{
+		// glyph not rasterized yet
+		if (!quad.image)
+			continue;
+
 		AABB2f box = quad.box + offset;
 		if (clipBox)
 		{
@@ -353,41 +380,42 @@ AABB2f TextLine(Font* font, float size, float x, float y, StringView text, Color
 	y = roundf(y * scale) * invScale;
 
 	u32 prevChar = 0;
-	UTF8Iterator it(text);
-	for (;;)
+	uint32_t codepoints[128];
+	size_t pos = 0;
+	while (size_t num = UTF8Decode(text, pos, codepoints, 128))
 	{
-		uint32_t ch = it.Read();
-		if (ch == UTF8Iterator::END)
-			break;
-
-		float kern = font->FindKerning(sctx.size, prevChar, ch);
-		//if (::GetTickCount() % 1000 < 300) kern = 0;
-		prevChar = ch;
-		auto gv = font->FindGlyph(sctx, ch, true);
-		float x0 = gv.xoff * invScale + x + kern;
-		float y0 = gv.yoff * invScale + y;
-		AABB2f posbox = { x0, y0, x0 + gv.w * invScale, y0 + gv.h * invScale };
-		if (clipBox)
+		for (size_t i = 0; i < num; i++)
 		{
-			if (clipBox->Overlaps(posbox))
+			uint32_t ch = codepoints[i];
+			float kern = font->FindKerning(sctx.size, prevChar, ch);
+			//if (::GetTickCount() % 1000 < 300) kern = 0;
+			prevChar = ch;
+			auto gv = font->FindGlyphAsync(sctx, ch);
+			float x0 = gv.xoff * invScale + x + kern;
+			float y0 = gv.yoff * invScale + y;
+			AABB2f posbox = { x0, y0, x0 + gv.w * invScale, y0 + gv.h * invScale };
+			if (clipBox)
 			{
-				if (clipBox->Contains(posbox))
+				if (clipBox->Overlaps(posbox))
 				{
-					draw::RectColTex(posbox, color, gv.img);
-				}
-				else
-				{
-					AABB2f clipped = posbox.Intersect(*clipBox);
-					AABB2f uvbox = { posbox.InverseLerp(clipped.GetMin()), posbox.InverseLerp(clipped.GetMax()) };
-					draw::RectColTex(clipped, color, gv.img, uvbox);
+					if (clipBox->Contains(posbox))
+					{
+						draw::RectColTex(posbox, color, gv.img);
+					}
+					else
+					{
+						AABB2f clipped = posbox.Intersect(*clipBox);
+						AABB2f uvbox = { posbox.InverseLerp(clipped.GetMin()), posbox.InverseLerp(clipped.GetMax()) };
+						draw::RectColTex(clipped, color, gv.img, uvbox);
+					}
 				}
 			}
+			else
+			{
+				draw::RectColTex(posbox, color, gv.img);
+			}
+			x += roundf(gv.xadv + kern) * invScale;
 		}
-		else
-		{
-			draw::RectColTex(posbox, color, gv.img);
-		}
-		x += roundf(gv.xadv + kern) * invScale;
 	}
 #else
 	g_tmpTextQuads.Clear();
@@ -397,19 +425,8 @@ AABB2f TextLine(Font* font, float size, float x, float y, StringView text, Color
 #endif
 }
 
-AABB2f TextMultiline(
-	Font* font,
-	float size,
-	AABB2f rect,
-	float lineHeight,
-	StringView text,
-	Color4b color,
-	TextHAlign halign,
-	TextVAlign valign,
-	const AABB2f* clipBox)
+static AABB2f TextMultilineDraw(AABB2f box, AABB2f rect, Color4b color, TextVAlign valign, const AABB2f* clipBox)
 {
-	g_tmpTextQuads.Clear();
-	AABB2f box = TextMultilineGenerateQuadsUntransformed(g_tmpTextQuads, font, size, rect.GetWidth(), lineHeight, text, halign);
 	Vec2f off = rect.GetMin();
 	if (valign == TextVAlign::Bottom)
 	{
@@ -425,5 +442,36 @@ AABB2f TextMultiline(
 	return box;
 }
 
+AABB2f TextMultiline(
+	Font* font,
+	float size,
+	AABB2f rect,
+	float lineHeight,
+	StringView text,
+	Color4b color,
+	TextHAlign halign,
+	TextVAlign valign,
+	const AABB2f* clipBox)
+{
+	g_tmpTextQuads.Clear();
+	AABB2f box = TextMultilineGenerateQuadsUntransformed(g_tmpTextQuads, font, size, rect.GetWidth(), lineHeight, text, halign);
+	return TextMultilineDraw(box, rect, color, valign, clipBox);
+}
+
+AABB2f TextMultiline(
+	const TextWrapInfo& wrap,
+	AABB2f rect,
+	float lineHeight,
+	StringView text,
+	Color4b color,
+	TextHAlign halign,
+	TextVAlign valign,
+	const AABB2f* clipBox)
+{
+	g_tmpTextQuads.Clear();
+	AABB2f box = TextMultilineGenerateQuadsUntransformed(g_tmpTextQuads, wrap, rect.GetWidth(), lineHeight, text, halign);
+	return TextMultilineDraw(box, rect, color, valign, clipBox);
+}
+
 } // draw
 } // ui
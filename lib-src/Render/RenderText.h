@@ -15,6 +15,52 @@ struct ImageQuad
 	IImage* image;
 };
 
+struct CharRange
+{
+	size_t start;
+	size_t end;
+};
+
+// break opportunities and cumulative widths of a text, measured once per text/font/size
+// the lines for any width can be retrieved without measuring the glyphs again
+struct TextWrapInfo
+{
+	struct Char
+	{
+		u32 pos; // byte offset in the text
+		u32 breakIdx; // last break opportunity at or before this character
+		float x; // right edge, relative to the start of the line
+	};
+	struct Line
+	{
+		u32 firstChar;
+		u32 endChar;
+		u32 start;
+		u32 end;
+	};
+
+	Font* font = nullptr;
+	float size = 0;
+	float scale = 0;
+	Array<Char> chars;
+	Array<Line> lines;
+	float maxLineWidth = 0;
+
+	void Begin(Font* f, float s);
+	// measures the range [start; end) of the text as one line (must not contain line breaks)
+	void AddLine(StringView text, size_t start, size_t end);
+	// splits the text into lines at '\n' (a trailing empty line is not added)
+	void Build(Font* f, float s, StringView text);
+	UI_FORCEINLINE bool IsBuiltFor(Font* f, float s) const { return font == f && size == s && scale == GetTextResolutionScale(); }
+
+	UI_FORCEINLINE size_t GetHardLineCount() const { return lines.Size(); }
+	UI_FORCEINLINE float GetUnwrappedWidth() const { return maxLineWidth; }
+	// maxWidth < 0 = unlimited
+	size_t GetLineCount(float maxWidth) const;
+	UI_FORCEINLINE float GetHeight(float maxWidth, float lineHeight) const { return GetLineCount(maxWidth) * lineHeight; }
+	void GetLines(float maxWidth, Array<CharRange>& outLines) const;
+};
+
 AABB2f TextLineGenerateQuadsUntransformed(
 	Array<ImageQuad>& retQuads,
 	Font* font,
@@ -37,6 +83,14 @@ AABB2f TextMultilineGenerateQuadsUntransformed(
 	float lineHeight,
 	StringView text,
 	TextHAlign halign = TextHAlign::Left);
+// the text must be the same one that the wrap info was built from
+AABB2f TextMultilineGenerateQuadsUntransformed(
+	Array<ImageQuad>& retQuads,
+	const TextWrapInfo& wrap,
+	float maxWidth, // <0 = unlimited, align around 0
+	float lineHeight,
+	StringView text,
+	TextHAlign halign = TextHAlign::Left);
 
 void ImageQuadsCol(ArrayView<ImageQuad> quads, Color4b color, const AABB2f* clipBox = nullptr);
 void ImageQuadsColOffset(ArrayView<ImageQuad> quads, Vec2f offset, Color4b color, const AABB2f* clipBox = nullptr);
@@ -65,6 +119,15 @@ AABB2f TextMultiline(
 	TextHAlign halign = TextHAlign::Left,
 	TextVAlign valign = TextVAlign::Top,
 	const AABB2f* clipBox = nullptr);
+AABB2f TextMultiline(
+	const TextWrapInfo& wrap,
+	AABB2f rect,
+	float lineHeight,
+	StringView text,
+	Color4b color,
+	TextHAlign halign = TextHAlign::Left,
+	TextVAlign valign = TextVAlign::Top,
+	const AABB2f* clipBox = nullptr);
 
 } // draw
 } // ui
@@ -63,13 +63,16 @@ void TE_MaskNode::Render(Canvas& canvas, const TE_RenderContext& rc)
 {
 	canvas.SetSize(rc.width, rc.height);
 	auto* pixels = canvas.GetPixels();
-	for (unsigned y = 0; y < rc.height; y++)
+	ParallelForImageLines(rc.height, rc.width, [this, pixels, &rc](size_t y0, size_t y1)
 	{
-		for (unsigned x = 0; x < rc.width; x++)
+		for (unsigned y = unsigned(y0); y < unsigned(y1); y++)
 		{
-			pixels[x + y * rc.width] = Color4f(Eval(x + 0.5f, y + 0.5f, rc), 1).GetColor32();
+			for (unsigned x = 0; x < rc.width; x++)
+			{
+				pixels[x + y * rc.width] = Color4f(Eval(x + 0.5f, y + 0.5f, rc), 1).GetColor32();
+			}
 		}
-	}
+	});
 }
 
 
@@ -200,16 +203,19 @@ void TE_LayerNode::Render(Canvas& canvas, const TE_RenderContext& rc)
 {
 	canvas.SetSize(rc.width, rc.height);
 	auto* pixels = canvas.GetPixels();
-	for (unsigned y = 0; y < rc.height; y++)
+	ParallelForImageLines(rc.height, rc.width, [this, pixels, &rc](size_t y0, size_t y1)
 	{
-		for (unsigned x = 0; x < rc.width; x++)
+		for (unsigned y = unsigned(y0); y < unsigned(y1); y++)
 		{
-			Color4f c = Eval(x + 0.5f, y + 0.5f, rc);
-			if (rc.gamma)
-				c = c.Power(1.0f / 2.2f);
-			pixels[x + y * rc.width] = c.GetColor32();
+			for (unsigned x = 0; x < rc.width; x++)
+			{
+				Color4f c = Eval(x + 0.5f, y + 0.5f, rc);
+				if (rc.gamma)
+					c = c.Power(1.0f / 2.2f);
+				pixels[x + y * rc.width] = c.GetColor32();
+			}
 		}
-	}
+	});
 }
 
 